@@ -0,0 +1,23 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// one contiguous block that a process carves its arrays out of
+typedef struct {
+    char *base;
+    size_t size;
+    size_t used;
+} Arena;
+
+void init_arena_cache();
+bool arena_init(Arena *a, size_t size);
+void *arena_alloc(Arena *a, size_t size);
+bool arena_owns(const Arena *a, const void *ptr);
+void arena_free(Arena *a);
+
+// bytes arena_alloc will actually take for a request of the given size
+size_t arena_size_for(size_t size);
+
+#endif
@@ -2,16 +2,43 @@
 #define BACKING_STORE_H
 
 #include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
 #include "process.h"
+#include "config.h"
 #include <windows.h>
+#include "locks.h"
+#include "swap_directory.h"
 
-extern CRITICAL_SECTION backing_store_cs;
+// taken inside every function below, a caller may already hold it
+extern TimedLock backing_store_lock;
+
+// backing-store-io picks plain FILE* calls or mmap, FILE* if it is not set
+void init_backing_store(Config config);
+// switches to "file" or "mmap" and starts the store empty, false if that one is unavailable
+bool use_backing_store_io(const char *name);
+const char *backing_store_io_name();
 
-void init_backing_store();
-static FILE* ensure_backing_store(const char* mode);
 void write_process_to_backing_store(Process *p);
-Process* read_first_process_from_backing_store();
-void remove_first_process_from_backing_store();
+// the whole batch goes out in one go, one open for FILE* and one write for mmap
+void write_processes_to_backing_store(Process **procs, int count);
 void print_backing_store_contents();
 
+// what to swap in next with hole bytes free in one block: the longest swapped out if it fits, otherwise the
+// biggest one that does unless the longest swapped out has waited max_wait ticks, *fits false with the longest
+// swapped out if nothing goes, NO_SWAP_ENTRY if the store is empty
+// copies its directory entry into out, takes only swap_directory_lock so it never waits on disk I/O
+uint32_t pick_swap_in(uint64_t hole, uint64_t max_wait, SwapEntry *out, bool *fits);
+// reads the process with that directory id and removes it from the store, NULL if it is gone or unreadable
+Process *take_process_from_backing_store(uint32_t id);
+
+// swap-outs go to a compressed cache in RAM first (swap_cache.h), the oldest entries are written to the store
+// once it holds more than swap-cache-size bytes, 0 writes everything through
+void resize_swap_cache(uint64_t bytes);
+
+// every backend stores processes in the format of process_image.h
+
+// called by cleanup_process for a program mapped by the mmap store
+void release_mapped_program(Process *p);
+
 #endif
\ No newline at end of file
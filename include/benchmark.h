@@ -0,0 +1,9 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "config.h"
+
+// micro benchmarks run from the CLI, e.g. "benchmark sched 10000" or "benchmark swap 200"
+void run_benchmark(const char *args, Config config);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include "config.h"
+
+// wall time cached once per scheduler tick so hot paths don't call time()
+void init_clock(Config config);
+void clock_tick();
+time_t clock_wall_time();
+
+// format an execution time as wall time or emulated tick, per the report-clock setting
+void format_exec_time(char *buf, size_t size, time_t wall, uint64_t tick);
+
+#endif
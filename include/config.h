@@ -1,6 +1,8 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#define DEFAULT_LOG_RING_SIZE 100
+
 typedef struct {
     int num_cpu;
     char scheduler[8];
@@ -13,6 +15,25 @@ typedef struct {
     int mem_per_frame; 
     int min_mem_per_proc;
     int max_mem_per_proc;
+    char optimizer[16];
+    int log_ring_size;
+    int log_stream;
+    int log_segment_size;
+    char report_clock[8];
+    int pregen_pool_size;
+    int finished_window;
+    int finished_spill;
+    char backing_store_io[8];
+    int swap_cache_size;
+    int memory_wait_timeout;
+    int memory_wait_limit;
+    char memory_wait_order[16];
+    int compaction_budget;
+    char placement[16];
+    int working_set_window;
+    int page_fault_high;
+    int page_fault_low;
+    int prefetch_pages;
 } Config;
 
 extern Config system_config;
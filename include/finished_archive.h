@@ -0,0 +1,42 @@
+#ifndef FINISHED_ARCHIVE_H
+#define FINISHED_ARCHIVE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "process.h"
+#include "config.h"
+
+#define DEFAULT_FINISHED_WINDOW 10000
+
+// what is left of a process once it finishes
+typedef struct {
+    int pid;
+    uint32_t name_id;       // 0 for generated "P<pid>" names, otherwise an interned name
+    uint32_t num_inst;
+    uint64_t finish_tick;
+    uint64_t turnaround;    // ticks from arrival to finish
+    time_t finish_time;
+} FinishedRecord;
+
+// counts over every process that ever finished, including the ones no longer kept in memory
+typedef struct {
+    uint64_t finished;
+    uint64_t instructions;
+    uint64_t turnaround;
+    uint64_t in_memory;
+    uint64_t spilled;
+} FinishedTotals;
+
+void init_finished_archive(Config config);
+void archive_finished_process(Process *p);
+
+bool finished_archive_find(int pid, FinishedRecord *out);
+FinishedTotals finished_archive_totals();
+void finished_record_name(const FinishedRecord *r, char *buf, size_t size);
+
+// calls fn on every record oldest first, spilled ones are read back from disk when include_spilled is set
+void finished_archive_walk(void (*fn)(const FinishedRecord *r, void *ctx), void *ctx, bool include_spilled);
+
+#endif
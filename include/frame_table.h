@@ -0,0 +1,43 @@
+#ifndef FRAME_TABLE_H
+#define FRAME_TABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// the physical frames as parallel arrays: a bitmap of which are in use, then owner, page and last use per frame
+// a free frame is found a 64 bit word at a time and the least recently used one by a vector min over last_used,
+// where free frames hold FRAME_FREE_TICK so they never win
+
+#define FRAME_FREE_TICK ((uint64_t)INT64_MAX)
+
+typedef struct {
+    int num_frames;
+    int num_used;
+    uint64_t *used;             // bit i set while frame i holds a page
+    int *pid;
+    int *page;
+    uint64_t *last_used;
+    int *next_resident;         // the other frames of the same process, -1 at either end
+    int *prev_resident;
+    int free_hint;              // no free frame in the bitmap words below this one
+} FrameTable;
+
+// false if out of memory, frames is 0 for a table with no frames
+bool frame_table_init(FrameTable *t, int frames);
+void frame_table_destroy(FrameTable *t);
+
+// -1 if every frame is in use
+int frame_table_find_free(FrameTable *t);
+// -1 if no frame is in use
+int frame_table_find_lru(const FrameTable *t);
+void frame_table_claim(FrameTable *t, int frame, int pid, int page, uint64_t tick);
+void frame_table_release(FrameTable *t, int frame);
+
+// a process's resident set is a list of its frames, *head is its first frame and only read while *count > 0
+void frame_table_add_resident(FrameTable *t, int frame, int *head, int *count);
+void frame_table_remove_resident(FrameTable *t, int frame, int *head, int *count);
+
+// the vector code the min search runs with here, "avx2" or "scalar"
+const char *frame_table_simd_name();
+
+#endif
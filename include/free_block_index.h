@@ -0,0 +1,30 @@
+#ifndef FREE_BLOCK_INDEX_H
+#define FREE_BLOCK_INDEX_H
+
+#include <stdint.h>
+#include "memory.h"
+
+// the free blocks of the memory block list in two treaps threaded through the blocks themselves, one by size
+// for best-fit and worst-fit and one by address, where every node knows the biggest block below it, for
+// first-fit and next-fit, every lookup is O(log n)
+// a block is in the index exactly while it is free, its base and end must not change while it is in there
+// every function below is called with memory_lock held
+
+// empties the index, the block list was started over
+void free_index_reset();
+void free_index_insert(MemoryBlock *b);
+void free_index_remove(MemoryBlock *b);
+int free_index_count();
+// size of the biggest free block, 0 if there is none
+uint64_t free_index_largest();
+
+// the lowest addressed free block of at least size bytes
+MemoryBlock *free_index_first_fit(uint64_t size);
+// the lowest addressed one at or above from, wrapping around to the bottom if there is none
+MemoryBlock *free_index_next_fit(uint64_t size, uint64_t from);
+// the smallest one that fits, the lowest addressed of those if several are the same size
+MemoryBlock *free_index_best_fit(uint64_t size);
+// the biggest one if it fits
+MemoryBlock *free_index_worst_fit(uint64_t size);
+
+#endif
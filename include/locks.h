@@ -0,0 +1,43 @@
+#ifndef LOCKS_H
+#define LOCKS_H
+
+#include <stdint.h>
+#include <windows.h>
+
+// every shared structure has its own lock, a thread that needs more than one takes them in this order:
+//
+//   1. cores          cpu_cores slots, core_busy, cpu utilization counters, state/pc of processes on a core
+//   2. ready queue    ready_queue ring buffer
+//   3. memory         MemoryBlock list, memory.free_memory and num_processes_in_memory
+//   4. frames         frame table, resident sets, page table entries of resident pages and frame quotas
+//   5. backing store  the backing store file
+//   6. swap directory what is swapped out and where, held only for in-memory work
+//   7. process table  process_table and its pid/name indexes
+//   8. finished       finished process archive and its spill file
+//   9. swap queues    swap I/O submission and completion queues, never held with another lock
+//
+// nothing does file I/O or frees a process while holding the cores lock, processes leave a core first
+// and are written out or freed after the lock is released
+
+typedef struct {
+    CRITICAL_SECTION cs;
+    const char *name;
+    // updated by the owner while the lock is held
+    uint64_t acquisitions;
+    uint64_t contended;         // acquisitions that found the lock taken
+    int64_t total_hold;         // performance counter ticks
+    int64_t max_hold;
+    int64_t acquired_at;
+    int depth;                  // recursive entries by the owner, only the outermost one is timed
+} TimedLock;
+
+void timed_lock_init(TimedLock *lock, const char *name);
+void timed_lock_enter(TimedLock *lock);
+void timed_lock_leave(TimedLock *lock);
+// sleeps on cv with the lock released, time spent waiting is not counted as holding it
+BOOL timed_lock_wait(TimedLock *lock, CONDITION_VARIABLE *cv, DWORD ms);
+
+// lock-stats command
+void print_lock_stats();
+
+#endif
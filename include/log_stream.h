@@ -0,0 +1,23 @@
+#ifndef LOG_STREAM_H
+#define LOG_STREAM_H
+
+#include <stdbool.h>
+#include "process.h"
+#include "config.h"
+
+// append-only PRINT log on disk, fed by per-core buffers and written by a background thread
+void init_log_stream(Config config);
+void stop_log_stream();
+bool log_stream_enabled();
+
+// called from core threads, never blocks or touches the disk
+void log_stream_push(int core, const Log *log);
+
+// read the last count records of a process from disk, oldest first, returns how many were read
+int log_stream_read_tail(int pid, Log *out, int count);
+// how many records screen shows from the tail, log-ring-size
+int log_stream_tail_size();
+// records lost because a core buffer was full
+long log_stream_dropped();
+
+#endif
@@ -5,6 +5,12 @@
 #include <stdbool.h>
 #include "stats.h"
 #include "process.h"
+#include "locks.h"
+
+#define DEFAULT_WORKING_SET_WINDOW 512
+#define DEFAULT_PAGE_FAULT_HIGH 8
+#define DEFAULT_PAGE_FAULT_LOW 2
+#define DEFAULT_PREFETCH_PAGES 4
 
 typedef struct Memory {
     uint64_t total_memory;
@@ -13,7 +19,9 @@ typedef struct Memory {
     uint64_t min_mem_per_proc;
     uint64_t used_memory;
     uint64_t free_memory;
+    uint64_t largest_free;      // biggest free block, kept with free_memory by update_free_memory
     int num_processes_in_memory;
+    uint64_t releases;          // blocks given back by free_process_memory, processes waiting for room retry when it moves
 } Memory;
 
 typedef struct MemoryBlock {
@@ -22,11 +30,18 @@ typedef struct MemoryBlock {
     bool occupied;
     int pid;
     struct MemoryBlock* next;
+    // free block index (free_block_index.h), only used while the block is free
+    struct MemoryBlock *size_left, *size_right;
+    struct MemoryBlock *addr_left, *addr_right;
+    uint64_t subtree_max;
+    uint32_t priority;
 } MemoryBlock;
 
 
 extern Memory memory;
 extern MemoryBlock* memory_head;
+// guards the block list and the memory counters, taken inside the functions below
+extern TimedLock memory_lock;
 
 // Read a uint16 value from memory for a given process
 uint16_t read_from_memory(Process *p, uint16_t addr);
@@ -39,11 +54,39 @@ void init_memory(uint64_t total_memory, uint64_t mem_per_frame, uint64_t max_mem
 void update_free_memory();
 void free_process_memory(Process *p, MemoryBlock **head_ref);
 MemoryBlock* init_memory_block(uint64_t total_memory);
+// nodes for the block list, from slabs sized by init_memory, called with memory_lock held
+MemoryBlock *alloc_memory_block();
+void free_memory_block(MemoryBlock *b);
 void merge_adjacent_free_blocks(MemoryBlock **head_ref);
+uint64_t largest_free_block();
+// placement-policy: "first-fit", "next-fit", "best-fit" or "worst-fit", false for anything else
+bool set_placement_policy(const char *name);
+const char *placement_policy_name();
+// takes a free block of at least size bytes for pid the way the placement policy says and splits off the rest,
+// NULL if none is big enough, called with memory_lock held
+MemoryBlock *allocate_block(uint64_t size, int pid);
+// the cheapest way to get a free block of size bytes by freeing some of the n processes in pids: a run of
+// neighbouring blocks that are free or belong to one of them, with at most max_victims of them and the lowest
+// total cost, writes their indexes into chosen and returns how many (0 if the room is already there), -1 if none
+int find_room(uint64_t size, const int *pids, const double *costs, int n, int max_victims, int *chosen);
+// moves occupied blocks down over free ones, at most max_bytes of them and none owned by a pid in pinned,
+// returns the bytes moved and the blocks moved in *moves
+uint64_t compact_memory(uint64_t max_bytes, const int *pinned, int num_pinned, int *moves);
+
+// demand paging over the frame table: a process's data stays in its block, frames only track which of its pages
+// are resident so faults, prefetch and replacement are bookkeeping
+// working-set-window ticks of reference bits make up a working set, 0 turns paging off, a process's frame quota
+// grows while it faults more than fault_high times a window and shrinks toward its working set below fault_low,
+// sequential faults prefetch up to prefetch pages ahead
+void set_paging(int window, int fault_high, int fault_low, int prefetch);
+// READ and WRITE, marks addr's page referenced and faults it in first if it is not resident
+void reference_page(Process *p, uint16_t addr);
+// the scheduler every tick with the cores lock held, samples the processes on the cores every window / 8 ticks
+void sample_working_sets(Process **cores, int num_cores);
 
 // vmstat and process-smi
-void process_smi(int num_cores, Process **cpu_cores);
-void vmstat(Memory *mem, CPUStats *stats);
+void process_smi();
+void vmstat();
 
 int memory_write(uint32_t address, uint16_t value, Process *p);
 uint16_t memory_read(uint32_t address, Process *p, int *success);
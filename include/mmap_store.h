@@ -0,0 +1,32 @@
+#ifndef MMAP_STORE_H
+#define MMAP_STORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "process.h"
+
+// backing store file laid out for mmap: every entry starts on a page with the process image minus its program
+// (PROCESS_IMAGE_NO_PROGRAM), the raw program starts on the next page boundary so swap-in maps it read-only
+// and runs it in place, only the image is decoded, entries by swap directory id
+// programs are mapped with CreateFileMapping and MapViewOfFile, removed entries give their space back with
+// FSCTL_SET_ZERO_DATA on the sparse file, so it never needs compacting
+// every function is called with backing_store_lock held
+
+// truncates the file, false if it can't be created
+bool mmap_store_open(const char *path);
+// unlinks the file, programs still mapped keep the old one alive until they are released
+void mmap_store_close();
+
+void mmap_store_write(Process **procs, const uint32_t *ids, int count);
+// whole images back to back, as the swap cache keeps them
+// they keep their program, so they are read back with a copy of it instead of a mapping
+void mmap_store_write_images(const char *images, const uint32_t *lengths, const uint32_t *ids, int count);
+// NULL if the entry's write failed or it can't be read back
+Process *mmap_store_read(uint32_t id);
+// releases the header pages, the program pages go once the process that mapped them is freed
+void mmap_store_remove(uint32_t id);
+
+// unmaps a program handed out by mmap_store_read and gives its pages back to the file
+void mmap_store_release(Instruction *program, int program_size, int store_generation, uint64_t offset);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "process.h"
+#include "config.h"
+
+// off: run programs as written
+// accurate: fuse instructions but charge the ticks of the originals
+// throughput: fuse instructions and charge one tick per dispatch
+typedef enum {
+    OPTIMIZER_OFF,
+    OPTIMIZER_ACCURATE,
+    OPTIMIZER_THROUGHPUT
+} OptimizerMode;
+
+OptimizerMode get_optimizer_mode(const char *name);
+int optimize_instructions(Instruction *insts, int count, OptimizerMode mode);
+void optimize_process(Process *p, Config config);
+
+#endif
@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "config.h"
+#include "arena.h"
+#include "sched_table.h"
 #include <time.h>
 
 #define MAX_PROCESS_NAME 50
@@ -14,7 +16,8 @@ typedef enum {
     READY,
     RUNNING,
     SLEEPING,
-    FINISHED
+    FINISHED,
+    SWAPPING        // queued for or being written to the backing store, on no core or queue
 } ProcessState;
 
 // variables
@@ -32,7 +35,11 @@ typedef enum {
     SLEEP,
     FOR,
     READ,
-    WRITE
+    WRITE,
+    // superinstructions produced by the optimizer
+    DECLARE_ADD,
+    DECLARE_SUBTRACT,
+    PRINT_REPEAT
 } InstructionType;
 
 typedef struct Instruction Instruction;
@@ -45,16 +52,21 @@ typedef struct Instruction {
     char arg3[50];
     uint16_t value;
     uint8_t repeat_count;
+    uint8_t cost;       // ticks charged when executed, 0 means 1
 
-    struct Instruction *sub_instructions;
+    struct Instruction *sub_instructions;   // FOR body while parsing, NULL once the program is inside a process
     int sub_instruction_count;
+    int body_index;     // FOR body inside a process, it starts at instructions[body_index]
 } Instruction;
 
-// for logs in screen
+// one PRINT record, only formatted into text when it is displayed
 typedef struct {
-    char message[50];
-    time_t last_exec_time;
+    int pid;
+    int var_slot;       // index into the process variables, -1 if none
+    uint16_t value;
     int core;
+    uint64_t tick;
+    time_t last_exec_time;
 } Log;
 
 // contents of a for loop
@@ -62,7 +74,7 @@ typedef struct {
     int repeat_count;
     int remaining;
     int current_index;
-    Instruction *sub_instructions;
+    int body_index;
     int sub_instruction_count;
 } ForContext;
 
@@ -70,25 +82,32 @@ typedef struct {
 typedef struct {
     int frame_number;
     bool valid;
+    bool referenced;        // set by every access, moved into history when the working set is sampled
+    bool prefetched;        // brought in ahead of a fault and not referenced yet
+    uint8_t history;        // referenced bits of the last 8 samples, newest in the top bit
 } PageTableEntry;
 
 typedef struct{
 
     char name[MAX_PROCESS_NAME];
     int pid;
-    ProcessState state;
-    int program_counter;
-    uint16_t sleep_until_tick;
+    int slot;           // index of the hot fields in the scheduling table, see PROC_STATE, 0 if it has none
 
     Variable *variables;
     int num_var;
     int variables_capacity;
 
+    // the main program then the FOR bodies, no pointers inside so the block can be copied or mapped anywhere
     Instruction *instructions;
     int num_inst;
+    int program_size;   // instruction slots in the block, num_inst or more
+    int program_map;            // nonzero if instructions is a read-only mapping of the mmap backing store
+    uint64_t program_offset;    // where that mapping starts in the store file
 
-    Log *logs;
+    Log *logs;          // ring of the most recent PRINTs, allocated on first use
     int num_logs;
+    int log_head;
+    int log_capacity;
 
     int start;
     int end;
@@ -100,22 +119,47 @@ typedef struct{
     int for_depth;
 
     time_t last_exec_time;
+    uint64_t last_exec_tick;
+    uint64_t arrival_tick;
+    uint64_t last_swap_in_tick; // 0 if it was never swapped back in
+    int times_evicted;          // swapped out to make room for another process
     uint64_t memory_allocation;
     uint64_t mem_base;
     uint64_t mem_limit;
-    uint32_t ticks_ran_in_quantum;
 
     PageTableEntry *page_table;
     int num_pages;
+    // frames holding its pages, linked through the frame table, resident_head means nothing while the count is 0
+    int resident_head;
+    int resident_pages;
+    // demand paging, see reference_page, frame_quota is 0 until its first fault
+    int frame_quota;
+    int working_set;        // pages referenced within the working set window, as of the last sample
+    int fault_rate;         // faults over the last window
+    uint64_t fault_samples; // faults in each of the last 8 samples, a byte each, newest in the low byte
+    int window_faults;      // faults since the last sample
+    int next_fault_page;    // the page after the last one faulted or prefetched, a fault there is sequential
+    int prefetch_run;       // pages prefetched on the last sequential fault
+
+    int table_slot;     // position in process_table while the process is in it
+
+    Arena arena;        // backing block for the arrays above, unused if they were allocated separately
 
-    int core;
-    
 } Process;
 
 Variable *get_variable(Process *p, const char *name);
 uint16_t resolve_value(Process *p, const char *arg, uint16_t fallback);
-void execute_instruction(Process *p, Config config);
+int execute_instruction(Process *p, Config config);
+void init_process_table();
 void add_process(Process *p);
+// the find functions and the pointers they return are only safe while the table is locked
+void lock_process_table();
+void unlock_process_table();
+Process *find_process_by_pid(int pid);
+Process *find_process_by_name(const char *name);
+
+void format_log(Process *p, const Log *log, char *buf, size_t size);
+const Log *get_log(Process *p, int index);
 
 void trim(char *str);
 Instruction parse_declare(const char *args);
@@ -130,10 +174,18 @@ extern Process **process_table;
 extern uint32_t num_processes;
 extern uint32_t process_table_size;
 extern volatile long next_pid;
+// gives p the next unique pid and a scheduling table slot, -1 if the table is full
+int allocate_pid(Process *p);
 
 Process *generate_dummy_process(Config config);
+Process *generate_random_process(Config config, uint64_t *rng);
 extern void print_process_info(Process *p);
 void remove_process_from_table(Process *p);
+bool init_process_arena(Process *p, int num_inst, int num_body, int variables_capacity, int num_pages, int log_capacity);
+bool init_process_from_instructions(Process *p, const Instruction *insts, int count, int variables_capacity, int num_pages, int log_capacity);
+// a FOR body of count instructions at body_index has to lie in the program after the main part
+bool for_body_valid(const Process *p, int body_index, int count);
 void cleanup_process(Process *p);
+void free_process(Process *p);
 
 #endif
@@ -0,0 +1,51 @@
+#ifndef PROCESS_IMAGE_H
+#define PROCESS_IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "process.h"
+
+// a whole process as one self-contained buffer, used by every backing store
+//
+//   header   magic "PIMG", version, flags, body length, FNV-1a checksum of the body (16 bytes, little endian)
+//   body     counts, then scalar state, program, variables, for_stack, page table and log ring
+//
+// integers in the body are LEB128 varints (zigzag for signed ones) and strings are length prefixed, nothing in
+// it is a pointer or depends on the struct layout, FOR bodies are positions in the program
+
+#define PROCESS_IMAGE_MAGIC 0x474D4950u    // "PIMG"
+#define PROCESS_IMAGE_VERSION 2
+#define PROCESS_IMAGE_HEADER_SIZE 16
+
+// the program is not in the body, it is kept as a raw Instruction array somewhere else (the mmap store)
+#define PROCESS_IMAGE_NO_PROGRAM 0x1
+
+// instructions in the program block of a process, the main part and its FOR bodies
+int process_program_size(const Process *p);
+
+// exact length, packs the whole process to find it (0 if out of memory), only for reporting
+size_t process_image_size(const Process *p, int flags);
+// never less than the exact length and computed from the counts alone, so a writer can pack in one pass
+size_t process_image_bound(const Process *p, int flags);
+// buf has to hold process_image_bound(p, flags) bytes, returns the bytes written
+size_t process_image_pack(const Process *p, int flags, char *buf);
+
+// total image length from its first PROCESS_IMAGE_HEADER_SIZE bytes, 0 if that is not an image header
+size_t process_image_length(const char *header);
+
+// NULL if the image is malformed, truncated or fails the checksum, never reads past len
+// the program counter and sleep tick are put back into the scheduling table
+Process *process_image_unpack(const char *buf, size_t len);
+// for a PROCESS_IMAGE_NO_PROGRAM image whose program was read separately, it is copied into the process
+Process *process_image_unpack_with_program(const char *buf, size_t len, const Instruction *program, int program_size);
+// for a PROCESS_IMAGE_NO_PROGRAM image, the process runs the program where it is (a read-only mapping)
+// and frees it with release_mapped_program, NULL if the image does not describe a program of program_size
+// instructions in which case the caller still owns it
+Process *process_image_attach(const char *buf, size_t len, Instruction *program, int program_size,
+                              int program_map, uint64_t program_offset);
+
+// recomputes the checksum after the body was changed in place, lets a fuzzer get past it
+void process_image_seal(char *buf, size_t len);
+
+#endif
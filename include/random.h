@@ -0,0 +1,14 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+
+// xorshift64* generator, the caller owns the state so every thread or structure keeps its own
+uint64_t seed_random_state(uint64_t salt);
+uint64_t next_random(uint64_t *state);
+// 0 to n - 1, 0 if n is not positive
+int random_below(uint64_t *state, int n);
+// heap priority for a treap node
+uint32_t random_priority(uint64_t *state);
+
+#endif
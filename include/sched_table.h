@@ -0,0 +1,41 @@
+#ifndef SCHED_TABLE_H
+#define SCHED_TABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SCHED_CHUNK_BITS 10
+#define SCHED_CHUNK_SIZE (1 << SCHED_CHUNK_BITS)
+#define SCHED_MAX_CHUNKS 4096         // room for 4M live processes
+
+// the fields the scheduler reads every tick, one array per field so a scan only pulls in what it reads
+// every array is a multiple of 64 bytes, so they all start on a cache line
+typedef struct {
+    uint64_t sleep_until_tick[SCHED_CHUNK_SIZE];
+    int32_t program_counter[SCHED_CHUNK_SIZE];
+    uint32_t ticks_ran_in_quantum[SCHED_CHUNK_SIZE];
+    int16_t core[SCHED_CHUNK_SIZE];
+    uint8_t state[SCHED_CHUNK_SIZE];
+} SchedChunk;
+
+// indexed by slot, chunks are never moved so lookups need no lock
+// a freed slot is handed out again before a new one, so the table only grows with the number of live processes
+// slot 0 is never handed out, a Process that was never given a slot reads and writes it harmlessly
+extern SchedChunk *sched_chunks[SCHED_MAX_CHUNKS];
+
+void init_sched_table();
+// a zeroed slot, -1 if the table is full or allocation failed
+int sched_slot_alloc();
+// slot 0 is ignored
+void sched_slot_release(int slot);
+
+#define SCHED_FIELD(slot, field) (sched_chunks[(slot) >> SCHED_CHUNK_BITS]->field[(slot) & (SCHED_CHUNK_SIZE - 1)])
+
+// hot fields of a process, usable as lvalues
+#define PROC_STATE(p)        SCHED_FIELD((p)->slot, state)
+#define PROC_PC(p)           SCHED_FIELD((p)->slot, program_counter)
+#define PROC_SLEEP_UNTIL(p)  SCHED_FIELD((p)->slot, sleep_until_tick)
+#define PROC_QUANTUM(p)      SCHED_FIELD((p)->slot, ticks_ran_in_quantum)
+#define PROC_CORE(p)         SCHED_FIELD((p)->slot, core)
+
+#endif
@@ -7,6 +7,10 @@
 #include "config.h"
 #include "memory.h"
 
+// processes that reach a core without room in memory wait this many ticks for it, at most this many at once
+#define DEFAULT_MEMORY_WAIT_TIMEOUT 500
+#define DEFAULT_MEMORY_WAIT_LIMIT 16
+
 typedef struct ReadyQueue {
     Process **items;
     uint32_t capacity;
@@ -27,11 +31,15 @@ DWORD WINAPI scheduler_loop(LPVOID lpParam);
 void start_scheduler(Config config);
 void start_scheduler_without_processes(Config system_config);
 void stop_scheduler();
+Process *take_pregenerated_process();
 void busy_wait_ticks(uint32_t delay_ticks);
+double time_scheduler_ticks(Config system_config, Process **procs, int count, int ticks);
 
+void init_scheduler_locks();
 void init_ready_queue();
 void enqueue_ready(Process *p);
 Process *dequeue_ready();
+uint32_t ready_queue_length();
 
 void assign_processes_to_cores();
 void scheduler_tick();
@@ -42,7 +50,5 @@ void stop_core_threads();
 
 int get_num_cores();
 Process **get_cpu_cores();
-Process **get_finished_processes();
-int get_finished_count();
 
 #endif
\ No newline at end of file
@@ -16,8 +16,8 @@ typedef struct{
 
 void screen_start(const char *name, int memory_size, Config config);
 void screen_resume(const char *name);
-void screen_list(int num_cores, Process **cpu_cores, int finished_count, Process **finished_processes);
-void screen_create_with_code(const char *command_args);
+void screen_list();
+void screen_create_with_code(const char *command_args, Config config);
 bool is_valid_memory_size(int memory_size);
-void report_utilization(int num_cores, Process **cpu_cores, int finished_count, Process **finished_processes);
+void report_utilization();
 #endif
@@ -0,0 +1,44 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "process.h"
+#include "stats.h"
+
+#define MAX_SNAPSHOT_CORES 128      // same limit as num-cpu
+
+// what a monitoring command needs from the process on a core
+typedef struct {
+    int pid;                // 0 when the core is idle
+    char name[MAX_PROCESS_NAME];
+    int program_counter;
+    int num_inst;
+    uint64_t memory_allocation;
+    int resident_pages;     // pages in frames, from its resident set
+    int working_set;        // pages in its working set at the last sample
+    time_t last_exec_time;
+    uint64_t last_exec_tick;
+} CoreSnapshot;
+
+typedef struct {
+    uint64_t tick;
+    int num_cores;
+    int cores_used;
+    uint64_t total_memory;
+    uint64_t used_memory;
+    uint64_t free_memory;
+    uint64_t largest_free_block;
+    CPUStats stats;
+    CoreSnapshot cores[MAX_SNAPSHOT_CORES];
+} SystemSnapshot;
+
+// scheduler thread only, once per tick with the cores lock held
+void publish_snapshot(Process **cpu_cores, int num_cores, uint64_t tick);
+
+// never blocks the scheduler or the cores, retries if a publish was in progress
+// before the scheduler has published anything the snapshot has no cores
+void read_snapshot(SystemSnapshot *out);
+
+#endif
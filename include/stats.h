@@ -1,16 +1,46 @@
 #ifndef STATS_H
 #define STATS_H
 
+#include <stdint.h>
+
+#define TICK_HIST_BUCKETS 24
+
 typedef struct {
     int idle_ticks;
     int active_ticks;
     int total_ticks;
     int num_paged_in;
     int num_paged_out;
+    int num_evictions;          // processes swapped out to make room for one coming back in
+    int num_thrash_swaps;       // evictions of a process swapped in less than THRASH_WINDOW ticks ago, and
+                                // swap-ins that could not be placed and went straight back out
+    int num_memory_waits;       // processes that waited for room instead of going to the backing store
+    int num_memory_wait_timeouts;   // of those, the ones that gave up and went to the backing store
+    int num_memory_wait_overflows;  // processes sent to the backing store because too many were waiting
+    int num_compaction_moves;   // blocks slid down by compaction
+    uint64_t compaction_bytes;  // and the bytes they held
+    // demand paging, see reference_page
+    int num_page_faults;
+    int num_prefetched_pages;
+    int num_prefetch_hits;      // prefetched pages referenced before they were evicted
+    int num_frame_quota_grows;
+    int num_frame_quota_shrinks;
+    // allocate_block under the current placement policy, failures included in the time
+    uint64_t placements;
+    uint64_t placement_failures;
+    uint64_t placement_ns;
+    uint64_t placement_max_ns;
+    // scheduler work per tick, bucket i counts ticks that took under 2^i microseconds
+    uint64_t tick_work_total_ns;
+    uint64_t tick_work_max_ns;
+    int tick_work_hist[TICK_HIST_BUCKETS];
 } CPUStats;
 
 extern CPUStats stats;
 
 void init_stats();
+void record_tick_work(uint64_t ns);
+// upper bound of the histogram bucket holding the given percentile, in microseconds
+uint64_t tick_work_percentile_us(const CPUStats *s, double pct);
 
-#endif
\ No newline at end of file
+#endif
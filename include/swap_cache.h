@@ -0,0 +1,48 @@
+#ifndef SWAP_CACHE_H
+#define SWAP_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "process.h"
+
+#define DEFAULT_SWAP_CACHE_SIZE (4 * 1024 * 1024)
+
+// compressed process images kept in RAM in front of the backing store file, by swap directory id
+// backing_store.c writes the oldest ones back to the file under the same id once the cache is over its capacity
+// every function except swap_cache_stats is called with backing_store_lock held
+
+// counters since the start, read by vmstat without the lock
+typedef struct {
+    uint64_t hits;              // swap-ins served from the cache
+    uint64_t misses;            // swap-ins that had to read the file
+    uint64_t write_backs;       // images pushed out to the file to make room
+    uint64_t raw_bytes;         // images as packed, over every put
+    uint64_t stored_bytes;      // the same images as kept in the cache
+    uint64_t used;              // bytes held right now
+    uint64_t capacity;
+    uint32_t entries;
+} SwapCacheStats;
+
+// 0 turns the cache off, what no longer fits is left for the caller to write back
+void swap_cache_set_capacity(uint64_t bytes);
+bool swap_cache_over_capacity();
+int swap_cache_count();
+// drops every entry, the store was started over
+void swap_cache_clear();
+
+// packs and compresses the process, false if the cache is off or out of memory
+bool swap_cache_put(const Process *p, uint32_t id);
+Process *swap_cache_read(uint32_t id);
+// the whole image as packed, not checked against its checksum, good until the next call, NULL if it can't be
+// decompressed
+const char *swap_cache_image(uint32_t id, uint32_t *length);
+void swap_cache_remove(uint32_t id);
+// the longest cached, NO_SWAP_ENTRY if the cache is empty
+uint32_t swap_cache_oldest();
+bool swap_cache_entry_size(uint32_t id, uint32_t *stored, uint32_t *raw);
+
+void swap_cache_count_swap_in(bool hit);
+void swap_cache_count_write_back();
+void swap_cache_stats(SwapCacheStats *out);
+
+#endif
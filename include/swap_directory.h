@@ -0,0 +1,53 @@
+#ifndef SWAP_DIRECTORY_H
+#define SWAP_DIRECTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "process.h"
+#include "locks.h"
+
+// every swapped-out process, wherever its image is (swap cache or backing store file), by entry id
+// the id is also the process's slot in the swap cache and in the store, so a swap-in reads it directly
+// ids are reused once their process is swapped back in
+
+#define NO_SWAP_ENTRY UINT32_MAX
+
+typedef struct {
+    int pid;
+    char name[MAX_PROCESS_NAME];
+    int num_inst;
+    int num_var;
+    uint64_t size;              // memory it needs back
+    int remaining;              // instructions left in its main program
+    uint64_t swap_out_tick;
+    uint64_t seq;               // swap-out order
+    bool live;
+    bool cached;                // in the swap cache, otherwise in the store
+    // best-fit tree
+    uint32_t left, right;
+    uint32_t priority;
+} SwapEntry;
+
+// held only for in-memory work, the scheduler takes it to pick a swap-in without waiting for disk I/O
+extern TimedLock swap_directory_lock;
+
+void init_swap_directory();
+// forgets every entry, the store was started over
+void swap_directory_clear();
+
+// every function below is called with swap_directory_lock held
+// a new entry is in the store until backing_store.c marks it cached
+uint32_t swap_directory_add(const Process *p);
+void swap_directory_remove(uint32_t id);
+SwapEntry *swap_directory_entry(uint32_t id);
+int swap_directory_count();
+
+// the longest swapped out, NO_SWAP_ENTRY if there is none
+uint32_t swap_directory_oldest();
+// the biggest process that needs at most size bytes, the oldest of those if several need the same, O(log n)
+uint32_t swap_directory_best_fit(uint64_t size);
+
+// oldest first
+void swap_directory_walk(void (*fn)(const SwapEntry *e, uint32_t id, void *ctx), void *ctx);
+
+#endif
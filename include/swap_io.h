@@ -0,0 +1,35 @@
+#ifndef SWAP_IO_H
+#define SWAP_IO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "process.h"
+
+typedef enum {
+    SWAP_OUT,       // write the process to the backing store
+    SWAP_IN         // take a process out of the backing store by swap directory id
+} SwapOp;
+
+typedef struct {
+    SwapOp op;
+    Process *p;     // NULL on a SWAP_IN completion when the store was empty
+    bool evict;     // SWAP_IN only, whether a running process may be evicted to make room
+    uint32_t id;    // SWAP_IN only, what the scheduler picked
+    uint64_t swapped_out_at;    // SWAP_IN only, the tick it went out, for the eviction decision
+} SwapRequest;
+
+void init_swap_io();
+
+// backing store reads and writes run on this thread, the scheduler only queues requests and reaps completions
+void start_swap_io();
+void stop_swap_io();
+
+// a SWAP_OUT process belongs to the I/O thread until its completion is reaped
+// without the I/O thread running the request is done on the calling thread
+void swap_io_submit(SwapOp op, Process *p, bool evict);
+void swap_io_submit_in(uint32_t id, bool evict, uint64_t swapped_out_at);
+
+// moves up to max finished requests into out, oldest first, returns how many
+int swap_io_reap(SwapRequest *out, int max);
+
+#endif
@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+
+// released arenas are kept per 4 KB size class and handed out again instead of going back to the heap
+#define ARENA_CLASS_SIZE 4096
+#define ARENA_NUM_CLASSES 32          // blocks above 128 KB are not cached
+#define ARENA_CACHE_PER_CLASS 64
+
+typedef struct CachedBlock {
+    struct CachedBlock *next;
+} CachedBlock;
+
+static CachedBlock *arena_cache[ARENA_NUM_CLASSES];
+static int arena_cache_count[ARENA_NUM_CLASSES];
+static CRITICAL_SECTION arena_cache_cs;
+static int arena_cache_ready = 0;
+
+void init_arena_cache() {
+    if (arena_cache_ready) return;
+    InitializeCriticalSection(&arena_cache_cs);
+    arena_cache_ready = 1;
+}
+
+size_t arena_size_for(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+// index of the size class a block belongs to, -1 if it is too big to cache
+static int size_class(size_t size) {
+    size_t cls = (size + ARENA_CLASS_SIZE - 1) / ARENA_CLASS_SIZE;
+    return cls >= 1 && cls <= ARENA_NUM_CLASSES ? (int)cls - 1 : -1;
+}
+
+bool arena_init(Arena *a, size_t size) {
+    int cls = size_class(size);
+    if (cls >= 0) size = (size_t)(cls + 1) * ARENA_CLASS_SIZE;
+
+    a->base = NULL;
+    if (cls >= 0 && arena_cache_ready) {
+        EnterCriticalSection(&arena_cache_cs);
+        CachedBlock *block = arena_cache[cls];
+        if (block) {
+            arena_cache[cls] = block->next;
+            arena_cache_count[cls]--;
+        }
+        LeaveCriticalSection(&arena_cache_cs);
+
+        // cached blocks were zeroed up to what was used, only the link is left
+        if (block) {
+            block->next = NULL;
+            a->base = (char *)block;
+        }
+    }
+
+    if (!a->base) a->base = calloc(1, size);
+    a->size = a->base ? size : 0;
+    a->used = 0;
+    return a->base != NULL;
+}
+
+// returns zeroed memory, NULL if the arena is full
+void *arena_alloc(Arena *a, size_t size) {
+    size_t aligned = arena_size_for(size);
+    if (!a->base || a->used + aligned > a->size) return NULL;
+    void *ptr = a->base + a->used;
+    a->used += aligned;
+    return ptr;
+}
+
+bool arena_owns(const Arena *a, const void *ptr) {
+    return a->base && (const char *)ptr >= a->base && (const char *)ptr < a->base + a->size;
+}
+
+void arena_free(Arena *a) {
+    if (!a->base) return;
+
+    int cls = size_class(a->size);
+    bool cached = false;
+    if (cls >= 0 && arena_cache_ready && (size_t)(cls + 1) * ARENA_CLASS_SIZE == a->size) {
+        memset(a->base, 0, a->used);
+
+        EnterCriticalSection(&arena_cache_cs);
+        if (arena_cache_count[cls] < ARENA_CACHE_PER_CLASS) {
+            CachedBlock *block = (CachedBlock *)a->base;
+            block->next = arena_cache[cls];
+            arena_cache[cls] = block;
+            arena_cache_count[cls]++;
+            cached = true;
+        }
+        LeaveCriticalSection(&arena_cache_cs);
+    }
+
+    if (!cached) free(a->base);
+    a->base = NULL;
+    a->size = 0;
+    a->used = 0;
+}
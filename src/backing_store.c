@@ -3,239 +3,495 @@
 #include <string.h>
 #include "process.h"
 #include "backing_store.h"
+#include "mmap_store.h"
+#include "process_image.h"
+#include "swap_cache.h"
+#include "swap_directory.h"
+#include "scheduler.h"
 
 #define BACKING_STORE_FILENAME "csopesy-backing-store.txt"
+#define COMPACT_FILENAME "csopesy-backing-store.tmp"
+#define WRITE_BACK_BATCH 32             // swap cache entries handed to the store per write
+#define COMPACT_THRESHOLD (1 << 20)     // dead space the file has to have before it is compacted
 
-// Initialize the backing store file
-void init_backing_store() {
-    FILE *fp = fopen(BACKING_STORE_FILENAME, "ab");  // Open in append mode to create if not exists
+TimedLock backing_store_lock;
+
+typedef enum {
+    STORE_IO_FILE,
+    STORE_IO_MMAP
+} StoreIo;
+
+static const char *store_io_names[] = {"file", "mmap"};
+static StoreIo store_io = STORE_IO_FILE;
+
+// where each image written by the FILE* path lives, by swap directory id
+// the file can pass 2 GB, so offsets are 64-bit and seeks use _fseeki64, long is 32 bits on Windows
+typedef struct {
+    uint64_t offset;
+    uint32_t length;
+    bool live;
+} FileEntry;
+
+static FileEntry *file_entries = NULL;
+static uint32_t file_entries_capacity = 0;
+static uint32_t file_live = 0;
+static uint64_t file_live_bytes = 0;
+static uint64_t file_end = 0;           // where the next image goes
+
+static void file_reset() {
+    free(file_entries);
+    file_entries = NULL;
+    file_entries_capacity = 0;
+    file_live = 0;
+    file_live_bytes = 0;
+    file_end = 0;
+}
+
+// start the store empty, pids and scheduling state from a previous run mean nothing now
+static bool open_store(StoreIo io) {
+    swap_cache_clear();
+    timed_lock_enter(&swap_directory_lock);
+    swap_directory_clear();
+    timed_lock_leave(&swap_directory_lock);
+    file_reset();
+
+    if (store_io == STORE_IO_MMAP)
+        mmap_store_close();
+
+    // the mmap store truncates the file itself
+    if (io == STORE_IO_MMAP && mmap_store_open(BACKING_STORE_FILENAME)) {
+        store_io = STORE_IO_MMAP;
+        return true;
+    }
+
+    store_io = STORE_IO_FILE;
+    FILE *fp = fopen(BACKING_STORE_FILENAME, "wb");
     if (fp) {
         fclose(fp);
     } else {
         perror("Failed to initialize backing store");
     }
+    return io == STORE_IO_FILE;
 }
 
-// Ensure the backing store exists before any operation
-static FILE* ensure_backing_store(const char* mode) {
-    FILE *fp = fopen(BACKING_STORE_FILENAME, mode);
-    if (!fp && strcmp(mode, "rb") == 0) {  // If reading and file doesn't exist
-        fp = fopen(BACKING_STORE_FILENAME, "wb");  // Create it
-        if (fp) {
-            fclose(fp);
-            fp = fopen(BACKING_STORE_FILENAME, mode);  // Reopen in original mode
-        }
-    }
-    return fp;
+static StoreIo store_io_from_name(const char *name) {
+    if (strcmp(name, "mmap") == 0) return STORE_IO_MMAP;
+    return STORE_IO_FILE;
 }
 
-// Writes a process and its associated data to the backing store.
-void write_process_to_backing_store(Process *p) {
-    if (!p) return;
-    FILE *fp = ensure_backing_store("ab"); // Append Binary
-    if (!fp) {
-        perror("Failed to open backing store for writing");
-        return;
-    }
+// Initialize the backing store file
+void init_backing_store(Config config) {
+    timed_lock_init(&backing_store_lock, "backing store");
+    init_swap_directory();
 
-    // 1. Write the main Process struct (without its pointer data)
-    fwrite(p, sizeof(Process), 1, fp);
-    // 2. Write the instructions array
-    if (p->num_inst > 0 && p->instructions) {
-        fwrite(p->instructions, sizeof(Instruction), p->num_inst, fp);
+    timed_lock_enter(&backing_store_lock);
+    swap_cache_set_capacity((uint64_t)config.swap_cache_size);
+    if (strcmp(config.backing_store_io, "mmap") == 0) {
+        if (!open_store(STORE_IO_MMAP))
+            printf("[ERROR] mmap is not available, the backing store uses plain file I/O\n");
+    } else {
+        open_store(STORE_IO_FILE);
     }
-    // 3. Write the variables array
-    if (p->num_var > 0 && p->variables) {
-        fwrite(p->variables, sizeof(Variable), p->num_var, fp);
+    timed_lock_leave(&backing_store_lock);
+}
+
+bool use_backing_store_io(const char *name) {
+    timed_lock_enter(&backing_store_lock);
+    bool ok = open_store(store_io_from_name(name));
+    timed_lock_leave(&backing_store_lock);
+    return ok;
+}
+
+const char *backing_store_io_name() {
+    return store_io_names[store_io];
+}
+
+// images are packed here before a write and read here before they are decoded, called with backing_store_lock held
+static char *scratch = NULL;
+static size_t scratch_size = 0;
+
+static char *scratch_buffer(size_t size) {
+    if (size > scratch_size) {
+        char *grown = realloc(scratch, size);
+        if (!grown) return NULL;
+        scratch = grown;
+        scratch_size = size;
     }
+    return scratch;
+}
 
-    fclose(fp);
-    // printf("[DEBUG] Process %s (PID: %d) moved to backing store.\n", p->name, p->pid);
+static FileEntry *file_entry(uint32_t id) {
+    if (id >= file_entries_capacity || !file_entries[id].live) return NULL;
+    return &file_entries[id];
 }
 
-// Reads the FIRST process from the backing store.
-Process* read_first_process_from_backing_store() {
-    FILE *fp = ensure_backing_store("rb");
-    if (!fp) return NULL;
+static bool file_grow_entries(uint32_t id) {
+    if (id < file_entries_capacity) return true;
+    uint32_t new_cap = file_entries_capacity ? file_entries_capacity : 64;
+    while (new_cap <= id) new_cap *= 2;
+    FileEntry *grown = realloc(file_entries, sizeof(FileEntry) * new_cap);
+    if (!grown) return false;
+    memset(grown + file_entries_capacity, 0, sizeof(FileEntry) * (new_cap - file_entries_capacity));
+    file_entries = grown;
+    file_entries_capacity = new_cap;
+    return true;
+}
 
-    Process *p = malloc(sizeof(Process));
-    if (!p) { fclose(fp); return NULL; }
+// images go at the end of the file, called with backing_store_lock held
+static void file_append(const char *buf, size_t used) {
+    FILE *fp = fopen(BACKING_STORE_FILENAME, "r+b");
+    if (!fp) fp = fopen(BACKING_STORE_FILENAME, "w+b");
+    if (!fp || _fseeki64(fp, (int64_t)file_end, SEEK_SET) != 0 || fwrite(buf, 1, used, fp) != used)
+        perror("Failed to write to backing store");
+    if (fp) fclose(fp);
+    // a failed write leaves entries that fail their checksum when read, each one is reported then
+    file_end += used;
+}
 
-    // 1. Read the main Process struct
-    if (fread(p, sizeof(Process), 1, fp) != 1) {
-        free(p);
-        fclose(fp);
-        return NULL; // File is empty or read error
+// called with backing_store_lock held, the whole batch is packed into one buffer and written with one call
+static void file_write(Process **procs, const uint32_t *ids, int count) {
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        if (procs[i]) total += process_image_bound(procs[i], 0);
+    }
+    char *buf = scratch_buffer(total);
+    if (!buf) {
+        printf("[ERROR] Out of memory packing %d processes for the backing store\n", count);
+        return;
     }
 
-    // 2. Allocate memory and read instructions
-    if (p->num_inst > 0) {
-        p->instructions = malloc(sizeof(Instruction) * p->num_inst);
-        if (!p->instructions) {
-            free(p);
-            fclose(fp);
-            return NULL;
+    size_t used = 0;
+    for (int i = 0; i < count; i++) {
+        if (!procs[i]) continue;
+        if (!file_grow_entries(ids[i])) {
+            printf("[ERROR] Out of memory for the backing store index, P%d is lost\n", procs[i]->pid);
+            continue;
         }
-        
-        // Read the instructions
-        if (fread(p->instructions, sizeof(Instruction), p->num_inst, fp) != p->num_inst) {
-            free(p->instructions);
-            free(p);
-            fclose(fp);
-            return NULL;
-        }
-        
-        // Fix any potential dangling pointers in sub_instructions
-        for (int i = 0; i < p->num_inst; i++) {
-            p->instructions[i].sub_instructions = NULL;
-        }
-    } else {
-        p->instructions = NULL;
+        size_t length = process_image_pack(procs[i], 0, buf + used);
+        file_entries[ids[i]] = (FileEntry){file_end + used, (uint32_t)length, true};
+        file_live++;
+        file_live_bytes += length;
+        used += length;
     }
+    file_append(buf, used);
+}
 
-    // 3. Allocate memory and read variables
-    if (p->num_var > 0) {
-        p->variables = malloc(sizeof(Variable) * p->variables_capacity);
-        if (!p->variables) {
-            free(p->instructions);
-            free(p);
-            fclose(fp);
-            return NULL;
-        }
-        
-        // Read the variables
-        if (fread(p->variables, sizeof(Variable), p->num_var, fp) != p->num_var) {
-            free(p->instructions);
-            free(p->variables);
-            free(p);
-            fclose(fp);
-            return NULL;
-        }
-    } else {
-        // FIX: A process must always have a valid, non-NULL variables array,
-        // even if it's empty, to match the behavior of generate_dummy_process.
-        int initial_capacity = p->variables_capacity > 0 ? p->variables_capacity : 8;
-        p->variables = (Variable *)calloc(initial_capacity, sizeof(Variable));
-        if (!p->variables) {
-            if(p->instructions) free(p->instructions);
-            free(p);
-            fclose(fp);
-            return NULL;
+// whole images back to back, already in the layout file_write gives them, called with backing_store_lock held
+static void file_write_images(const char *images, const uint32_t *lengths, const uint32_t *ids, int count) {
+    size_t used = 0;
+    for (int i = 0; i < count; i++) {
+        if (file_grow_entries(ids[i])) {
+            file_entries[ids[i]] = (FileEntry){file_end + used, lengths[i], true};
+            file_live++;
+            file_live_bytes += lengths[i];
+        } else {
+            // its bytes still go out, they count as dead space until the next compaction
+            printf("[ERROR] Out of memory for the backing store index, swap entry %u is lost\n", (unsigned)ids[i]);
         }
-        p->num_var = 0; // Ensure num_var is 0.
+        used += lengths[i];
     }
+    file_append(images, used);
+}
 
-    // 4. Make sure other pointers are initialized correctly
-    p->logs = NULL;
-    p->num_logs = 0;
-    p->for_depth = 0;
-    p->in_memory = 0;
-    p->ticks_ran_in_quantum = 0;
+// called with backing_store_lock held
+static Process *file_read(uint32_t id) {
+    FileEntry *e = file_entry(id);
+    if (!e) return NULL;
+    char *buf = scratch_buffer(e->length);
+    if (!buf) return NULL;
 
-    fclose(fp);
-    return p;
+    FILE *fp = fopen(BACKING_STORE_FILENAME, "rb");
+    bool ok = fp && _fseeki64(fp, (int64_t)e->offset, SEEK_SET) == 0 && fread(buf, 1, e->length, fp) == e->length;
+    if (fp) fclose(fp);
+    if (!ok) {
+        printf("[ERROR] Read from the backing store failed at offset %llu\n", (unsigned long long)e->offset);
+        return NULL;
+    }
+    return process_image_unpack(buf, e->length);
 }
 
-// Removes the FIRST process from the backing store by rewriting the file without it.
-void remove_first_process_from_backing_store() {
-    FILE *fp = fopen(BACKING_STORE_FILENAME, "rb");
-    if (!fp) {
-        return; // File doesn't exist
+static int file_by_offset(const void *a, const void *b) {
+    uint64_t x = file_entries[*(const uint32_t *)a].offset;
+    uint64_t y = file_entries[*(const uint32_t *)b].offset;
+    return x < y ? -1 : x > y;
+}
+
+// copies the live images into a new file back to back and puts it in place of the old one
+// called with backing_store_lock held
+static void file_compact() {
+    uint32_t *ids = malloc(sizeof(uint32_t) * file_live);
+    if (!ids) return;
+    uint32_t n = 0;
+    for (uint32_t id = 0; id < file_entries_capacity && n < file_live; id++) {
+        if (file_entries[id].live) ids[n++] = id;
     }
+    qsort(ids, n, sizeof(uint32_t), file_by_offset);
 
-    // Read and skip the first process
-    Process first_process;
-    if (fread(&first_process, sizeof(Process), 1, fp) != 1) {
-        fclose(fp);
-        return; // Empty file or read error
+    FILE *in = fopen(BACKING_STORE_FILENAME, "rb");
+    FILE *out = fopen(COMPACT_FILENAME, "wb");
+    bool ok = in && out;
+    uint64_t pos = 0;
+    for (uint32_t i = 0; ok && i < n; i++) {
+        FileEntry *e = &file_entries[ids[i]];
+        char *buf = scratch_buffer(e->length);
+        ok = buf && _fseeki64(in, (int64_t)e->offset, SEEK_SET) == 0 && fread(buf, 1, e->length, in) == e->length &&
+             fwrite(buf, 1, e->length, out) == e->length;
+        pos += e->length;
     }
+    if (in) fclose(in);
+    if (out && fclose(out) != 0) ok = false;
 
-    // Validate and skip the first process's data
-    if (first_process.num_inst < 0 || first_process.num_inst > 1000000 || 
-        first_process.num_var < 0 || first_process.num_var > 1000000) {
-        fclose(fp);
-        return; // Corrupt data
+    // the old file is only replaced once the new one is complete, on failure everything stays where it was
+    if (ok) {
+        remove(BACKING_STORE_FILENAME);
+        ok = rename(COMPACT_FILENAME, BACKING_STORE_FILENAME) == 0;
+    }
+    if (!ok) {
+        perror("Failed to compact backing store");
+        remove(COMPACT_FILENAME);
+        free(ids);
+        return;
     }
 
-    long first_data_size = sizeof(Instruction) * first_process.num_inst + 
-                          sizeof(Variable) * first_process.num_var;
-    if (fseek(fp, first_data_size, SEEK_CUR) != 0) {
-        fclose(fp);
-        return; // Seek error
+    pos = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        file_entries[ids[i]].offset = pos;
+        pos += file_entries[ids[i]].length;
     }
+    file_end = pos;
+    free(ids);
+}
 
-    // Read the rest of the file into memory
-    fseek(fp, 0, SEEK_END);
-    long file_size = ftell(fp);
-    long current_pos = sizeof(Process) + first_data_size;
-    long remaining_size = file_size - current_pos;
+// called with backing_store_lock held
+static void file_remove(uint32_t id) {
+    FileEntry *e = file_entry(id);
+    if (!e) return;
+    e->live = false;
+    file_live--;
+    file_live_bytes -= e->length;
 
-    if (remaining_size <= 0) {
+    if (file_live == 0) {
         // No more processes, but keep the empty file
-        fclose(fp);
-        fp = ensure_backing_store("wb");  // Truncate file but keep it
+        FILE *fp = fopen(BACKING_STORE_FILENAME, "wb");
         if (fp) fclose(fp);
+        file_end = 0;
+        file_live_bytes = 0;
         return;
     }
 
-    fseek(fp, current_pos, SEEK_SET);
-    char *buffer = malloc(remaining_size);
-    if (!buffer) {
-        fclose(fp);
-        return; // Memory allocation failed
-    }
+    // images are read back in any order, so the holes are squeezed out once they are as big as what is left
+    uint64_t dead = file_end - file_live_bytes;
+    if (dead >= COMPACT_THRESHOLD && dead >= file_live_bytes)
+        file_compact();
+}
 
-    size_t bytes_read = fread(buffer, 1, remaining_size, fp);
-    fclose(fp);
+// called with backing_store_lock held
+static void store_write(Process **procs, const uint32_t *ids, int count) {
+    if (count <= 0) return;
+    if (store_io == STORE_IO_MMAP)
+        mmap_store_write(procs, ids, count);
+    else
+        file_write(procs, ids, count);
+}
 
-    // Rewrite the file with remaining processes
-    fp = fopen(BACKING_STORE_FILENAME, "wb");
-    if (fp) {
-        fwrite(buffer, 1, bytes_read, fp);
-        fclose(fp);
-    }
+static void store_write_images(const char *images, const uint32_t *lengths, const uint32_t *ids, int count) {
+    if (count <= 0) return;
+    if (store_io == STORE_IO_MMAP)
+        mmap_store_write_images(images, lengths, ids, count);
+    else
+        file_write_images(images, lengths, ids, count);
+}
 
-    free(buffer);
+static Process *store_read(uint32_t id) {
+    if (store_io == STORE_IO_MMAP) return mmap_store_read(id);
+    return file_read(id);
 }
 
-void print_backing_store_contents() {
-    FILE *fp = ensure_backing_store("rb");
-    if (!fp) {
-        printf("Error accessing backing store.\n");
-        return;
+static void store_remove(uint32_t id) {
+    if (store_io == STORE_IO_MMAP)
+        mmap_store_remove(id);
+    else
+        file_remove(id);
+}
+
+// moves the oldest swap cache entries to the store under the same id until the cache is back under its capacity
+// the images go to the store as they were packed, nothing is decoded, called with backing_store_lock held
+static void write_back() {
+    uint32_t lengths[WRITE_BACK_BATCH];
+    uint32_t ids[WRITE_BACK_BATCH];
+    while (swap_cache_over_capacity()) {
+        int n = 0;
+        size_t used = 0;
+        while (n < WRITE_BACK_BATCH && swap_cache_over_capacity()) {
+            uint32_t id = swap_cache_oldest();
+            uint32_t stored = 0, raw = 0, length = 0;
+            swap_cache_entry_size(id, &stored, &raw);
+            char *buf = scratch_buffer(used + raw);
+            const char *image = NULL;
+            if (buf)
+                image = swap_cache_image(id, &length);
+            else
+                printf("[ERROR] Out of memory writing back swap cache entry %u, its process is lost\n", (unsigned)id);
+            if (image) memcpy(buf + used, image, length);
+            swap_cache_remove(id);
+            if (!image) {
+                // already reported, nothing left to save
+                timed_lock_enter(&swap_directory_lock);
+                swap_directory_remove(id);
+                timed_lock_leave(&swap_directory_lock);
+                continue;
+            }
+            lengths[n] = length;
+            ids[n++] = id;
+            used += length;
+            swap_cache_count_write_back();
+        }
+
+        // the entries stay where the scheduler can see them, they are only marked as being in the store
+        store_write_images(scratch, lengths, ids, n);
+        timed_lock_enter(&swap_directory_lock);
+        for (int i = 0; i < n; i++) {
+            SwapEntry *e = swap_directory_entry(ids[i]);
+            if (e) e->cached = false;
+        }
+        timed_lock_leave(&swap_directory_lock);
     }
+}
 
-    printf("\n--- Backing Store Contents ---\n");
-    int index = 0;
-    Process p;
-
-    // Read each process struct one by one
-    while (fread(&p, sizeof(Process), 1, fp) == 1) {
-        // Defensive: check for obviously invalid values
-        if (p.num_inst < 0 || p.num_inst > 1000000 || p.num_var < 0 || p.num_var > 1000000) {
-            printf("  [%d] Corrupt process entry detected (num_inst: %d, num_var: %d). Aborting print.\n", 
-                   index, p.num_inst, p.num_var);
-            break;
+void write_processes_to_backing_store(Process **procs, int count) {
+    if (count <= 0) return;
+    timed_lock_enter(&backing_store_lock);
+
+    uint32_t ids[WRITE_BACK_BATCH];
+    bool cached[WRITE_BACK_BATCH];
+    Process *direct[WRITE_BACK_BATCH];
+    uint32_t direct_ids[WRITE_BACK_BATCH];
+    for (int start = 0; start < count; start += WRITE_BACK_BATCH) {
+        int n = count - start < WRITE_BACK_BATCH ? count - start : WRITE_BACK_BATCH;
+
+        // listed before they are written, a swap-in for one of them is queued behind this write anyway
+        timed_lock_enter(&swap_directory_lock);
+        for (int i = 0; i < n; i++) {
+            Process *p = procs[start + i];
+            ids[i] = p ? swap_directory_add(p) : NO_SWAP_ENTRY;
+            if (p && ids[i] == NO_SWAP_ENTRY)
+                printf("[ERROR] Out of memory for the swap directory, P%d is lost\n", p->pid);
         }
+        timed_lock_leave(&swap_directory_lock);
 
-        printf("[%d] PID: %d, Name: P%s, Instructions: %d, Variables: %d\n",
-               index, p.pid, p.name, p.num_inst, p.num_var);
+        // the cache is off or out of memory for whatever it does not take, those go to the store
+        int num_direct = 0;
+        for (int i = 0; i < n; i++) {
+            cached[i] = false;
+            if (ids[i] == NO_SWAP_ENTRY) continue;
+            cached[i] = swap_cache_put(procs[start + i], ids[i]);
+            if (cached[i]) continue;
+            direct[num_direct] = procs[start + i];
+            direct_ids[num_direct++] = ids[i];
+        }
+        store_write(direct, direct_ids, num_direct);
+
+        timed_lock_enter(&swap_directory_lock);
+        for (int i = 0; i < n; i++) {
+            if (cached[i]) swap_directory_entry(ids[i])->cached = true;
+        }
+        timed_lock_leave(&swap_directory_lock);
+    }
+
+    write_back();
+    timed_lock_leave(&backing_store_lock);
+}
+
+void resize_swap_cache(uint64_t bytes) {
+    timed_lock_enter(&backing_store_lock);
+    swap_cache_set_capacity(bytes);
+    write_back();
+    timed_lock_leave(&backing_store_lock);
+}
+
+void write_process_to_backing_store(Process *p) {
+    if (!p) return;
+    write_processes_to_backing_store(&p, 1);
+}
+
+void release_mapped_program(Process *p) {
+    if (!p->program_map) return;
+    // processes are only freed with no lock held or with this one, so it can be taken here
+    timed_lock_enter(&backing_store_lock);
+    mmap_store_release(p->instructions, p->program_size, p->program_map, p->program_offset);
+    timed_lock_leave(&backing_store_lock);
+    p->instructions = NULL;
+    p->program_map = 0;
+}
+
+uint32_t pick_swap_in(uint64_t hole, uint64_t max_wait, SwapEntry *out, bool *fits) {
+    timed_lock_enter(&swap_directory_lock);
+    uint32_t id = swap_directory_oldest();
+    *fits = id != NO_SWAP_ENTRY && swap_directory_entry(id)->size <= hole;
+    if (id != NO_SWAP_ENTRY && !*fits && CPU_TICKS - swap_directory_entry(id)->swap_out_tick < max_wait) {
+        // the oldest has to wait for room, the biggest one that fits now goes ahead of it
+        uint32_t best = swap_directory_best_fit(hole);
+        if (best != NO_SWAP_ENTRY) {
+            id = best;
+            *fits = true;
+        }
+    }
+    if (id != NO_SWAP_ENTRY) *out = *swap_directory_entry(id);
+    timed_lock_leave(&swap_directory_lock);
+    return id;
+}
 
-        // Calculate the size of the dynamic data that follows the struct
-        long data_size = (sizeof(Instruction) * p.num_inst) + (sizeof(Variable) * p.num_var);
+Process *take_process_from_backing_store(uint32_t id) {
+    timed_lock_enter(&backing_store_lock);
+    timed_lock_enter(&swap_directory_lock);
+    SwapEntry *e = swap_directory_entry(id);
+    bool listed = e != NULL;
+    bool cached = listed && e->cached;
+    int pid = listed ? e->pid : 0;
+    timed_lock_leave(&swap_directory_lock);
 
-        // Seek past the dynamic data to get to the next process struct
-        if (fseek(fp, data_size, SEEK_CUR) != 0) {
-            printf("  Error seeking past data for PID %d. Backing store may be corrupt.\n", p.pid);
-            break;
+    Process *p = NULL;
+    if (listed) {
+        if (cached) {
+            p = swap_cache_read(id);
+            swap_cache_remove(id);
+        } else {
+            p = store_read(id);
+            store_remove(id);
         }
-        index++;
+        if (p) swap_cache_count_swap_in(cached);
+        else printf("[ERROR] P%d could not be read back from the backing store and is lost\n", pid);
+
+        timed_lock_enter(&swap_directory_lock);
+        swap_directory_remove(id);
+        timed_lock_leave(&swap_directory_lock);
     }
+    timed_lock_leave(&backing_store_lock);
+    return p;
+}
 
+static void print_entry(const SwapEntry *e, uint32_t id, void *ctx) {
+    int *index = ctx;
+    uint32_t stored, raw;
+    if (e->cached && swap_cache_entry_size(id, &stored, &raw))
+        printf("[%d] PID: %d, Name: P%s, Instructions: %d, Variables: %d (cached, %u of %u bytes)\n",
+               *index, e->pid, e->name, e->num_inst, e->num_var, stored, raw);
+    else
+        printf("[%d] PID: %d, Name: P%s, Instructions: %d, Variables: %d\n",
+               *index, e->pid, e->name, e->num_inst, e->num_var);
+    (*index)++;
+}
+
+void print_backing_store_contents() {
+    timed_lock_enter(&backing_store_lock);
+    timed_lock_enter(&swap_directory_lock);
+    printf("\n--- Backing Store Contents ---\n");
+    int index = 0;
+    swap_directory_walk(print_entry, &index);
     if (index == 0) {
         printf("Backing store is empty.\n");
     }
     printf("--- End of Backing Store ---\n\n");
-
-    fclose(fp);
-}
\ No newline at end of file
+    timed_lock_leave(&swap_directory_lock);
+    timed_lock_leave(&backing_store_lock);
+}
@@ -0,0 +1,754 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "benchmark.h"
+#include "process.h"
+#include "scheduler.h"
+#include "backing_store.h"
+#include "process_image.h"
+#include "swap_cache.h"
+#include "memory.h"
+#include "free_block_index.h"
+#include "frame_table.h"
+#include "random.h"
+
+#define DEFAULT_BENCH_PROCESSES 10000
+#define BENCH_TICKS 2000
+#define SCAN_ROUNDS 200
+#define DEFAULT_SWAP_PROCESSES 200
+#define SWAP_BENCH_BATCH 8          // swap-outs per write call, about what one busy tick queues
+#define DEFAULT_IMAGE_PROCESSES 200
+#define FUZZ_ROUNDS 500             // damaged copies of each image fed to the decoder
+#define DEFAULT_PLACEMENT_OPS 100000
+#define DEFAULT_BENCH_FRAMES 65536
+#define FRAME_BENCH_FAULTS 2000
+#define DEFAULT_PAGING_REFS 20000   // references per process
+
+static double elapsed_ns(LARGE_INTEGER start, LARGE_INTEGER end) {
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    return (double)(end.QuadPart - start.QuadPart) * 1e9 / freq.QuadPart;
+}
+
+// the scheduling fields as they were, inside each Process among everything else it holds, kept here as the baseline
+typedef struct {
+    char name[MAX_PROCESS_NAME];
+    int pid;
+    ProcessState state;
+    int program_counter;
+    uint64_t sleep_until_tick;
+    uint32_t ticks_ran_in_quantum;
+    int core;
+    uint8_t other_fields[sizeof(Process)];
+} BaselineProcess;
+
+// per-tick scheduler cost with count processes in the ready queue
+static void benchmark_sched(int count, Config config) {
+    if (scheduler_running) {
+        printf("[ERROR] Run the sched benchmark before scheduler-start\n");
+        return;
+    }
+
+    Process **procs = malloc(sizeof(Process *) * count);
+    if (!procs) {
+        printf("[ERROR] Failed to allocate benchmark processes\n");
+        return;
+    }
+
+    uint64_t rng = seed_random_state(3);
+    int created = 0;
+    while (created < count) {
+        Process *p = generate_random_process(config, &rng);
+        if (!p) break;
+        procs[created++] = p;
+    }
+    if (created == 0) {
+        free(procs);
+        return;
+    }
+
+    double tick_ns = time_scheduler_ticks(config, procs, created, BENCH_TICKS);
+
+    BaselineProcess *baseline = calloc(created, sizeof(BaselineProcess));
+    if (!baseline) {
+        printf("[ERROR] Failed to allocate benchmark processes\n");
+        for (int i = 0; i < created; i++)
+            free_process(procs[i]);
+        free(procs);
+        return;
+    }
+    for (int i = 0; i < created; i++) {
+        Process *p = procs[i];
+        baseline[i].pid = p->pid;
+        baseline[i].state = PROC_STATE(p);
+        baseline[i].program_counter = PROC_PC(p);
+        baseline[i].sleep_until_tick = PROC_SLEEP_UNTIL(p);
+        baseline[i].ticks_ran_in_quantum = PROC_QUANTUM(p);
+        baseline[i].core = PROC_CORE(p);
+    }
+
+    // the wake-up and quantum checks over every process, straight through the table and over the old layout
+    // recycled slots can be anywhere, the table scan needs the processes to hold a run of them
+    int first_slot = procs[0]->slot;
+    int last_slot = procs[0]->slot;
+    for (int i = 1; i < created; i++) {
+        if (procs[i]->slot < first_slot) first_slot = procs[i]->slot;
+        if (procs[i]->slot > last_slot) last_slot = procs[i]->slot;
+    }
+    bool contiguous = last_slot - first_slot + 1 == created;
+    long due_by_slot = 0;
+    long due_baseline = 0;
+    LARGE_INTEGER start, end;
+
+    double by_slot_ns = 0.0;
+    if (contiguous) {
+        QueryPerformanceCounter(&start);
+        for (int r = 0; r < SCAN_ROUNDS; r++) {
+            for (int slot = first_slot; slot < first_slot + created; slot++) {
+                uint8_t state = SCHED_FIELD(slot, state);
+                if ((state == SLEEPING && CPU_TICKS >= SCHED_FIELD(slot, sleep_until_tick)) ||
+                    (state == RUNNING && SCHED_FIELD(slot, ticks_ran_in_quantum) >= (uint32_t)config.quantum_cycles))
+                    due_by_slot++;
+            }
+        }
+        QueryPerformanceCounter(&end);
+        by_slot_ns = elapsed_ns(start, end) / SCAN_ROUNDS;
+    }
+
+    QueryPerformanceCounter(&start);
+    for (int r = 0; r < SCAN_ROUNDS; r++) {
+        for (int i = 0; i < created; i++) {
+            BaselineProcess *b = &baseline[i];
+            if ((b->state == SLEEPING && CPU_TICKS >= b->sleep_until_tick) ||
+                (b->state == RUNNING && b->ticks_ran_in_quantum >= (uint32_t)config.quantum_cycles))
+                due_baseline++;
+        }
+    }
+    QueryPerformanceCounter(&end);
+    double baseline_ns = elapsed_ns(start, end) / SCAN_ROUNDS;
+
+    printf("\n--- sched benchmark (%s, %d cores, %d processes) ---\n", config.scheduler, config.num_cpu, created);
+    printf("Scheduler tick:          %10.1f ns (%d ticks)\n", tick_ns, BENCH_TICKS);
+    if (contiguous)
+        printf("State scan of table:     %10.1f ns (%.2f ns per process)\n", by_slot_ns, by_slot_ns / created);
+    printf("State scan of structs:   %10.1f ns (%.2f ns per process)\n", baseline_ns, baseline_ns / created);
+    printf("Processes due:           %10ld\n", due_baseline / SCAN_ROUNDS);
+    if (contiguous && due_by_slot != due_baseline)
+        printf("[WARNING] The two scans disagree (%ld vs %ld)\n", due_by_slot, due_baseline);
+    printf("--- end of benchmark ---\n\n");
+
+    free(baseline);
+    for (int i = 0; i < created; i++)
+        free_process(procs[i]);
+    free(procs);
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// sorts ns in place
+static void print_latency(const char *label, double *ns, int n) {
+    qsort(ns, n, sizeof(double), compare_double);
+    printf("  %-22s p50 %9.1f us   p99 %9.1f us   max %9.1f us\n", label,
+           ns[n / 2] / 1000.0, ns[(int)(n * 0.99)] / 1000.0, ns[n - 1] / 1000.0);
+}
+
+// writes every process out in tick-sized batches, then reads and removes them one at a time
+static void benchmark_swap_io(const char *io, const char *label, Process **procs, int count) {
+    if (!use_backing_store_io(io)) {
+        printf("%s: not available here\n", label);
+        return;
+    }
+
+    int batches = (count + SWAP_BENCH_BATCH - 1) / SWAP_BENCH_BATCH;
+    double *write_ns = malloc(sizeof(double) * batches);
+    double *read_ns = malloc(sizeof(double) * count);
+    if (!write_ns || !read_ns) {
+        printf("[ERROR] Failed to allocate benchmark timings\n");
+        free(write_ns);
+        free(read_ns);
+        return;
+    }
+
+    double bytes = 0;
+    for (int i = 0; i < count; i++)
+        bytes += process_image_size(procs[i], 0);
+
+    LARGE_INTEGER all_start, all_end, start, end;
+    QueryPerformanceCounter(&all_start);
+    for (int b = 0; b < batches; b++) {
+        int first = b * SWAP_BENCH_BATCH;
+        int n = count - first < SWAP_BENCH_BATCH ? count - first : SWAP_BENCH_BATCH;
+        QueryPerformanceCounter(&start);
+        write_processes_to_backing_store(procs + first, n);
+        QueryPerformanceCounter(&end);
+        write_ns[b] = elapsed_ns(start, end);
+    }
+    QueryPerformanceCounter(&all_end);
+    double write_total = elapsed_ns(all_start, all_end);
+
+    int read_back = 0;
+    QueryPerformanceCounter(&all_start);
+    for (int i = 0; i < count; i++) {
+        // oldest first, the way the scheduler picks when memory is free
+        SwapEntry e;
+        bool fits;
+        QueryPerformanceCounter(&start);
+        Process *p = take_process_from_backing_store(pick_swap_in(UINT64_MAX, 0, &e, &fits));
+        QueryPerformanceCounter(&end);
+        read_ns[i] = elapsed_ns(start, end);
+        if (p) {
+            read_back++;
+            free_process(p);
+        }
+    }
+    QueryPerformanceCounter(&all_end);
+    double read_total = elapsed_ns(all_start, all_end);
+
+    printf("%s:\n", label);
+    printf("  swap-out                %9.1f MB/s  %9.0f processes/s\n",
+           bytes / (write_total / 1e9) / 1e6, count / (write_total / 1e9));
+    print_latency("per batch", write_ns, batches);
+    printf("  swap-in                 %9.1f MB/s  %9.0f processes/s  (%d of %d read back)\n",
+           bytes / (read_total / 1e9) / 1e6, count / (read_total / 1e9), read_back, count);
+    print_latency("per process", read_ns, count);
+
+    free(write_ns);
+    free(read_ns);
+}
+
+// the same processes through each backing store implementation
+static void benchmark_swap(int count, Config config) {
+    if (scheduler_running) {
+        printf("[ERROR] Run the swap benchmark before scheduler-start, it empties the backing store\n");
+        return;
+    }
+
+    Process **procs = malloc(sizeof(Process *) * count);
+    if (!procs) {
+        printf("[ERROR] Failed to allocate benchmark processes\n");
+        return;
+    }
+
+    uint64_t rng = seed_random_state(4);
+    int created = 0;
+    double bytes = 0;
+    while (created < count) {
+        Process *p = generate_random_process(config, &rng);
+        if (!p) break;
+        bytes += process_image_size(p, 0);
+        procs[created++] = p;
+    }
+    if (created == 0) {
+        free(procs);
+        return;
+    }
+
+    printf("\n--- swap benchmark (%d processes, %.1f KB average image, batches of %d) ---\n",
+           created, bytes / created / 1024.0, SWAP_BENCH_BATCH);
+    // the stores on their own, then the file store behind the swap cache
+    resize_swap_cache(0);
+    benchmark_swap_io("file", "file", procs, created);
+    benchmark_swap_io("mmap", "mmap", procs, created);
+
+    uint64_t cache_size = config.swap_cache_size > 0 ? (uint64_t)config.swap_cache_size : DEFAULT_SWAP_CACHE_SIZE;
+    SwapCacheStats before, after;
+    swap_cache_stats(&before);
+    resize_swap_cache(cache_size);
+    benchmark_swap_io("file", "file + swap cache", procs, created);
+    swap_cache_stats(&after);
+    uint64_t hits = after.hits - before.hits;
+    uint64_t swap_ins = hits + after.misses - before.misses;
+    uint64_t raw = after.raw_bytes - before.raw_bytes;
+    uint64_t stored = after.stored_bytes - before.stored_bytes;
+    printf("  %llu KB cache: %llu of %llu swap-ins hit, %llu write-backs, compression %.2fx\n",
+           (unsigned long long)(cache_size / 1024), (unsigned long long)hits, (unsigned long long)swap_ins,
+           (unsigned long long)(after.write_backs - before.write_backs), stored > 0 ? (double)raw / stored : 0.0);
+    printf("--- end of benchmark ---\n\n");
+
+    // back to what the config asked for
+    use_backing_store_io(config.backing_store_io);
+    resize_swap_cache((uint64_t)config.swap_cache_size);
+
+    for (int i = 0; i < created; i++)
+        free_process(procs[i]);
+    free(procs);
+}
+
+// runs a process partway so its loop stack, variables and log ring are not empty
+static void run_partway(Process *p, Config config, uint64_t *rng) {
+    int steps = (int)(next_random(rng) % (uint64_t)(p->num_inst + 1));
+    PROC_CORE(p) = -1;      // keeps its PRINTs out of the log stream
+    for (int i = 0; i < steps; i++) {
+        if (PROC_PC(p) >= p->num_inst && p->for_depth == 0) break;
+        PROC_STATE(p) = RUNNING;
+        execute_instruction(p, config);
+    }
+}
+
+// varint length of the pid at the front of the body, mutations leave it alone so an accepted copy
+// only ever touches the scheduling table slot of its own process
+static size_t pid_bytes(const char *image) {
+    size_t n = 1;
+    while (((unsigned char)image[PROCESS_IMAGE_HEADER_SIZE + n - 1] & 0x80) && n < 10) n++;
+    return n;
+}
+
+static void mutate(char *buf, size_t *len, size_t keep_from, size_t keep_to, uint64_t *rng) {
+    int kind = (int)(next_random(rng) % 3);
+    if (kind == 0) {
+        *len = (size_t)(next_random(rng) % *len);     // truncated
+        return;
+    }
+
+    int edits = 1 + (int)(next_random(rng) % 4);
+    for (int i = 0; i < edits; i++) {
+        size_t at = (size_t)(next_random(rng) % *len);
+        if (at >= keep_from && at < keep_to) continue;
+        if (kind == 1) {
+            buf[at] ^= (char)(1 << (next_random(rng) % 8));     // bit flip
+        } else {
+            static const unsigned char edges[] = {0x00, 0x7f, 0x80, 0xff};
+            buf[at] = (char)edges[next_random(rng) % 4];          // boundary byte
+        }
+    }
+}
+
+// encode/decode cost and round trips of the process image format, then a fuzz pass over the decoder
+static void benchmark_image(int count, Config config) {
+    if (scheduler_running) {
+        printf("[ERROR] Run the image benchmark before scheduler-start\n");
+        return;
+    }
+
+    double *encode_ns = malloc(sizeof(double) * count);
+    double *decode_ns = malloc(sizeof(double) * count);
+    if (!encode_ns || !decode_ns) {
+        printf("[ERROR] Failed to allocate benchmark timings\n");
+        free(encode_ns);
+        free(decode_ns);
+        return;
+    }
+
+    uint64_t rng = seed_random_state(5);
+    int created = 0, lossless = 0;
+    long mutants = 0, accepted = 0;
+    double image_bytes = 0, struct_bytes = 0;
+    LARGE_INTEGER start, end;
+
+    while (created < count) {
+        Process *p = generate_random_process(config, &rng);
+        if (!p) break;
+        run_partway(p, config, &rng);
+
+        size_t bound = process_image_bound(p, 0);
+        char *image = malloc(bound);
+        char *again = malloc(bound);
+        char *damaged = malloc(bound);
+        if (!image || !again || !damaged) {
+            free(image);
+            free(again);
+            free(damaged);
+            free_process(p);
+            break;
+        }
+
+        QueryPerformanceCounter(&start);
+        size_t size = process_image_pack(p, 0, image);
+        QueryPerformanceCounter(&end);
+        encode_ns[created] = elapsed_ns(start, end);
+
+        QueryPerformanceCounter(&start);
+        Process *copy = process_image_unpack(image, size);
+        QueryPerformanceCounter(&end);
+        decode_ns[created] = elapsed_ns(start, end);
+
+        // lossless if the decoded process packs to the same bytes, and the measured length agrees
+        if (copy && process_image_size(p, 0) == size && process_image_bound(copy, 0) <= bound &&
+            process_image_pack(copy, 0, again) == size && memcmp(image, again, size) == 0)
+            lossless++;
+        free_process(copy);
+
+        image_bytes += size;
+        struct_bytes += sizeof(Process) + sizeof(Instruction) * process_program_size(p) + sizeof(Variable) * p->num_var;
+
+        size_t keep_from = PROCESS_IMAGE_HEADER_SIZE;
+        size_t keep_to = keep_from + pid_bytes(image);
+        for (int r = 0; r < FUZZ_ROUNDS; r++) {
+            size_t len = size;
+            memcpy(damaged, image, size);
+            mutate(damaged, &len, keep_from, keep_to, &rng);
+            // every other copy gets a valid checksum, so the damage reaches the parser
+            if (r % 2) process_image_seal(damaged, len);
+
+            Process *q = process_image_unpack(damaged, len);
+            mutants++;
+            if (q) {
+                accepted++;
+                process_image_size(q, 0);
+                free_process(q);
+            }
+        }
+
+        free(image);
+        free(again);
+        free(damaged);
+        free_process(p);
+        created++;
+    }
+
+    if (created > 0) {
+        printf("\n--- image benchmark (%d processes) ---\n", created);
+        printf("  average image           %9.1f KB   (%.1f KB as raw structs)\n",
+               image_bytes / created / 1024.0, struct_bytes / created / 1024.0);
+        print_latency("encode", encode_ns, created);
+        print_latency("decode", decode_ns, created);
+        printf("  lossless round trips    %9d of %d\n", lossless, created);
+        printf("  fuzzed images           %9ld, %ld decoded, %ld rejected\n", mutants, accepted, mutants - accepted);
+        printf("--- end of benchmark ---\n\n");
+    }
+
+    free(encode_ns);
+    free(decode_ns);
+}
+
+// one placement policy over an allocate/free trace, the same trace for every policy since rng starts the same
+static void benchmark_placement_policy(const char *policy, Process *procs, int count, Config config) {
+    set_placement_policy(policy);
+    memory_head = init_memory_block(config.max_overall_mem);
+    update_free_memory();
+    CPUStats before = stats;
+
+    uint64_t rng = 0x9E3779B97F4A7C15ull;
+    int *live = malloc(sizeof(int) * count);
+    if (!live) return;
+    int num_live = 0;
+    int next = 0;
+    int tries = 0;
+    double fragmentation = 0;
+    double free_blocks = 0;
+
+    for (int op = 0; op < count; op++) {
+        // a free for every two allocations until memory is full, then one whenever an allocation does not fit
+        if (num_live > 0 && next_random(&rng) % 3 == 0) {
+            int i = (int)(next_random(&rng) % (uint64_t)num_live);
+            free_process_memory(&procs[live[i]], &memory_head);
+            live[i] = live[--num_live];
+            continue;
+        }
+
+        Process *p = &procs[next];
+        p->memory_allocation = config.min_mem_per_proc +
+                               next_random(&rng) % (uint64_t)(config.max_mem_per_proc - config.min_mem_per_proc + 1);
+        timed_lock_enter(&memory_lock);
+        fragmentation += memory.free_memory > 0 ? 1.0 - (double)free_index_largest() / memory.free_memory : 0.0;
+        free_blocks += free_index_count();
+        MemoryBlock *b = allocate_block(p->memory_allocation, p->pid);
+        timed_lock_leave(&memory_lock);
+        update_free_memory();
+        tries++;
+        if (b) {
+            live[num_live++] = next;
+            next++;
+        } else if (num_live > 0) {
+            int i = (int)(next_random(&rng) % (uint64_t)num_live);
+            free_process_memory(&procs[live[i]], &memory_head);
+            live[i] = live[--num_live];
+        }
+    }
+
+    uint64_t placed = stats.placements - before.placements;
+    uint64_t failed = stats.placement_failures - before.placement_failures;
+    printf("%-10s %12.1f %12llu %11.1f%% %12.1f%% %12.1f\n", policy,
+           placed + failed > 0 ? (double)(stats.placement_ns - before.placement_ns) / (placed + failed) : 0.0,
+           (unsigned long long)(stats.placement_max_ns), placed + failed > 0 ? 100.0 * failed / (placed + failed) : 0.0,
+           tries > 0 ? 100.0 * fragmentation / tries : 0.0, tries > 0 ? free_blocks / tries : 0.0);
+    free(live);
+}
+
+// every placement policy over the same trace of allocations and frees on an empty memory
+static void benchmark_placement(int count, Config config) {
+    if (scheduler_running) {
+        printf("[ERROR] Run the placement benchmark before scheduler-start, it starts memory over\n");
+        return;
+    }
+    if (config.max_overall_mem <= 0 || config.max_mem_per_proc < config.min_mem_per_proc) {
+        printf("[ERROR] Run initialize before the placement benchmark\n");
+        return;
+    }
+
+    // a process slot per allocation, only pid and memory_allocation are used
+    Process *procs = calloc(count, sizeof(Process));
+    if (!procs) {
+        printf("[ERROR] Failed to allocate benchmark processes\n");
+        return;
+    }
+    for (int i = 0; i < count; i++)
+        procs[i].pid = i + 1;
+
+    CPUStats saved = stats;
+    printf("\n--- placement benchmark (%d operations, %d B memory, %d-%d B per process) ---\n",
+           count, config.max_overall_mem, config.min_mem_per_proc, config.max_mem_per_proc);
+    printf("%-10s %12s %12s %12s %13s %12s\n", "policy", "ns/place", "max ns", "failed", "ext. frag", "free blocks");
+    const char *policies[] = {"first-fit", "next-fit", "best-fit", "worst-fit"};
+    for (int i = 0; i < 4; i++) {
+        stats.placement_max_ns = 0;
+        benchmark_placement_policy(policies[i], procs, count, config);
+    }
+    printf("--- end of benchmark ---\n\n");
+
+    // back to an empty memory under the configured policy
+    set_placement_policy(config.placement[0] ? config.placement : "first-fit");
+    memory_head = init_memory_block(config.max_overall_mem);
+    update_free_memory();
+    stats = saved;
+    free(procs);
+}
+
+// the frame table as it was, an array of structs scanned front to back, kept here as the baseline
+typedef struct {
+    bool occupied;
+    int pid;
+    int page_number;
+    uint64_t last_used_tick;
+} BaselineFrame;
+
+static int baseline_fault(BaselineFrame *frames, int n, int pid, uint64_t tick) {
+    int victim = -1;
+    for (int i = 0; i < n && victim < 0; i++) {
+        if (!frames[i].occupied) victim = i;
+    }
+    if (victim < 0) {
+        uint64_t oldest = UINT64_MAX;
+        for (int i = 0; i < n; i++) {
+            if (frames[i].last_used_tick < oldest) {
+                oldest = frames[i].last_used_tick;
+                victim = i;
+            }
+        }
+    }
+    frames[victim] = (BaselineFrame){true, pid, 0, tick};
+    return victim;
+}
+
+static int table_fault(FrameTable *t, int pid, uint64_t tick) {
+    int victim = frame_table_find_free(t);
+    if (victim < 0) victim = frame_table_find_lru(t);
+    frame_table_claim(t, victim, pid, 0, tick);
+    return victim;
+}
+
+// page fault frame selection on a full table where a quarter of the faults follow a process freeing a frame,
+// the same sequence against the old array of structs and the bitmap and vector min search
+static void benchmark_frames(int count) {
+    BaselineFrame *baseline = calloc(count, sizeof(BaselineFrame));
+    FrameTable table;
+    if (!baseline || !frame_table_init(&table, count)) {
+        printf("[ERROR] Failed to allocate %d benchmark frames\n", count);
+        free(baseline);
+        return;
+    }
+
+    // every frame used once, in a random order of ticks so the oldest is anywhere
+    uint64_t rng = seed_random_state(5);
+    for (int i = 0; i < count; i++) {
+        uint64_t tick = next_random(&rng) % ((uint64_t)count * 4);
+        baseline[i] = (BaselineFrame){true, i, 0, tick};
+        frame_table_claim(&table, i, i, 0, tick);
+    }
+    uint64_t tick = (uint64_t)count * 4;
+
+    uint64_t ops_rng = rng;
+    long mismatches = 0;
+    LARGE_INTEGER start, end;
+    QueryPerformanceCounter(&start);
+    uint64_t t = tick;
+    for (int f = 0; f < FRAME_BENCH_FAULTS; f++) {
+        if (next_random(&rng) % 4 == 0)
+            baseline[next_random(&rng) % (uint64_t)count].occupied = false;
+        baseline_fault(baseline, count, f, t++);
+    }
+    QueryPerformanceCounter(&end);
+    double baseline_ns = elapsed_ns(start, end) / FRAME_BENCH_FAULTS;
+
+    rng = ops_rng;
+    t = tick;
+    QueryPerformanceCounter(&start);
+    for (int f = 0; f < FRAME_BENCH_FAULTS; f++) {
+        if (next_random(&rng) % 4 == 0)
+            frame_table_release(&table, (int)(next_random(&rng) % (uint64_t)count));
+        table_fault(&table, f, t++);
+    }
+    QueryPerformanceCounter(&end);
+    double table_ns = elapsed_ns(start, end) / FRAME_BENCH_FAULTS;
+
+    // both have to have evicted the same frames
+    for (int i = 0; i < count; i++) {
+        if (baseline[i].pid != table.pid[i]) mismatches++;
+    }
+
+    printf("\n--- frame benchmark (%d frames, %d faults, %s min search) ---\n", count, FRAME_BENCH_FAULTS,
+           frame_table_simd_name());
+    printf("Array of structs:        %10.1f ns per fault\n", baseline_ns);
+    printf("Bitmap and vector min:   %10.1f ns per fault (%.1fx)\n", table_ns,
+           table_ns > 0 ? baseline_ns / table_ns : 0.0);
+    if (mismatches)
+        printf("[WARNING] The two picked different frames for %ld of them\n", mismatches);
+    printf("--- end of benchmark ---\n\n");
+
+    frame_table_destroy(&table);
+    free(baseline);
+}
+
+// addresses a process touches: mostly FOR loops of READ/WRITE walking a run of its pages a word at a time,
+// between them bursts on a few hot pages
+static void make_paging_trace(uint16_t *trace, int count, int num_pages, int page_size, uint64_t *rng) {
+    int hot = (int)(next_random(rng) % (uint64_t)num_pages);
+    for (int i = 0; i < count;) {
+        if (next_random(rng) % 10 < 7) {
+            int first = (int)(next_random(rng) % (uint64_t)num_pages);
+            int pages = 1 + (int)(next_random(rng) % (uint64_t)(num_pages - first));
+            for (int addr = first * page_size; addr + 2 <= (first + pages) * page_size && i < count; addr += 2)
+                trace[i++] = (uint16_t)addr;
+        } else {
+            for (int j = 0; j < 32 && i < count; j++) {
+                int page = (hot + (int)(next_random(rng) % 3)) % num_pages;
+                trace[i++] = (uint16_t)(page * page_size + 2 * (next_random(rng) % (uint64_t)(page_size / 2)));
+            }
+        }
+    }
+}
+
+// demand paging over the same traces with and without prefetch, one process per core referencing an address a
+// tick, as many cores as fit in the frames together so only their own quotas ever evict
+static void benchmark_paging(int count, Config config) {
+    if (scheduler_running) {
+        printf("[ERROR] Run the paging benchmark before scheduler-start, it uses the frame table\n");
+        return;
+    }
+    if (config.mem_per_frame <= 0 || config.max_mem_per_proc < config.mem_per_frame) {
+        printf("[ERROR] Run initialize before the paging benchmark, with max-mem-per-proc at least mem-per-frame\n");
+        return;
+    }
+
+    int page_size = config.mem_per_frame;
+    int num_pages = (config.max_mem_per_proc > 65536 ? 65536 : config.max_mem_per_proc) / page_size;
+    int num_frames = config.max_overall_mem / page_size;
+    int cores = config.num_cpu > 0 ? config.num_cpu : 1;
+    if (cores > num_frames / num_pages) cores = num_frames / num_pages;
+    if (cores < 1) {
+        printf("[ERROR] max-overall-mem has no room for a process of max-mem-per-proc\n");
+        return;
+    }
+
+    Process **procs = calloc(cores, sizeof(Process *));
+    uint16_t *traces = malloc(sizeof(uint16_t) * (size_t)cores * count);
+    if (!procs || !traces) {
+        printf("[ERROR] Failed to allocate benchmark traces\n");
+        free(procs);
+        free(traces);
+        return;
+    }
+    uint64_t rng = seed_random_state(6);
+    for (int c = 0; c < cores; c++) {
+        procs[c] = calloc(1, sizeof(Process));
+        if (procs[c]) procs[c]->page_table = calloc(num_pages, sizeof(PageTableEntry));
+        if (!procs[c] || !procs[c]->page_table) {
+            printf("[ERROR] Failed to allocate benchmark processes\n");
+            cores = c;
+            if (procs[c]) free(procs[c]);
+            break;
+        }
+        procs[c]->num_pages = num_pages;
+        make_paging_trace(&traces[(size_t)c * count], count, num_pages, page_size, &rng);
+    }
+
+    CPUStats saved = stats;
+    uint64_t saved_ticks = CPU_TICKS;
+    int prefetch = config.prefetch_pages > 0 ? config.prefetch_pages : DEFAULT_PREFETCH_PAGES;
+    int window = config.working_set_window > 0 ? config.working_set_window : DEFAULT_WORKING_SET_WINDOW;
+    printf("\n--- paging benchmark (%d processes of %d pages, %d frames, %d references each) ---\n",
+           cores, num_pages, num_frames, count);
+    printf("%-12s %10s %12s %12s %10s %10s %10s %12s %10s\n", "prefetch", "faults", "per 1k refs", "prefetched",
+           "hits", "grows", "shrinks", "avg frames", "ns/ref");
+    for (int run = 0; run < 2; run++) {
+        int depth = run == 0 ? 0 : prefetch;
+        set_paging(window, config.page_fault_high, config.page_fault_low, depth);
+        for (int c = 0; c < cores; c++) {
+            Process *p = procs[c];
+            PageTableEntry *table = p->page_table;
+            memset(p, 0, sizeof(Process));
+            memset(table, 0, sizeof(PageTableEntry) * num_pages);
+            p->pid = -2 - c;
+            p->page_table = table;
+            p->num_pages = num_pages;
+        }
+        memset(&stats, 0, sizeof(stats));
+        CPU_TICKS = 0;
+
+        // frames held per process, summed every tick
+        uint64_t resident = 0;
+        LARGE_INTEGER start, end;
+        QueryPerformanceCounter(&start);
+        for (int i = 0; i < count; i++) {
+            for (int c = 0; c < cores; c++) {
+                reference_page(procs[c], traces[(size_t)c * count + i]);
+                resident += procs[c]->resident_pages;
+            }
+            CPU_TICKS++;
+            sample_working_sets(procs, cores);
+        }
+        QueryPerformanceCounter(&end);
+        for (int c = 0; c < cores; c++)
+            free_process_memory(procs[c], &memory_head);
+
+        uint64_t refs = (uint64_t)count * cores;
+        char label[16];
+        snprintf(label, sizeof(label), depth > 0 ? "%d pages" : "off", depth);
+        printf("%-12s %10d %12.2f %12d %10d %10d %10d %12.1f %10.1f\n", label, stats.num_page_faults,
+               1000.0 * stats.num_page_faults / refs, stats.num_prefetched_pages, stats.num_prefetch_hits,
+               stats.num_frame_quota_grows, stats.num_frame_quota_shrinks, (double)resident / refs,
+               elapsed_ns(start, end) / refs);
+    }
+    printf("--- end of benchmark ---\n\n");
+
+    set_paging(config.working_set_window, config.page_fault_high, config.page_fault_low, config.prefetch_pages);
+    stats = saved;
+    CPU_TICKS = saved_ticks;
+    for (int c = 0; c < cores; c++) {
+        free(procs[c]->page_table);
+        free(procs[c]);
+    }
+    free(procs);
+    free(traces);
+}
+
+void run_benchmark(const char *args, Config config) {
+    char name[32];
+    int count = 0;
+    int parsed = sscanf(args, "%31s %d", name, &count);
+    if (parsed < 1) {
+        printf("Usage: benchmark <sched|swap|image|placement|frames|paging> [count]\n");
+        return;
+    }
+
+    if (strcmp(name, "sched") == 0) {
+        benchmark_sched(parsed == 2 && count > 0 ? count : DEFAULT_BENCH_PROCESSES, config);
+    } else if (strcmp(name, "swap") == 0) {
+        benchmark_swap(parsed == 2 && count > 0 ? count : DEFAULT_SWAP_PROCESSES, config);
+    } else if (strcmp(name, "image") == 0) {
+        benchmark_image(parsed == 2 && count > 0 ? count : DEFAULT_IMAGE_PROCESSES, config);
+    } else if (strcmp(name, "placement") == 0) {
+        benchmark_placement(parsed == 2 && count > 0 ? count : DEFAULT_PLACEMENT_OPS, config);
+    } else if (strcmp(name, "frames") == 0) {
+        benchmark_frames(parsed == 2 && count > 0 ? count : DEFAULT_BENCH_FRAMES);
+    } else if (strcmp(name, "paging") == 0) {
+        benchmark_paging(parsed == 2 && count > 0 ? count : DEFAULT_PAGING_REFS, config);
+    } else {
+        printf("Unknown benchmark '%s'.\n", name);
+    }
+}
@@ -8,6 +8,13 @@
 #include "process.h"
 #include "memory.h"
 #include "backing_store.h"
+#include "log_stream.h"
+#include "clock.h"
+#include "arena.h"
+#include "benchmark.h"
+#include "locks.h"
+#include "swap_io.h"
+#include "finished_archive.h"
 // global variables
 static bool initialized = false;
 static bool running = true;
@@ -46,6 +53,10 @@ void runCLI() {
         // exit
         if (strcmp(command, "exit") == 0) {
             printf("Exiting...\n");
+            stop_scheduler();
+            // queued swaps are written out before the process exits
+            stop_swap_io();
+            stop_log_stream();
             running = false;
         }
         // help
@@ -77,11 +88,11 @@ void runCLI() {
         }
         // screen -ls
         else if (strcmp(command, "screen -ls") == 0) {
-            screen_list(get_num_cores(), get_cpu_cores(), get_finished_count(), get_finished_processes());
+            screen_list();
         }
         // screen -c
         else if (strncmp(command, "screen -c ", 10) == 0) {
-            screen_create_with_code(command + 10);
+            screen_create_with_code(command + 10, config);
         }
         // scheduler-start
         else if (strcmp(command, "scheduler-start") == 0) {
@@ -95,18 +106,26 @@ void runCLI() {
         }
         // report-util
         else if (strcmp(command, "report-util") == 0) {
-            report_utilization(get_num_cores(), get_cpu_cores(), get_finished_count(), get_finished_processes());
+            report_utilization();
         }
         // process-smi
         else if (strcmp(command, "process-smi") == 0) {
-            process_smi(get_num_cores(), get_cpu_cores());
+            process_smi();
         }
         else if (strcmp(command, "vmstat") == 0) {
-            vmstat(&memory, &stats);
+            vmstat();
         }
         else if (strcmp(command, "backing-list") == 0) {
             print_backing_store_contents();
         }
+        // lock-stats
+        else if (strcmp(command, "lock-stats") == 0) {
+            print_lock_stats();
+        }
+        // benchmark
+        else if (strncmp(command, "benchmark", 9) == 0) {
+            run_benchmark(command + 9, config);
+        }
         // unknown command
         else {
             printColor(yellow, "Unknown command.\n");
@@ -155,11 +174,22 @@ void printCommandList() {
     printf("scheduler-start - continuously generates a batch of processes for the CPU scheduler. Each process is accessible via the 'screen' command.\n");
     printf("scheduler-stop - stops generating processes\n");
     printf("report-util - for generating CPU utilization report\n");
+    printf("lock-stats - acquisitions, contention and hold times for each lock\n");
+    printf("benchmark sched [count] - time scheduler ticks with count processes queued, run before scheduler-start\n");
+    printf("benchmark swap [count] - swap throughput and latency of each backing store implementation, run before scheduler-start\n");
+    printf("benchmark image [count] - process image encode/decode cost, round trips and a fuzz pass over the decoder\n");
+    printf("benchmark placement [count] - allocation time and fragmentation of each placement policy over count allocations and frees\n");
+    printf("benchmark frames [count] - page fault frame selection over count frames, the old scan against the bitmap and vector min\n");
+    printf("benchmark paging [count] - page faults of READ/WRITE loops over count references per process, with and without prefetch\n");
 }
 
 // initialize
 void initialize(){
     load_config(&config);
+    init_arena_cache();
+    init_sched_table();
+    init_scheduler_locks();
+    init_process_table();
     printColor(yellow, "Configuration loaded successfully.\n");
     
     printf("  num-cpu: %d\n", config.num_cpu);
@@ -173,9 +203,40 @@ void initialize(){
     printf("  mem-per-frame: %d\n", config.mem_per_frame);
     printf("  max-mem-per-proc: %d\n", config.max_mem_per_proc);
     printf("  min-mem-per-proc: %d\n", config.min_mem_per_proc);
+    printf("  optimizer: %s\n", config.optimizer[0] ? config.optimizer : "off");
+    printf("  log-ring-size: %d\n", config.log_ring_size);
+    printf("  log-stream: %s\n", config.log_stream ? "on" : "off");
+    if (config.log_stream)
+        printf("  log-segment-size: %d\n", config.log_segment_size);
+    printf("  report-clock: %s\n", config.report_clock[0] ? config.report_clock : "wall");
+    printf("  pregen-pool-size: %d\n", config.pregen_pool_size);
+    printf("  finished-window: %d\n", config.finished_window);
+    printf("  finished-spill: %s\n", config.finished_spill ? "on" : "off");
     init_memory(config.max_overall_mem, config.mem_per_frame, config.max_mem_per_proc, config.min_mem_per_proc);
+    set_placement_policy(config.placement[0] ? config.placement : "first-fit");
+    printf("  placement: %s\n", placement_policy_name());
     
     memory_head = init_memory_block(config.max_overall_mem);
-    init_backing_store();
+    init_backing_store(config);
+    printf("  backing-store-io: %s (using %s)\n",
+           config.backing_store_io[0] ? config.backing_store_io : "file", backing_store_io_name());
+    printf("  swap-cache-size: %d\n", config.swap_cache_size);
+    printf("  memory-wait-timeout: %d\n", config.memory_wait_timeout);
+    if (config.memory_wait_timeout > 0) {
+        printf("  memory-wait-limit: %d\n", config.memory_wait_limit);
+        printf("  memory-wait-order: %s\n", config.memory_wait_order[0] ? config.memory_wait_order : "fifo");
+    }
+    printf("  compaction-budget: %d\n", config.compaction_budget);
+    set_paging(config.working_set_window, config.page_fault_high, config.page_fault_low, config.prefetch_pages);
+    printf("  working-set-window: %d\n", config.working_set_window);
+    if (config.working_set_window > 0) {
+        printf("  page-fault-high: %d\n", config.page_fault_high);
+        printf("  page-fault-low: %d\n", config.page_fault_low);
+        printf("  prefetch-pages: %d\n", config.prefetch_pages);
+    }
+    init_swap_io();
+    init_log_stream(config);
+    init_clock(config);
+    init_finished_archive(config);
     initialized = true;
 }
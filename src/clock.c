@@ -0,0 +1,31 @@
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+#include "clock.h"
+
+static volatile LONGLONG cached_wall_time = 0;
+static int report_ticks = 0;
+
+void init_clock(Config config) {
+    report_ticks = strcmp(config.report_clock, "tick") == 0;
+    clock_tick();
+}
+
+// called by the scheduler loop once per tick
+void clock_tick() {
+    InterlockedExchange64(&cached_wall_time, (LONGLONG)time(NULL));
+}
+
+time_t clock_wall_time() {
+    time_t now = (time_t)cached_wall_time;
+    return now ? now : time(NULL);
+}
+
+void format_exec_time(char *buf, size_t size, time_t wall, uint64_t tick) {
+    if (report_ticks) {
+        snprintf(buf, size, "tick %llu", (unsigned long long)tick);
+        return;
+    }
+    struct tm *tm_info = localtime(&wall);
+    strftime(buf, size, "%Y-%m-%d %H:%M:%S", tm_info);
+}
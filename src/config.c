@@ -3,6 +3,10 @@
 #include <string.h>
 #include <limits.h>
 #include "config.h"
+#include "finished_archive.h"
+#include "swap_cache.h"
+#include "scheduler.h"
+#include "memory.h"
 
 // colors for style
 #define yellow "\x1b[33m"
@@ -17,6 +21,15 @@ int load_config(Config *config) {
     }
 
     char key[64], value[64];
+    config->log_ring_size = DEFAULT_LOG_RING_SIZE;
+    config->finished_window = DEFAULT_FINISHED_WINDOW;
+    config->swap_cache_size = DEFAULT_SWAP_CACHE_SIZE;
+    config->memory_wait_timeout = DEFAULT_MEMORY_WAIT_TIMEOUT;
+    config->memory_wait_limit = DEFAULT_MEMORY_WAIT_LIMIT;
+    config->working_set_window = DEFAULT_WORKING_SET_WINDOW;
+    config->page_fault_high = DEFAULT_PAGE_FAULT_HIGH;
+    config->page_fault_low = DEFAULT_PAGE_FAULT_LOW;
+    config->prefetch_pages = DEFAULT_PREFETCH_PAGES;
 
     while (fscanf(file, "%s %s", key, value) == 2) {
         // Strip surrounding quotes from value
@@ -105,6 +118,160 @@ int load_config(Config *config) {
                 config->max_mem_per_proc= val;
         }
 
+        // instruction optimizer
+        else if (strcmp(key, "optimizer") == 0) {
+            if (strcmp(value, "off") == 0 || strcmp(value, "accurate") == 0 || strcmp(value, "throughput") == 0)
+                strncpy(config->optimizer, value, sizeof(config->optimizer) - 1);
+            else
+                printColor(yellow, "Warning: optimizer is invalid. Must be 'off', 'accurate' or 'throughput'\n");
+        }
+
+        // number of PRINT logs kept per process
+        else if (strcmp(key, "log-ring-size") == 0) {
+            int val = atoi(value);
+            if (val >= 0)
+                config->log_ring_size = val;
+            else
+                printColor(yellow, "Warning: log-ring-size is invalid (must be ≥ 0)\n");
+        }
+
+        // stream PRINT logs to disk
+        else if (strcmp(key, "log-stream") == 0) {
+            if (strcmp(value, "on") == 0 || strcmp(value, "off") == 0)
+                config->log_stream = strcmp(value, "on") == 0;
+            else
+                printColor(yellow, "Warning: log-stream is invalid. Must be 'on' or 'off'\n");
+        }
+        else if (strcmp(key, "log-segment-size") == 0) {
+            int val = atoi(value);
+            if (val >= 0)
+                config->log_segment_size = val;
+            else
+                printColor(yellow, "Warning: log-segment-size is invalid (must be ≥ 0)\n");
+        }
+
+        // clock shown in reports
+        else if (strcmp(key, "report-clock") == 0) {
+            if (strcmp(value, "wall") == 0 || strcmp(value, "tick") == 0)
+                strncpy(config->report_clock, value, sizeof(config->report_clock) - 1);
+            else
+                printColor(yellow, "Warning: report-clock is invalid. Must be 'wall' or 'tick'\n");
+        }
+
+        // processes generated ahead of time by a background thread
+        else if (strcmp(key, "pregen-pool-size") == 0) {
+            int val = atoi(value);
+            if (val >= 0)
+                config->pregen_pool_size = val;
+            else
+                printColor(yellow, "Warning: pregen-pool-size is invalid (must be ≥ 0)\n");
+        }
+
+        // finished processes kept in memory, 0 keeps all of them
+        else if (strcmp(key, "finished-window") == 0) {
+            int val = atoi(value);
+            if (val >= 0)
+                config->finished_window = val;
+            else
+                printColor(yellow, "Warning: finished-window is invalid (must be ≥ 0)\n");
+        }
+        else if (strcmp(key, "finished-spill") == 0) {
+            if (strcmp(value, "on") == 0 || strcmp(value, "off") == 0)
+                config->finished_spill = strcmp(value, "on") == 0;
+            else
+                printColor(yellow, "Warning: finished-spill is invalid. Must be 'on' or 'off'\n");
+        }
+
+        // how the backing store talks to the disk
+        else if (strcmp(key, "backing-store-io") == 0) {
+            if (strcmp(value, "file") == 0 || strcmp(value, "mmap") == 0)
+                strncpy(config->backing_store_io, value, sizeof(config->backing_store_io) - 1);
+            else
+                printColor(yellow, "Warning: backing-store-io is invalid. Must be 'file' or 'mmap'\n");
+        }
+
+        // bytes of compressed swapped-out processes kept in RAM, 0 writes them straight to the backing store
+        else if (strcmp(key, "swap-cache-size") == 0) {
+            int val = atoi(value);
+            if (val >= 0)
+                config->swap_cache_size = val;
+            else
+                printColor(yellow, "Warning: swap-cache-size is invalid (must be ≥ 0)\n");
+        }
+
+        // processes that don't fit in memory wait for room before going to the backing store, 0 in either key sends them
+        // straight there
+        else if (strcmp(key, "memory-wait-timeout") == 0) {
+            int val = atoi(value);
+            if (val >= 0)
+                config->memory_wait_timeout = val;
+            else
+                printColor(yellow, "Warning: memory-wait-timeout is invalid (must be ≥ 0)\n");
+        }
+        else if (strcmp(key, "memory-wait-limit") == 0) {
+            int val = atoi(value);
+            if (val >= 0)
+                config->memory_wait_limit = val;
+            else
+                printColor(yellow, "Warning: memory-wait-limit is invalid (must be ≥ 0)\n");
+        }
+        else if (strcmp(key, "memory-wait-order") == 0) {
+            if (strcmp(value, "fifo") == 0 || strcmp(value, "best-fit") == 0)
+                strncpy(config->memory_wait_order, value, sizeof(config->memory_wait_order) - 1);
+            else
+                printColor(yellow, "Warning: memory-wait-order is invalid. Must be 'fifo' or 'best-fit'\n");
+        }
+
+        // bytes of memory compaction may move per tick, 0 never compacts
+        else if (strcmp(key, "compaction-budget") == 0) {
+            int val = atoi(value);
+            if (val >= 0)
+                config->compaction_budget = val;
+            else
+                printColor(yellow, "Warning: compaction-budget is invalid (must be ≥ 0)\n");
+        }
+
+        // which free block a process is placed in
+        else if (strcmp(key, "placement") == 0) {
+            if (strcmp(value, "first-fit") == 0 || strcmp(value, "next-fit") == 0 ||
+                strcmp(value, "best-fit") == 0 || strcmp(value, "worst-fit") == 0)
+                strncpy(config->placement, value, sizeof(config->placement) - 1);
+            else
+                printColor(yellow, "Warning: placement is invalid. Must be 'first-fit', 'next-fit', 'best-fit' or 'worst-fit'\n");
+        }
+
+        // ticks of page references that make up a working set, 0 turns demand paging off
+        else if (strcmp(key, "working-set-window") == 0) {
+            int val = atoi(value);
+            if (val >= 0)
+                config->working_set_window = val;
+            else
+                printColor(yellow, "Warning: working-set-window is invalid (must be ≥ 0)\n");
+        }
+        // faults per working set window above which a process gets more frames, below which it gives them back
+        else if (strcmp(key, "page-fault-high") == 0) {
+            int val = atoi(value);
+            if (val >= 1)
+                config->page_fault_high = val;
+            else
+                printColor(yellow, "Warning: page-fault-high is invalid (must be ≥ 1)\n");
+        }
+        else if (strcmp(key, "page-fault-low") == 0) {
+            int val = atoi(value);
+            if (val >= 0)
+                config->page_fault_low = val;
+            else
+                printColor(yellow, "Warning: page-fault-low is invalid (must be ≥ 0)\n");
+        }
+        // most pages read ahead after a sequential fault, 0 never prefetches
+        else if (strcmp(key, "prefetch-pages") == 0) {
+            int val = atoi(value);
+            if (val >= 0)
+                config->prefetch_pages = val;
+            else
+                printColor(yellow, "Warning: prefetch-pages is invalid (must be ≥ 0)\n");
+        }
+
 
         else {
             printf("Warning: Unrecognized config key: %s\n", key);
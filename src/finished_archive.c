@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "finished_archive.h"
+#include "scheduler.h"
+#include "clock.h"
+#include "locks.h"
+
+#define FINISHED_SPILL_FILENAME "csopesy-finished.bin"
+#define FINISHED_CHUNK_SIZE 1024
+#define SPILL_READ_BATCH 256
+
+// records are appended to the newest chunk, the window is trimmed a whole chunk at a time from the oldest end
+typedef struct FinishedChunk {
+    FinishedRecord records[FINISHED_CHUNK_SIZE];
+    int count;
+    struct FinishedChunk *next;
+} FinishedChunk;
+
+static FinishedChunk *oldest_chunk = NULL;
+static FinishedChunk *newest_chunk = NULL;
+static int num_chunks = 0;
+static int max_chunks = 0;          // 0 keeps everything in memory
+static FILE *spill_fp = NULL;       // NULL drops records that leave the window
+static FinishedTotals totals;
+static TimedLock archive_lock;
+static int archive_ready = 0;
+
+// names that are not the generated P<pid>, a name id is the index + 1
+static char (*names)[MAX_PROCESS_NAME] = NULL;
+static uint32_t num_names = 0;
+static uint32_t names_capacity = 0;
+
+void init_finished_archive(Config config) {
+    if (archive_ready) return;
+
+    timed_lock_init(&archive_lock, "finished");
+    memset(&totals, 0, sizeof(totals));
+    max_chunks = config.finished_window > 0
+        ? (config.finished_window + FINISHED_CHUNK_SIZE - 1) / FINISHED_CHUNK_SIZE : 0;
+
+    if (config.finished_spill) {
+        spill_fp = fopen(FINISHED_SPILL_FILENAME, "w+b");
+        if (!spill_fp) perror("Failed to open finished process spill file");
+    }
+    archive_ready = 1;
+}
+
+// called with archive_lock held
+static uint32_t intern_name(const char *name, int pid) {
+    char generated[MAX_PROCESS_NAME];
+    snprintf(generated, sizeof(generated), "P%d", pid);
+    if (strcmp(name, generated) == 0) return 0;
+
+    // only user-named processes get here, so a linear search is enough
+    for (uint32_t i = 0; i < num_names; i++) {
+        if (strcmp(names[i], name) == 0) return i + 1;
+    }
+
+    if (num_names == names_capacity) {
+        uint32_t new_cap = names_capacity == 0 ? 16 : names_capacity * 2;
+        char (*new_names)[MAX_PROCESS_NAME] = realloc(names, new_cap * sizeof(*names));
+        if (!new_names) return 0;
+        names = new_names;
+        names_capacity = new_cap;
+    }
+    strncpy(names[num_names], name, MAX_PROCESS_NAME - 1);
+    names[num_names][MAX_PROCESS_NAME - 1] = '\0';
+    return ++num_names;
+}
+
+// called with archive_lock held, returns a chunk with room for one more record
+static FinishedChunk *chunk_with_room() {
+    if (newest_chunk && newest_chunk->count < FINISHED_CHUNK_SIZE) return newest_chunk;
+
+    FinishedChunk *chunk = NULL;
+    if (max_chunks > 0 && num_chunks >= max_chunks) {
+        // the oldest chunk leaves the window and its memory is reused for the new one
+        chunk = oldest_chunk;
+        oldest_chunk = chunk->next;
+        if (!oldest_chunk) newest_chunk = NULL;
+        if (spill_fp) {
+            fwrite(chunk->records, sizeof(FinishedRecord), chunk->count, spill_fp);
+            totals.spilled += chunk->count;
+        }
+        totals.in_memory -= chunk->count;
+        num_chunks--;
+    } else {
+        chunk = malloc(sizeof(FinishedChunk));
+        if (!chunk) return NULL;
+    }
+
+    chunk->count = 0;
+    chunk->next = NULL;
+    if (newest_chunk) newest_chunk->next = chunk;
+    else oldest_chunk = chunk;
+    newest_chunk = chunk;
+    num_chunks++;
+    return chunk;
+}
+
+void archive_finished_process(Process *p) {
+    if (!archive_ready || !p) return;
+
+    FinishedRecord r;
+    r.pid = p->pid;
+    r.num_inst = p->num_inst;
+    r.finish_tick = CPU_TICKS;
+    r.turnaround = CPU_TICKS >= p->arrival_tick ? CPU_TICKS - p->arrival_tick : 0;
+    r.finish_time = clock_wall_time();
+
+    timed_lock_enter(&archive_lock);
+    r.name_id = intern_name(p->name, p->pid);
+    totals.finished++;
+    totals.instructions += r.num_inst;
+    totals.turnaround += r.turnaround;
+
+    FinishedChunk *chunk = chunk_with_room();
+    if (chunk) {
+        chunk->records[chunk->count++] = r;
+        totals.in_memory++;
+    }
+    timed_lock_leave(&archive_lock);
+}
+
+bool finished_archive_find(int pid, FinishedRecord *out) {
+    if (!archive_ready) return false;
+
+    bool found = false;
+    timed_lock_enter(&archive_lock);
+    for (FinishedChunk *c = oldest_chunk; c && !found; c = c->next) {
+        for (int i = 0; i < c->count; i++) {
+            if (c->records[i].pid == pid) {
+                *out = c->records[i];
+                found = true;
+                break;
+            }
+        }
+    }
+    timed_lock_leave(&archive_lock);
+    return found;
+}
+
+FinishedTotals finished_archive_totals() {
+    FinishedTotals t;
+    memset(&t, 0, sizeof(t));
+    if (!archive_ready) return t;
+
+    timed_lock_enter(&archive_lock);
+    t = totals;
+    timed_lock_leave(&archive_lock);
+    return t;
+}
+
+void finished_record_name(const FinishedRecord *r, char *buf, size_t size) {
+    if (r->name_id == 0) {
+        snprintf(buf, size, "P%d", r->pid);
+        return;
+    }
+
+    timed_lock_enter(&archive_lock);
+    snprintf(buf, size, "%s", r->name_id <= num_names ? names[r->name_id - 1] : "?");
+    timed_lock_leave(&archive_lock);
+}
+
+void finished_archive_walk(void (*fn)(const FinishedRecord *r, void *ctx), void *ctx, bool include_spilled) {
+    if (!archive_ready) return;
+
+    // spilled records are read back through a separate handle, outside the lock
+    if (include_spilled && spill_fp) {
+        timed_lock_enter(&archive_lock);
+        fflush(spill_fp);
+        uint64_t spilled = totals.spilled;
+        timed_lock_leave(&archive_lock);
+
+        FILE *fp = fopen(FINISHED_SPILL_FILENAME, "rb");
+        if (fp) {
+            FinishedRecord batch[SPILL_READ_BATCH];
+            uint64_t done = 0;
+            while (done < spilled) {
+                size_t want = spilled - done < SPILL_READ_BATCH ? (size_t)(spilled - done) : SPILL_READ_BATCH;
+                size_t n = fread(batch, sizeof(FinishedRecord), want, fp);
+                if (n == 0) break;
+                for (size_t i = 0; i < n; i++) fn(&batch[i], ctx);
+                done += n;
+            }
+            fclose(fp);
+        }
+    }
+
+    timed_lock_enter(&archive_lock);
+    for (FinishedChunk *c = oldest_chunk; c; c = c->next) {
+        for (int i = 0; i < c->count; i++) fn(&c->records[i], ctx);
+    }
+    timed_lock_leave(&archive_lock);
+}
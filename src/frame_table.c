@@ -0,0 +1,186 @@
+#include <stdlib.h>
+#include <string.h>
+#include "frame_table.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FRAME_TABLE_AVX2
+#endif
+
+// the min search looks at this many frames at a time and only rescans the chunk that held the smallest tick
+#define LRU_CHUNK 256
+
+static uint64_t min_scalar(const uint64_t *v, int n) {
+    // independent accumulators, the compiler vectorizes this where it can
+    uint64_t m0 = FRAME_FREE_TICK, m1 = FRAME_FREE_TICK, m2 = FRAME_FREE_TICK, m3 = FRAME_FREE_TICK;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        m0 = v[i] < m0 ? v[i] : m0;
+        m1 = v[i + 1] < m1 ? v[i + 1] : m1;
+        m2 = v[i + 2] < m2 ? v[i + 2] : m2;
+        m3 = v[i + 3] < m3 ? v[i + 3] : m3;
+    }
+    for (; i < n; i++)
+        m0 = v[i] < m0 ? v[i] : m0;
+    m0 = m1 < m0 ? m1 : m0;
+    m2 = m3 < m2 ? m3 : m2;
+    return m2 < m0 ? m2 : m0;
+}
+
+#ifdef FRAME_TABLE_AVX2
+// every tick is below FRAME_FREE_TICK = INT64_MAX, so the signed compare orders them the same as unsigned
+__attribute__((target("avx2")))
+static uint64_t min_avx2(const uint64_t *v, int n) {
+    __m256i m0 = _mm256_set1_epi64x(INT64_MAX);
+    __m256i m1 = m0;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(v + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(v + i + 4));
+        m0 = _mm256_blendv_epi8(m0, a, _mm256_cmpgt_epi64(m0, a));
+        m1 = _mm256_blendv_epi8(m1, b, _mm256_cmpgt_epi64(m1, b));
+    }
+    m0 = _mm256_blendv_epi8(m0, m1, _mm256_cmpgt_epi64(m0, m1));
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, m0);
+    uint64_t m = lanes[0];
+    for (int k = 1; k < 4; k++)
+        m = lanes[k] < m ? lanes[k] : m;
+    for (; i < n; i++)
+        m = v[i] < m ? v[i] : m;
+    return m;
+}
+#endif
+
+static uint64_t (*min_ticks)(const uint64_t *v, int n) = NULL;
+
+static void pick_min_ticks() {
+    if (min_ticks) return;
+    min_ticks = min_scalar;
+#ifdef FRAME_TABLE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        min_ticks = min_avx2;
+#endif
+}
+
+const char *frame_table_simd_name() {
+    pick_min_ticks();
+#ifdef FRAME_TABLE_AVX2
+    if (min_ticks == min_avx2) return "avx2";
+#endif
+    return "scalar";
+}
+
+bool frame_table_init(FrameTable *t, int frames) {
+    pick_min_ticks();
+    memset(t, 0, sizeof(*t));
+    if (frames <= 0) return true;
+
+    int words = (frames + 63) / 64;
+    t->used = calloc(words, sizeof(uint64_t));
+    t->pid = malloc(sizeof(int) * frames);
+    t->page = malloc(sizeof(int) * frames);
+    t->last_used = malloc(sizeof(uint64_t) * frames);
+    t->next_resident = malloc(sizeof(int) * frames);
+    t->prev_resident = malloc(sizeof(int) * frames);
+    if (!t->used || !t->pid || !t->page || !t->last_used || !t->next_resident || !t->prev_resident) {
+        frame_table_destroy(t);
+        return false;
+    }
+    t->num_frames = frames;
+    for (int i = 0; i < frames; i++) {
+        t->pid[i] = -1;
+        t->page[i] = -1;
+        t->last_used[i] = FRAME_FREE_TICK;
+        t->next_resident[i] = -1;
+        t->prev_resident[i] = -1;
+    }
+    // the bits past the last frame read as in use, so the free search never returns them
+    if (frames % 64)
+        t->used[words - 1] = ~0ULL << (frames % 64);
+    return true;
+}
+
+void frame_table_destroy(FrameTable *t) {
+    free(t->used);
+    free(t->pid);
+    free(t->page);
+    free(t->last_used);
+    free(t->next_resident);
+    free(t->prev_resident);
+    memset(t, 0, sizeof(*t));
+}
+
+int frame_table_find_free(FrameTable *t) {
+    int words = (t->num_frames + 63) / 64;
+    for (int w = t->free_hint; w < words; w++) {
+        uint64_t free_bits = ~t->used[w];
+        if (free_bits) {
+            t->free_hint = w;
+            return w * 64 + __builtin_ctzll(free_bits);
+        }
+    }
+    t->free_hint = words;
+    return -1;
+}
+
+int frame_table_find_lru(const FrameTable *t) {
+    uint64_t oldest = FRAME_FREE_TICK;
+    int oldest_chunk = -1;
+    for (int c = 0; c < t->num_frames; c += LRU_CHUNK) {
+        int n = t->num_frames - c < LRU_CHUNK ? t->num_frames - c : LRU_CHUNK;
+        uint64_t m = min_ticks(t->last_used + c, n);
+        if (m < oldest) {
+            oldest = m;
+            oldest_chunk = c;
+        }
+    }
+    if (oldest_chunk < 0) return -1;
+
+    for (int i = oldest_chunk;; i++) {
+        if (t->last_used[i] == oldest) return i;
+    }
+}
+
+void frame_table_claim(FrameTable *t, int frame, int pid, int page, uint64_t tick) {
+    if (!(t->used[frame / 64] & (1ULL << (frame % 64)))) {
+        t->used[frame / 64] |= 1ULL << (frame % 64);
+        t->num_used++;
+    }
+    t->pid[frame] = pid;
+    t->page[frame] = page;
+    // a free frame's tick has to stay above every real one
+    t->last_used[frame] = tick < FRAME_FREE_TICK ? tick : FRAME_FREE_TICK - 1;
+}
+
+void frame_table_release(FrameTable *t, int frame) {
+    if (!(t->used[frame / 64] & (1ULL << (frame % 64)))) return;
+    t->used[frame / 64] &= ~(1ULL << (frame % 64));
+    t->num_used--;
+    t->pid[frame] = -1;
+    t->page[frame] = -1;
+    t->last_used[frame] = FRAME_FREE_TICK;
+    if (frame / 64 < t->free_hint) t->free_hint = frame / 64;
+}
+
+void frame_table_add_resident(FrameTable *t, int frame, int *head, int *count) {
+    t->prev_resident[frame] = -1;
+    t->next_resident[frame] = *count > 0 ? *head : -1;
+    if (*count > 0) t->prev_resident[*head] = frame;
+    *head = frame;
+    (*count)++;
+}
+
+void frame_table_remove_resident(FrameTable *t, int frame, int *head, int *count) {
+    int prev = t->prev_resident[frame];
+    int next = t->next_resident[frame];
+    if (prev >= 0)
+        t->next_resident[prev] = next;
+    else
+        *head = next;
+    if (next >= 0) t->prev_resident[next] = prev;
+    t->next_resident[frame] = t->prev_resident[frame] = -1;
+    (*count)--;
+}
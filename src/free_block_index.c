@@ -0,0 +1,214 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include "free_block_index.h"
+#include "random.h"
+
+static MemoryBlock *size_root = NULL;
+static MemoryBlock *addr_root = NULL;
+static int num_free_blocks = 0;
+static uint64_t priority_state = 0;
+
+static uint64_t block_size(const MemoryBlock *b) {
+    return (uint64_t)(b->end - b->base + 1);
+}
+
+// the size tree order: smaller first, for the same size the lower address first
+static bool size_less(const MemoryBlock *a, const MemoryBlock *b) {
+    uint64_t sa = block_size(a), sb = block_size(b);
+    if (sa != sb) return sa < sb;
+    return a->base < b->base;
+}
+
+// splits t into the blocks ordered before b and the rest
+static void size_split(MemoryBlock *t, const MemoryBlock *b, MemoryBlock **l, MemoryBlock **r) {
+    if (!t) {
+        *l = *r = NULL;
+    } else if (size_less(t, b)) {
+        size_split(t->size_right, b, &t->size_right, r);
+        *l = t;
+    } else {
+        size_split(t->size_left, b, l, &t->size_left);
+        *r = t;
+    }
+}
+
+static MemoryBlock *size_merge(MemoryBlock *l, MemoryBlock *r) {
+    if (!l) return r;
+    if (!r) return l;
+    if (l->priority > r->priority) {
+        l->size_right = size_merge(l->size_right, r);
+        return l;
+    }
+    r->size_left = size_merge(l, r->size_left);
+    return r;
+}
+
+static MemoryBlock *size_insert(MemoryBlock *t, MemoryBlock *b) {
+    if (!t) return b;
+    if (b->priority > t->priority) {
+        size_split(t, b, &b->size_left, &b->size_right);
+        return b;
+    }
+    if (size_less(b, t))
+        t->size_left = size_insert(t->size_left, b);
+    else
+        t->size_right = size_insert(t->size_right, b);
+    return t;
+}
+
+static MemoryBlock *size_remove(MemoryBlock *t, MemoryBlock *b) {
+    if (!t) return t;
+    if (t == b) return size_merge(t->size_left, t->size_right);
+    if (size_less(b, t))
+        t->size_left = size_remove(t->size_left, b);
+    else
+        t->size_right = size_remove(t->size_right, b);
+    return t;
+}
+
+// the biggest block in t's address subtree, from its own size and its children's
+static void addr_pull(MemoryBlock *t) {
+    uint64_t largest = block_size(t);
+    if (t->addr_left && t->addr_left->subtree_max > largest) largest = t->addr_left->subtree_max;
+    if (t->addr_right && t->addr_right->subtree_max > largest) largest = t->addr_right->subtree_max;
+    t->subtree_max = largest;
+}
+
+// splits t into the blocks below base and the rest
+static void addr_split(MemoryBlock *t, int base, MemoryBlock **l, MemoryBlock **r) {
+    if (!t) {
+        *l = *r = NULL;
+        return;
+    }
+    if (t->base < base) {
+        addr_split(t->addr_right, base, &t->addr_right, r);
+        *l = t;
+    } else {
+        addr_split(t->addr_left, base, l, &t->addr_left);
+        *r = t;
+    }
+    addr_pull(t);
+}
+
+static MemoryBlock *addr_merge(MemoryBlock *l, MemoryBlock *r) {
+    if (!l) return r;
+    if (!r) return l;
+    if (l->priority > r->priority) {
+        l->addr_right = addr_merge(l->addr_right, r);
+        addr_pull(l);
+        return l;
+    }
+    r->addr_left = addr_merge(l, r->addr_left);
+    addr_pull(r);
+    return r;
+}
+
+static MemoryBlock *addr_insert(MemoryBlock *t, MemoryBlock *b) {
+    if (!t) return b;
+    if (b->priority > t->priority) {
+        addr_split(t, b->base, &b->addr_left, &b->addr_right);
+        addr_pull(b);
+        return b;
+    }
+    if (b->base < t->base)
+        t->addr_left = addr_insert(t->addr_left, b);
+    else
+        t->addr_right = addr_insert(t->addr_right, b);
+    addr_pull(t);
+    return t;
+}
+
+static MemoryBlock *addr_remove(MemoryBlock *t, MemoryBlock *b) {
+    if (!t) return t;
+    if (t == b) return addr_merge(t->addr_left, t->addr_right);
+    if (b->base < t->base)
+        t->addr_left = addr_remove(t->addr_left, b);
+    else
+        t->addr_right = addr_remove(t->addr_right, b);
+    addr_pull(t);
+    return t;
+}
+
+// the lowest addressed block in t that fits
+static MemoryBlock *addr_first_fit(MemoryBlock *t, uint64_t size) {
+    while (t && t->subtree_max >= size) {
+        if (t->addr_left && t->addr_left->subtree_max >= size)
+            t = t->addr_left;
+        else if (block_size(t) >= size)
+            return t;
+        else
+            t = t->addr_right;
+    }
+    return NULL;
+}
+
+// the same for blocks at or above from, only the path to from is walked besides one successful descent
+static MemoryBlock *addr_fit_from(MemoryBlock *t, uint64_t from, uint64_t size) {
+    if (!t || t->subtree_max < size) return NULL;
+    if ((uint64_t)t->base < from) return addr_fit_from(t->addr_right, from, size);
+
+    MemoryBlock *b = addr_fit_from(t->addr_left, from, size);
+    if (b) return b;
+    if (block_size(t) >= size) return t;
+    return addr_first_fit(t->addr_right, size);
+}
+
+void free_index_reset() {
+    size_root = NULL;
+    addr_root = NULL;
+    num_free_blocks = 0;
+    priority_state = seed_random_state(7);
+}
+
+void free_index_insert(MemoryBlock *b) {
+    b->size_left = b->size_right = NULL;
+    b->addr_left = b->addr_right = NULL;
+    b->subtree_max = block_size(b);
+    b->priority = random_priority(&priority_state);
+    size_root = size_insert(size_root, b);
+    addr_root = addr_insert(addr_root, b);
+    num_free_blocks++;
+}
+
+void free_index_remove(MemoryBlock *b) {
+    size_root = size_remove(size_root, b);
+    addr_root = addr_remove(addr_root, b);
+    num_free_blocks--;
+}
+
+int free_index_count() {
+    return num_free_blocks;
+}
+
+uint64_t free_index_largest() {
+    return addr_root ? addr_root->subtree_max : 0;
+}
+
+MemoryBlock *free_index_first_fit(uint64_t size) {
+    return addr_first_fit(addr_root, size);
+}
+
+MemoryBlock *free_index_next_fit(uint64_t size, uint64_t from) {
+    MemoryBlock *b = addr_fit_from(addr_root, from, size);
+    return b ? b : addr_first_fit(addr_root, size);
+}
+
+MemoryBlock *free_index_best_fit(uint64_t size) {
+    MemoryBlock *best = NULL;
+    for (MemoryBlock *t = size_root; t;) {
+        if (block_size(t) >= size) {
+            best = t;
+            t = t->size_left;
+        } else {
+            t = t->size_right;
+        }
+    }
+    return best;
+}
+
+MemoryBlock *free_index_worst_fit(uint64_t size) {
+    MemoryBlock *t = size_root;
+    while (t && t->size_right)
+        t = t->size_right;
+    return t && block_size(t) >= size ? t : NULL;
+}
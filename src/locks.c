@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+#include "locks.h"
+
+#define MAX_TIMED_LOCKS 16
+
+static TimedLock *registered[MAX_TIMED_LOCKS];
+static int num_registered = 0;
+
+static int64_t now_counter() {
+    LARGE_INTEGER t;
+    QueryPerformanceCounter(&t);
+    return t.QuadPart;
+}
+
+// called from the main thread before any worker starts, initializing a lock again does nothing
+void timed_lock_init(TimedLock *lock, const char *name) {
+    if (lock->name) return;
+    memset(lock, 0, sizeof(*lock));
+    InitializeCriticalSection(&lock->cs);
+    lock->name = name;
+    if (num_registered < MAX_TIMED_LOCKS)
+        registered[num_registered++] = lock;
+}
+
+void timed_lock_enter(TimedLock *lock) {
+    int contended = 0;
+    if (!TryEnterCriticalSection(&lock->cs)) {
+        contended = 1;
+        EnterCriticalSection(&lock->cs);
+    }
+
+    if (lock->depth++ == 0) {
+        lock->acquisitions++;
+        lock->contended += contended;
+        lock->acquired_at = now_counter();
+    }
+}
+
+void timed_lock_leave(TimedLock *lock) {
+    if (--lock->depth == 0) {
+        int64_t held = now_counter() - lock->acquired_at;
+        lock->total_hold += held;
+        if (held > lock->max_hold) lock->max_hold = held;
+    }
+    LeaveCriticalSection(&lock->cs);
+}
+
+// only valid at the outermost level, a recursive owner would still hold the section while waiting
+BOOL timed_lock_wait(TimedLock *lock, CONDITION_VARIABLE *cv, DWORD ms) {
+    int64_t held = now_counter() - lock->acquired_at;
+    lock->total_hold += held;
+    if (held > lock->max_hold) lock->max_hold = held;
+    lock->depth = 0;
+
+    BOOL woken = SleepConditionVariableCS(cv, &lock->cs, ms);
+
+    lock->depth = 1;
+    lock->acquired_at = now_counter();
+    return woken;
+}
+
+void print_lock_stats() {
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    double us_per_count = 1e6 / (double)freq.QuadPart;
+
+    printf("%-14s %12s %10s %12s %12s %12s\n",
+           "Lock", "Acquired", "Contended", "Avg hold", "Max hold", "Total hold");
+    for (int i = 0; i < num_registered; i++) {
+        TimedLock *l = registered[i];
+
+        // copy under the raw section so the numbers are consistent and the copy isn't counted
+        EnterCriticalSection(&l->cs);
+        uint64_t acquisitions = l->acquisitions;
+        uint64_t contended = l->contended;
+        int64_t total_hold = l->total_hold;
+        int64_t max_hold = l->max_hold;
+        LeaveCriticalSection(&l->cs);
+
+        double contended_pct = acquisitions ? 100.0 * contended / acquisitions : 0.0;
+        double avg_us = acquisitions ? total_hold * us_per_count / acquisitions : 0.0;
+        printf("%-14s %12llu %9.2f%% %10.2fus %10.2fus %10.2fms\n",
+               l->name, (unsigned long long)acquisitions, contended_pct,
+               avg_us, max_hold * us_per_count, total_hold * us_per_count / 1000.0);
+    }
+}
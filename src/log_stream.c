@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "log_stream.h"
+
+#define LOG_STREAM_FILENAME "csopesy-log-stream-%03d.bin"
+#define CORE_BUFFER_SIZE 4096    // records per core, must be a power of 2
+#define WRITER_INTERVAL_MS 10
+
+// single producer (core thread), single consumer (writer thread)
+typedef struct {
+    Log records[CORE_BUFFER_SIZE];
+    volatile uint32_t head;     // next record to write to disk
+    volatile uint32_t tail;     // next free slot
+} CoreLogBuffer;
+
+static CoreLogBuffer *core_buffers = NULL;
+static int num_buffers = 0;
+static volatile int stream_running = 0;
+static HANDLE writer_thread;
+
+static FILE *stream_fp = NULL;
+static int current_segment = 0;
+static int64_t segment_bytes = 0;
+static int64_t segment_limit = 0;  // 0 keeps everything in one file
+static int tail_size = DEFAULT_LOG_RING_SIZE;
+
+// records lost because a core buffer was full
+static volatile long dropped_records = 0;
+
+static FILE *open_segment(int segment, const char *mode) {
+    char filename[64];
+    snprintf(filename, sizeof(filename), LOG_STREAM_FILENAME, segment);
+    return fopen(filename, mode);
+}
+
+// remove the segments left over from a previous run
+static void remove_old_segments() {
+    char filename[64];
+    for (int i = 0; ; i++) {
+        snprintf(filename, sizeof(filename), LOG_STREAM_FILENAME, i);
+        if (remove(filename) != 0) break;
+    }
+}
+
+// move everything buffered by one core to disk
+static void drain_core(CoreLogBuffer *buf) {
+    uint32_t head = buf->head;
+    uint32_t tail = buf->tail;
+    _ReadWriteBarrier();
+
+    while (head != tail) {
+        uint32_t idx = head & (CORE_BUFFER_SIZE - 1);
+        uint32_t count = tail - head;
+        // write up to the end of the array, the rest on the next pass
+        if (idx + count > CORE_BUFFER_SIZE) count = CORE_BUFFER_SIZE - idx;
+
+        if (segment_limit > 0 && segment_bytes >= segment_limit) {
+            fclose(stream_fp);
+            stream_fp = open_segment(++current_segment, "wb");
+            segment_bytes = 0;
+            if (!stream_fp) {
+                printf("[ERROR] Failed to open log stream segment %d\n", current_segment);
+                return;
+            }
+        }
+
+        fwrite(&buf->records[idx], sizeof(Log), count, stream_fp);
+        segment_bytes += sizeof(Log) * count;
+        head += count;
+    }
+
+    _ReadWriteBarrier();
+    buf->head = head;
+}
+
+DWORD WINAPI log_writer_loop(LPVOID lpParam) {
+    (void)lpParam;
+    while (stream_running) {
+        for (int i = 0; i < num_buffers && stream_fp; i++)
+            drain_core(&core_buffers[i]);
+        if (stream_fp) fflush(stream_fp);
+        Sleep(WRITER_INTERVAL_MS);
+    }
+
+    // flush what the cores produced before shutdown
+    for (int i = 0; i < num_buffers && stream_fp; i++)
+        drain_core(&core_buffers[i]);
+    return 0;
+}
+
+void init_log_stream(Config config) {
+    if (stream_running || !config.log_stream) return;
+
+    num_buffers = config.num_cpu;
+    core_buffers = calloc(num_buffers, sizeof(CoreLogBuffer));
+    if (!core_buffers) {
+        printf("[ERROR] Failed to allocate log stream buffers\n");
+        return;
+    }
+
+    remove_old_segments();
+    current_segment = 0;
+    segment_bytes = 0;
+    segment_limit = config.log_segment_size;
+    // streaming usually goes with log-ring-size 0, the screens still show the default tail then
+    tail_size = config.log_ring_size > 0 ? config.log_ring_size : DEFAULT_LOG_RING_SIZE;
+    stream_fp = open_segment(0, "wb");
+    if (!stream_fp) {
+        perror("Failed to open log stream");
+        free(core_buffers);
+        core_buffers = NULL;
+        return;
+    }
+
+    stream_running = 1;
+    writer_thread = CreateThread(NULL, 0, log_writer_loop, NULL, 0, NULL);
+}
+
+void stop_log_stream() {
+    if (!stream_running) return;
+    stream_running = 0;
+    WaitForSingleObject(writer_thread, INFINITE);
+    CloseHandle(writer_thread);
+    fclose(stream_fp);
+    stream_fp = NULL;
+}
+
+bool log_stream_enabled() {
+    return stream_running;
+}
+
+void log_stream_push(int core, const Log *log) {
+    if (!stream_running || core < 0 || core >= num_buffers) return;
+
+    CoreLogBuffer *buf = &core_buffers[core];
+    uint32_t tail = buf->tail;
+    if (tail - buf->head >= CORE_BUFFER_SIZE) {
+        InterlockedIncrement(&dropped_records);
+        return;
+    }
+
+    buf->records[tail & (CORE_BUFFER_SIZE - 1)] = *log;
+    _ReadWriteBarrier();
+    buf->tail = tail + 1;
+}
+
+int log_stream_tail_size() {
+    return tail_size;
+}
+
+long log_stream_dropped() {
+    return dropped_records;
+}
+
+// newest segment first and each one from its end, so only as much of the run is read as it takes to find count
+// records, out is filled from the back and moved to the front at the end
+int log_stream_read_tail(int pid, Log *out, int count) {
+    if (count <= 0) return 0;
+
+    int found = 0;
+    Log chunk[256];
+    for (int segment = current_segment; segment >= 0 && found < count; segment--) {
+        FILE *fp = open_segment(segment, "rb");
+        if (!fp) continue;
+
+        // a record the writer is still in the middle of is left out
+        // 64-bit offsets, long is 32 bits on Windows
+        _fseeki64(fp, 0, SEEK_END);
+        int64_t records = _ftelli64(fp) / (int64_t)sizeof(Log);
+        while (records > 0 && found < count) {
+            int n = records < 256 ? (int)records : 256;
+            records -= n;
+            _fseeki64(fp, records * (int64_t)sizeof(Log), SEEK_SET);
+            if (fread(chunk, sizeof(Log), n, fp) != (size_t)n) break;
+            for (int i = n - 1; i >= 0 && found < count; i--) {
+                if (chunk[i].pid == pid)
+                    out[count - 1 - found++] = chunk[i];
+            }
+        }
+        fclose(fp);
+    }
+
+    if (found < count) memmove(out, out + (count - found), sizeof(Log) * found);
+    return found;
+}
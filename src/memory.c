@@ -3,53 +3,89 @@
 #include "scheduler.h"
 #include "stats.h"
 #include "backing_store.h"
+#include "snapshot.h"
+#include "swap_cache.h"
+#include "free_block_index.h"
+#include "frame_table.h"
+#include "log_stream.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include <limits.h>
 
 #define MAX_MEMORY_SIZE 16384  // 16 KB
 #define UINT16_MAX_VAL 65535
 
-static uint16_t memory_space[MAX_MEMORY_SIZE / 2];
+// max-overall-mem bytes, a process's addresses start at its mem_base and hold 16 bit values
+static uint8_t *memory_space = NULL;
 
 Memory memory;
 MemoryBlock* memory_head;
-
-// frame table
-#define MAX_FRAMES 1024
+TimedLock memory_lock;
+
+// MemoryBlock nodes are carved out of slabs up front so splits and merges never reach malloc, a free node's
+// next links the free list, another slab is only added if the list outgrows the first one
+typedef struct BlockSlab {
+    struct BlockSlab *next;
+    int count;
+    MemoryBlock blocks[];
+} BlockSlab;
+static BlockSlab *block_slabs = NULL;
+static MemoryBlock *free_blocks = NULL;
+static int block_slab_size = 64;
+static int slab_blocks = 0;             // nodes in every slab, the block list is never longer
+
+// find_room's copy of the block list, only grown when a slab is added
+static uint64_t *room_sizes = NULL;
+static int *room_owners = NULL;
+static int room_capacity = 0;
+
+// how try_allocate_memory picks among the free blocks that fit, see free_block_index.h
+typedef enum {
+    PLACE_FIRST_FIT,
+    PLACE_NEXT_FIT,
+    PLACE_BEST_FIT,
+    PLACE_WORST_FIT,
+} PlacementPolicy;
+static const char *placement_names[] = {"first-fit", "next-fit", "best-fit", "worst-fit"};
+static PlacementPolicy placement = PLACE_FIRST_FIT;
+static uint64_t next_fit_from = 0;      // just past the block next-fit placed last
 
 // Write a uint16 value to memory for a given process
 void write_to_memory(Process *p, uint16_t addr, uint16_t value) {
     // Check if address is valid for this process
-    if (!p->in_memory || addr >= p->memory_allocation) {
+    if (!p->in_memory || (uint64_t)addr + sizeof(value) > p->memory_allocation || !memory_space) {
         return;  // Invalid memory access, ignore write
     }
 
     // Write value to memory space
-    memory_space[addr] = value;
+    memcpy(&memory_space[p->mem_base + addr], &value, sizeof(value));
 }
 
 // Read a uint16 value from memory for a given process
 uint16_t read_from_memory(Process *p, uint16_t addr) {
     // Check if address is valid for this process
-    if (!p->in_memory || addr >= p->memory_allocation) {
+    uint16_t value;
+    if (!p->in_memory || (uint64_t)addr + sizeof(value) > p->memory_allocation || !memory_space) {
         return 0;  // Return 0 if memory not allocated or address out of bounds
     }
 
     // Return value from memory space (assuming it's initialized to 0 by default)
-    return memory_space[addr];
+    memcpy(&value, &memory_space[p->mem_base + addr], sizeof(value));
+    return value;
 }
 
-typedef struct {
-    bool occupied;
-    int pid;
-    int page_number;
-    uint64_t last_used_tick;
-} Frame;
+static FrameTable frame_table;
+static TimedLock frame_lock;
 
-static Frame *frame_table = NULL;
-static int num_frames = 0;
+// demand paging, set_paging
+#define INITIAL_FRAME_QUOTA 4
+#define WORKING_SET_SAMPLES 8      // samples per working set window, one history bit each
+static int working_set_window = 0;
+static int page_fault_high = DEFAULT_PAGE_FAULT_HIGH;
+static int page_fault_low = DEFAULT_PAGE_FAULT_LOW;
+static int prefetch_pages = DEFAULT_PREFETCH_PAGES;
 
 extern uint64_t CPU_TICKS;
 extern Process **process_table;
@@ -61,9 +97,27 @@ void init_memory(uint64_t total_memory, uint64_t mem_per_frame, uint64_t max_mem
     memory.max_mem_per_proc = max_mem_per_proc;
     memory.min_mem_per_proc = min_mem_per_proc;
     memory.free_memory = total_memory;
+    memory.largest_free = total_memory;
+    timed_lock_init(&memory_lock, "memory");
+    timed_lock_init(&frame_lock, "frames");
+
+    free(memory_space);
+    memory_space = calloc(total_memory, 1);
+
+    // a list of n occupied blocks has at most n + 1 free ones between them
+    uint64_t max_blocks = 2 * (total_memory / (min_mem_per_proc > 0 ? min_mem_per_proc : 1)) + 1;
+    block_slab_size = max_blocks < 64 ? 64 : max_blocks > INT_MAX / 2 ? INT_MAX / 2 : (int)max_blocks;
+    while (block_slabs) {
+        BlockSlab *next = block_slabs->next;
+        free(block_slabs);
+        block_slabs = next;
+    }
+    free_blocks = NULL;
+    slab_blocks = 0;
 
-    num_frames = total_memory / mem_per_frame;
-    frame_table = calloc(num_frames, sizeof(Frame));
+    frame_table_destroy(&frame_table);
+    if (!frame_table_init(&frame_table, mem_per_frame > 0 ? (int)(total_memory / mem_per_frame) : 0))
+        printf("[ERROR] Out of memory for the frame table\n");
 }
 
 
@@ -71,122 +125,192 @@ int is_valid_memory_address(uint32_t address) {
     return (address % 2 == 0) && (address < MAX_MEMORY_SIZE);
 }
 
+// how much a page is in use: referenced since the last sample counts above its whole history
+static int page_use(const PageTableEntry *e) {
+    return (e->referenced ? 0x100 : 0) | e->history;
+}
+
+// p's least used resident page's frame, pages read ahead and not used yet left out if skip_prefetched, -1 if
+// there is none
+static int least_used_resident(Process *p, bool skip_prefetched) {
+    int best = -1, best_use = INT_MAX;
+    for (int f = p->resident_head, n = 0; n < p->resident_pages; n++, f = frame_table.next_resident[f]) {
+        const PageTableEntry *e = &p->page_table[frame_table.page[f]];
+        if (skip_prefetched && e->prefetched) continue;
+        int use = page_use(e);
+        if (use < best_use) {
+            best = f;
+            best_use = use;
+        }
+    }
+    return best;
+}
+
+// takes frame away from owner, the page stays in its block, with frame_lock held
+static void evict_page(Process *owner, int frame) {
+    PageTableEntry *e = &owner->page_table[frame_table.page[frame]];
+    e->valid = false;
+    e->referenced = false;
+    e->prefetched = false;
+    e->history = 0;
+    frame_table_remove_resident(&frame_table, frame, &owner->resident_head, &owner->resident_pages);
+    frame_table_release(&frame_table, frame);
+}
+
+// gives page a frame, from p's own pages once it is at its quota, else a free one, else the least recently used
+// one anywhere, false if no frame could be had
+// a prefetch only takes a free frame, past the quota if need be, sample_working_set trims p back down to its
+// quota once the page has been used
+static bool load_page(Process *p, int page, bool prefetch) {
+    int frame = -1;
+    if (prefetch) {
+        frame = frame_table_find_free(&frame_table);
+        if (frame < 0) return false;
+    } else if (p->resident_pages >= p->frame_quota) {
+        // pages read ahead go last, they are about to be used
+        frame = least_used_resident(p, true);
+        if (frame < 0) frame = least_used_resident(p, false);
+        if (frame >= 0) evict_page(p, frame);
+    }
+    if (frame < 0) frame = frame_table_find_free(&frame_table);
+
+    if (frame < 0) {
+        frame = frame_table_find_lru(&frame_table);
+        if (frame < 0) {
+            printf("[ERROR] Failed to find a valid victim frame\n");
+            return false;
+        }
+        lock_process_table();
+        Process *victim = find_process_by_pid(frame_table.pid[frame]);
+        unlock_process_table();
+        if (victim) {
+            evict_page(victim, frame);
+        } else {
+            // its owner is gone without releasing its frames
+            frame_table_release(&frame_table, frame);
+        }
+    }
+    if (frame < 0) return false;
+
+    frame_table_claim(&frame_table, frame, p->pid, page, CPU_TICKS);
+    frame_table_add_resident(&frame_table, frame, &p->resident_head, &p->resident_pages);
+    // a page faulted in is referenced right away, so a prefetch after it can't take its frame
+    p->page_table[page] = (PageTableEntry){frame, true, !prefetch, prefetch, 0};
+    return true;
+}
+
+// brings the page at virtual_address into a frame, and after a fault on the page following the last one faulted
+// or prefetched the pages after it too, twice as many as last time up to prefetch-pages
 int handle_page_fault(Process *p, uint32_t virtual_address) {
-    EnterCriticalSection(&backing_store_cs);  // Protect backing store access
+    timed_lock_enter(&frame_lock);
 
     uint32_t offset = virtual_address - p->mem_base;
-    uint32_t page_number = offset / memory.mem_per_frame;
+    int page_number = (int)(offset / memory.mem_per_frame);
 
     // Check for invalid page access
     if (page_number >= p->num_pages) {
         printf("[ACCESS VIOLATION] Invalid page access by P%d at 0x%X\n", p->pid, virtual_address);
-        p->state = FINISHED;
-        LeaveCriticalSection(&backing_store_cs);
+        PROC_STATE(p) = FINISHED;
+        timed_lock_leave(&frame_lock);
         return 0;
     }
+    if (p->page_table[page_number].valid) {
+        timed_lock_leave(&frame_lock);
+        return 1;
+    }
 
-    // Try to find a free frame first
-    for (int i = 0; i < num_frames; i++) {
-        if (!frame_table[i].occupied) {
-            // Load page from backing store into frame
-            frame_table[i] = (Frame){true, p->pid, page_number, CPU_TICKS};
-            p->page_table[page_number] = (PageTableEntry){i, true};
-            
-            // Read the page data from backing store
-            uint32_t page_start = p->mem_base + (page_number * memory.mem_per_frame);
-            uint32_t frame_start = i * memory.mem_per_frame / 2;  // Divide by 2 because memory_space is uint16_t array
-            
-            // Zero the frame contents first
-            memset(&memory_space[frame_start], 0, memory.mem_per_frame);
-            
-            // Increment page in stat only after successful page load
-            stats.num_paged_in++;
-            LeaveCriticalSection(&backing_store_cs);
-            return 1;
-        }
+    if (p->frame_quota == 0) p->frame_quota = p->num_pages < INITIAL_FRAME_QUOTA ? p->num_pages : INITIAL_FRAME_QUOTA;
+    stats.num_page_faults++;
+    p->window_faults++;
+
+    bool sequential = page_number > 0 && page_number == p->next_fault_page;
+    if (!sequential)
+        p->prefetch_run = 0;
+    else
+        p->prefetch_run = p->prefetch_run > 0 ? p->prefetch_run * 2 : 1;
+    if (p->prefetch_run > prefetch_pages) p->prefetch_run = prefetch_pages;
+    p->next_fault_page = page_number + 1;
+
+    if (!load_page(p, page_number, false)) {
+        timed_lock_leave(&frame_lock);
+        return 0;
+    }
+    for (int i = 1; i <= p->prefetch_run && page_number + i < p->num_pages; i++) {
+        int page = page_number + i;
+        if (p->page_table[page].valid) continue;
+        if (!load_page(p, page, true)) break;
+        stats.num_prefetched_pages++;
+        p->next_fault_page = page + 1;
     }
 
-    // No free frames - need to select a victim using Enhanced LRU
-    // printf("[Page Fault] No free frames available. Selecting victim frame...\n");
-    
-    int victim_idx = -1;
-    uint64_t oldest_access = UINT64_MAX;
-    Process *victim_process = NULL;
-
-    // First try to find pages from finished or sleeping processes
-    for (int i = 0; i < num_frames; i++) {
-        if (!frame_table[i].occupied) continue;
-
-        // Find the process that owns this frame
-        Process *owner = NULL;
-        for (int j = 0; j < num_processes; j++) {
-            if (process_table[j] && process_table[j]->pid == frame_table[i].pid) {
-                owner = process_table[j];
-                break;
-            }
-        }
+    timed_lock_leave(&frame_lock);
+    return 1;
+}
 
-        // Prefer pages from finished/sleeping processes
-        if (owner && (owner->state == FINISHED || owner->state == SLEEPING)) {
-            victim_idx = i;
-            victim_process = owner;
-            break;
-        }
+void reference_page(Process *p, uint16_t addr) {
+    if (working_set_window <= 0 || !p->page_table || frame_table.num_frames == 0) return;
+    uint64_t page = addr / memory.mem_per_frame;
+    // the tail of an allocation that is not a whole frame has no page
+    if (page >= (uint64_t)p->num_pages) return;
+
+    // the valid bit is only cleared under frame_lock, a page evicted right after this check just keeps a stale
+    // referenced bit until it is loaded again
+    PageTableEntry *e = &p->page_table[page];
+    if (!e->valid && !handle_page_fault(p, (uint32_t)(p->mem_base + addr))) return;
+    e->referenced = true;
+}
 
-        // Otherwise, track the least recently used frame
-        if (frame_table[i].last_used_tick < oldest_access) {
-            oldest_access = frame_table[i].last_used_tick;
-            victim_idx = i;
-            victim_process = owner;
+// shifts every resident page's referenced bit into its history, the pages with any history left are the working
+// set, then lets the fault rate move the quota between the working set and all of p's pages and trims p down to it
+static void sample_working_set(Process *p) {
+    int working_set = 0;
+    for (int f = p->resident_head, n = 0; n < p->resident_pages; n++, f = frame_table.next_resident[f]) {
+        PageTableEntry *e = &p->page_table[frame_table.page[f]];
+        if (e->referenced) {
+            frame_table.last_used[f] = CPU_TICKS;
+            if (e->prefetched) stats.num_prefetch_hits++;
+            e->prefetched = false;
         }
+        e->history = (uint8_t)((e->history >> 1) | (e->referenced ? 0x80 : 0));
+        e->referenced = false;
+        if (e->history) working_set++;
+    }
+    p->working_set = working_set;
+
+    p->fault_samples = (p->fault_samples << 8) | (uint64_t)(p->window_faults < 255 ? p->window_faults : 255);
+    p->window_faults = 0;
+    p->fault_rate = 0;
+    for (int i = 0; i < WORKING_SET_SAMPLES; i++)
+        p->fault_rate += (int)((p->fault_samples >> (8 * i)) & 0xFF);
+    if (p->fault_rate > page_fault_high && p->frame_quota < p->num_pages) {
+        p->frame_quota++;
+        stats.num_frame_quota_grows++;
+    } else if (p->fault_rate < page_fault_low && p->frame_quota > working_set && p->frame_quota > 1) {
+        p->frame_quota--;
+        stats.num_frame_quota_shrinks++;
     }
+    if (p->frame_quota < working_set) p->frame_quota = working_set;
 
-    if (victim_idx == -1 || !victim_process) {
-        printf("[ERROR] Failed to find a valid victim frame\n");
-        LeaveCriticalSection(&backing_store_cs);
-        return 0;
+    while (p->resident_pages > p->frame_quota) {
+        // only pages outside the working set go, read ahead ones that have not been used yet stay on top
+        int frame = least_used_resident(p, true);
+        if (frame < 0 || page_use(&p->page_table[frame_table.page[frame]]) != 0) break;
+        evict_page(p, frame);
     }
+}
 
-    int victim_page = frame_table[victim_idx].page_number;
-    printf("[Page Replacement] Evicting page %d of process %d from frame %d\n",
-           victim_page, victim_process->pid, victim_idx);
-
-    // Save the victim frame's contents to backing store
-    uint32_t victim_frame_start = victim_idx * memory.mem_per_frame / 2;
-    uint32_t victim_page_start = victim_process->mem_base + (victim_page * memory.mem_per_frame);
-
-    // Copy frame contents to a temporary buffer
-    uint16_t *page_buffer = malloc(memory.mem_per_frame);
-    if (page_buffer) {
-        memcpy(page_buffer, &memory_space[victim_frame_start], memory.mem_per_frame);
-        
-        // Mark the page as no longer in memory
-        victim_process->page_table[victim_page].valid = false;
-        
-        // Write victim process state to backing store
-        write_process_to_backing_store(victim_process);
-        
-        free(page_buffer);
-        // Increment page out stat only after successful page write to backing store
-        stats.num_paged_out++;
-        
-        printf("[Page Out] Successfully saved page %d of process %d to backing store\n",
-               victim_page, victim_process->pid);
-    } else {
-        printf("[ERROR] Failed to allocate buffer for page out operation\n");
-    }
-
-    // Clear the frame and load the new page
-    frame_table[victim_idx] = (Frame){true, p->pid, page_number, CPU_TICKS};
-    p->page_table[page_number] = (PageTableEntry){victim_idx, true};
-
-    // Zero the frame contents
-    uint32_t frame_start = victim_idx * memory.mem_per_frame / 2;
-    memset(&memory_space[frame_start], 0, memory.mem_per_frame);
-
-    stats.num_paged_in++;
-    LeaveCriticalSection(&backing_store_cs);
-    return 1;
+void sample_working_sets(Process **cores, int num_cores) {
+    if (working_set_window <= 0) return;
+    int period = working_set_window / WORKING_SET_SAMPLES > 0 ? working_set_window / WORKING_SET_SAMPLES : 1;
+    if (CPU_TICKS % period != 0) return;
+
+    timed_lock_enter(&frame_lock);
+    for (int i = 0; i < num_cores; i++) {
+        Process *p = cores[i];
+        if (p && p->page_table && p->frame_quota > 0)
+            sample_working_set(p);
+    }
+    timed_lock_leave(&frame_lock);
 }
 
 
@@ -232,15 +356,45 @@ int handle_page_fault(Process *p, uint32_t virtual_address) {
 //    return memory_space[physical_address / 2];
 // }
 
+static bool add_block_slab() {
+    BlockSlab *slab = malloc(sizeof(BlockSlab) + sizeof(MemoryBlock) * block_slab_size);
+    if (!slab) return false;
+    slab->count = block_slab_size;
+    slab->next = block_slabs;
+    block_slabs = slab;
+    slab_blocks += slab->count;
+    for (int i = 0; i < slab->count; i++) {
+        slab->blocks[i].next = free_blocks;
+        free_blocks = &slab->blocks[i];
+    }
+    return true;
+}
+
+MemoryBlock *alloc_memory_block() {
+    if (!free_blocks && !add_block_slab()) return NULL;
+    MemoryBlock *b = free_blocks;
+    free_blocks = b->next;
+    return b;
+}
+
+void free_memory_block(MemoryBlock *b) {
+    b->next = free_blocks;
+    free_blocks = b;
+}
+
 // Recalculate free memory and active processes by walking the list
 void update_free_memory() {
     uint64_t free_mem = 0;
+    uint64_t largest = 0;
     int proc_count = 0;
 
+    timed_lock_enter(&memory_lock);
     MemoryBlock* curr = memory_head;
     while (curr) {
         if (!curr->occupied) {
             free_mem += (curr->end - curr->base + 1);
+            if ((uint64_t)(curr->end - curr->base + 1) > largest)
+                largest = curr->end - curr->base + 1;
         } else {
             proc_count++;
         }
@@ -248,36 +402,63 @@ void update_free_memory() {
     }
 
     memory.free_memory = free_mem;
+    memory.largest_free = largest;
     memory.num_processes_in_memory = proc_count;
+    timed_lock_leave(&memory_lock);
 }
 
 // Coalesce adjacent free blocks
 void merge_adjacent_free_blocks(MemoryBlock **head_ref) {
+    timed_lock_enter(&memory_lock);
     MemoryBlock* curr = *head_ref;
 
     while (curr && curr->next) {
         if (!curr->occupied && !curr->next->occupied) {
             // Merge next block into current
             MemoryBlock* to_delete = curr->next;
+            free_index_remove(curr);
+            free_index_remove(to_delete);
             curr->end = to_delete->end;
             curr->next = to_delete->next;
-            free(to_delete);
+            free_memory_block(to_delete);
+            free_index_insert(curr);
         } else {
             curr = curr->next;
         }
     }
+    timed_lock_leave(&memory_lock);
+}
+
+// gives back every frame p holds, walking only its own resident set, its pages are left invalid
+static void release_resident_set(Process *p) {
+    timed_lock_enter(&frame_lock);
+    for (int frame = p->resident_head; p->resident_pages > 0; p->resident_pages--) {
+        int next = frame_table.next_resident[frame];
+        int page = frame_table.page[frame];
+        if (p->page_table && page >= 0 && page < p->num_pages)
+            p->page_table[page] = (PageTableEntry){frame, false, false, false, 0};
+        frame_table.next_resident[frame] = frame_table.prev_resident[frame] = -1;
+        frame_table_release(&frame_table, frame);
+        frame = next;
+    }
+    timed_lock_leave(&frame_lock);
 }
 
 // Free a process's memory block and update memory list
 void free_process_memory(Process *p, MemoryBlock **head_ref) {
     if(!p) return;
+    timed_lock_enter(&memory_lock);
+    // on exit and on swap out alike, a process with no pages in frames never touches the frame lock
+    if (p->resident_pages > 0) release_resident_set(p);
     MemoryBlock* curr = *head_ref;
 
     while (curr) {
         if (curr->occupied && curr->pid == p->pid) {
             curr->occupied = false;
             curr->pid = -1;
+            free_index_insert(curr);
             p->in_memory = 0;
+            memory.releases++;
             break;
         }
         curr = curr->next;
@@ -288,16 +469,254 @@ void free_process_memory(Process *p, MemoryBlock **head_ref) {
 
     // Recalculate memory stats
     update_free_memory();
+    timed_lock_leave(&memory_lock);
     // Don't increment num_paged_out here - it should only be incremented during actual page outs
 }
 
+// slides occupied blocks down into the free block below them, lowest first, so free space collects at the top
+// a block moves only if its process is not in pinned and is still in the process table, the caller keeps pinned
+// processes from running while this moves the others' memory_space contents, mem_base and mem_limit
+// stops before moving more than max_bytes, returns the bytes moved and how many blocks in *moves
+uint64_t compact_memory(uint64_t max_bytes, const int *pinned, int num_pinned, int *moves) {
+    uint64_t moved = 0;
+    *moves = 0;
+    if (!memory_space) return 0;
+
+    timed_lock_enter(&memory_lock);
+    MemoryBlock *hole = memory_head;
+    while (hole && hole->next) {
+        MemoryBlock *b = hole->next;
+        if (hole->occupied || !b->occupied) {
+            hole = b;
+            continue;
+        }
+
+        uint64_t size = b->end - b->base + 1;
+        if (moved + size > max_bytes) break;
+
+        bool is_pinned = false;
+        for (int i = 0; i < num_pinned && !is_pinned; i++)
+            is_pinned = pinned[i] == b->pid;
+        Process *p = NULL;
+        if (!is_pinned) {
+            // it can't be freed while its block is, free_process_memory needs memory_lock first
+            lock_process_table();
+            p = find_process_by_pid(b->pid);
+            unlock_process_table();
+        }
+        if (!p || !p->in_memory || p->mem_base != (uint64_t)b->base) {
+            // stays where it is, the next hole is above it
+            hole = b;
+            continue;
+        }
+
+        memmove(&memory_space[hole->base], &memory_space[b->base], size);
+        free_index_remove(hole);
+        hole->occupied = true;
+        hole->pid = b->pid;
+        hole->end = hole->base + (int)size - 1;
+        b->occupied = false;
+        b->pid = -1;
+        b->base = hole->end + 1;
+        p->mem_base = hole->base;
+        p->mem_limit = hole->end;
+        moved += size;
+        (*moves)++;
+
+        // the space it left joins the free block above
+        MemoryBlock *above = b->next;
+        if (above && !above->occupied) {
+            free_index_remove(above);
+            b->end = above->end;
+            b->next = above->next;
+            free_memory_block(above);
+        }
+        free_index_insert(b);
+        hole = b;
+    }
+
+    if (moved > 0) {
+        // bigger free blocks than before, processes waiting for room try again
+        memory.releases++;
+        update_free_memory();
+    }
+    timed_lock_leave(&memory_lock);
+    return moved;
+}
+
+// the biggest process that could be allocated right now
+uint64_t largest_free_block() {
+    timed_lock_enter(&memory_lock);
+    uint64_t largest = free_index_largest();
+    timed_lock_leave(&memory_lock);
+    return largest;
+}
+
+void set_paging(int window, int fault_high, int fault_low, int prefetch) {
+    working_set_window = window > 0 ? window : 0;
+    page_fault_high = fault_high;
+    page_fault_low = fault_low;
+    prefetch_pages = prefetch > 0 ? prefetch : 0;
+}
+
+bool set_placement_policy(const char *name) {
+    for (int i = 0; i < (int)(sizeof(placement_names) / sizeof(placement_names[0])); i++) {
+        if (strcmp(name, placement_names[i]) == 0) {
+            placement = (PlacementPolicy)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *placement_policy_name() {
+    return placement_names[placement];
+}
+
+MemoryBlock *allocate_block(uint64_t size, int pid) {
+    LARGE_INTEGER start, end, freq;
+    QueryPerformanceCounter(&start);
+
+    MemoryBlock *b = NULL;
+    switch (placement) {
+        case PLACE_FIRST_FIT: b = free_index_first_fit(size); break;
+        case PLACE_NEXT_FIT:  b = free_index_next_fit(size, next_fit_from); break;
+        case PLACE_BEST_FIT:  b = free_index_best_fit(size); break;
+        case PLACE_WORST_FIT: b = free_index_worst_fit(size); break;
+    }
+
+    // If there's leftover space, split the block
+    MemoryBlock *rest = NULL;
+    if (b && (uint64_t)(b->end - b->base + 1) > size) {
+        rest = alloc_memory_block();
+        if (!rest) b = NULL;
+    }
+    if (b) {
+        free_index_remove(b);
+        if (rest) {
+            rest->base = b->base + (int)size;
+            rest->end = b->end;
+            rest->occupied = false;
+            rest->pid = -1;
+            rest->next = b->next;
+            b->end = rest->base - 1;
+            b->next = rest;
+            free_index_insert(rest);
+        }
+        b->occupied = true;
+        b->pid = pid;
+        next_fit_from = b->end + 1;
+    }
+
+    QueryPerformanceCounter(&end);
+    QueryPerformanceFrequency(&freq);
+    uint64_t ns = (uint64_t)((end.QuadPart - start.QuadPart) * 1e9 / freq.QuadPart);
+    if (b)
+        stats.placements++;
+    else
+        stats.placement_failures++;
+    stats.placement_ns += ns;
+    if (ns > stats.placement_max_ns) stats.placement_max_ns = ns;
+
+    // the range still holds whatever the last owner or a compaction left there, a new owner reads zeros
+    if (b && memory_space) memset(&memory_space[b->base], 0, size);
+    return b;
+}
+
+int find_room(uint64_t size, const int *pids, const double *costs, int n, int max_victims, int *chosen) {
+    // the block list as sizes and owners: the index of a candidate, -1 for free, -2 for a block that has to stay
+    // the buffers are shared, so the whole search stays under memory_lock
+    timed_lock_enter(&memory_lock);
+    if (room_capacity < slab_blocks) {
+        uint64_t *grown_sizes = realloc(room_sizes, sizeof(uint64_t) * slab_blocks);
+        if (grown_sizes) room_sizes = grown_sizes;
+        int *grown_owners = realloc(room_owners, sizeof(int) * slab_blocks);
+        if (grown_owners) room_owners = grown_owners;
+        if (!grown_sizes || !grown_owners) {
+            timed_lock_leave(&memory_lock);
+            return -1;
+        }
+        room_capacity = slab_blocks;
+    }
+    uint64_t *sizes = room_sizes;
+    int *owners = room_owners;
+    int num_blocks = 0;
+    for (MemoryBlock *curr = memory_head; curr; curr = curr->next, num_blocks++) {
+        sizes[num_blocks] = curr->end - curr->base + 1;
+        owners[num_blocks] = curr->occupied ? -2 : -1;
+        for (int i = 0; curr->occupied && i < n; i++) {
+            if (pids[i] == curr->pid) owners[num_blocks] = i;
+        }
+    }
+
+    // the shortest run ending at each block is also the cheapest one, costs are never negative
+    int best_first = -1, best_last = -1;
+    double best_cost = 0;
+    int first = 0;
+    uint64_t total = 0;
+    double cost = 0;
+    int victims = 0;
+    for (int last = 0; last < num_blocks; last++) {
+        if (owners[last] == -2) {
+            first = last + 1;
+            total = 0;
+            cost = 0;
+            victims = 0;
+            continue;
+        }
+        total += sizes[last];
+        if (owners[last] >= 0) {
+            cost += costs[owners[last]];
+            victims++;
+        }
+        while (first < last && total - sizes[first] >= size) {
+            total -= sizes[first];
+            if (owners[first] >= 0) {
+                cost -= costs[owners[first]];
+                victims--;
+            }
+            first++;
+        }
+        if (total >= size && victims <= max_victims && (best_first < 0 || cost < best_cost)) {
+            best_first = first;
+            best_last = last;
+            best_cost = cost;
+        }
+    }
+
+    int count = -1;
+    if (best_first >= 0) {
+        count = 0;
+        for (int i = best_first; i <= best_last; i++) {
+            if (owners[i] >= 0) chosen[count++] = owners[i];
+        }
+    }
+    timed_lock_leave(&memory_lock);
+    return count;
+}
+
+// a new list replaces the old one, all of whose nodes go back to the slabs
 MemoryBlock* init_memory_block(uint64_t total_memory) {
-    MemoryBlock* head = (MemoryBlock*)malloc(sizeof(MemoryBlock));
-    head->base = 0;
-    head->end = total_memory - 1;
-    head->occupied = false;
-    head->pid = -1;
-    head->next = NULL;
+    timed_lock_enter(&memory_lock);
+    free_blocks = NULL;
+    for (BlockSlab *slab = block_slabs; slab; slab = slab->next) {
+        for (int i = 0; i < slab->count; i++) {
+            slab->blocks[i].next = free_blocks;
+            free_blocks = &slab->blocks[i];
+        }
+    }
+    free_index_reset();
+    MemoryBlock* head = alloc_memory_block();
+    if (head) {
+        head->base = 0;
+        head->end = total_memory - 1;
+        head->occupied = false;
+        head->pid = -1;
+        head->next = NULL;
+        free_index_insert(head);
+    }
+    next_fit_from = 0;
+    timed_lock_leave(&memory_lock);
     return head;
 }
 
@@ -346,15 +765,22 @@ void update_used_free_memory() {
     memory.free_memory = memory.total_memory - used_memory;
 }
 
-void process_smi(int num_cores, Process **cpu_cores) {
+void process_smi() {
+    SystemSnapshot snap;
+    read_snapshot(&snap);
+    int num_cores = snap.num_cores;
 
     // Allocate dynamic arrays for storing process info
-    int *temp_pids = malloc(sizeof(int) * num_cores);  // Only need space for cores
-    uint64_t *temp_allocs = malloc(sizeof(uint64_t) * num_cores);
-    if (!temp_pids || !temp_allocs) {
+    int *temp_pids = malloc(sizeof(int) * (num_cores > 0 ? num_cores : 1));  // Only need space for cores
+    uint64_t *temp_allocs = malloc(sizeof(uint64_t) * (num_cores > 0 ? num_cores : 1));
+    uint64_t *temp_rss = malloc(sizeof(uint64_t) * (num_cores > 0 ? num_cores : 1));
+    uint64_t *temp_ws = malloc(sizeof(uint64_t) * (num_cores > 0 ? num_cores : 1));
+    if (!temp_pids || !temp_allocs || !temp_rss || !temp_ws) {
         fprintf(stderr, "Memory allocation failed in process_smi()\n");
         free(temp_pids);
         free(temp_allocs);
+        free(temp_rss);
+        free(temp_ws);
         return;
     }
 
@@ -363,11 +789,13 @@ void process_smi(int num_cores, Process **cpu_cores) {
 
     // Only collect processes that are currently on CPU cores
     for (int i = 0; i < num_cores; i++) {
-        Process *p = cpu_cores[i];
-        if (p) {
-            temp_pids[temp_count] = p->pid;
-            temp_allocs[temp_count] = p->memory_allocation;
-            used_memory += p->memory_allocation;
+        CoreSnapshot *c = &snap.cores[i];
+        if (c->pid != 0) {
+            temp_pids[temp_count] = c->pid;
+            temp_allocs[temp_count] = c->memory_allocation;
+            temp_rss[temp_count] = (uint64_t)c->resident_pages * memory.mem_per_frame;
+            temp_ws[temp_count] = (uint64_t)c->working_set * memory.mem_per_frame;
+            used_memory += c->memory_allocation;
             temp_count++;
         }
     }
@@ -385,7 +813,7 @@ void process_smi(int num_cores, Process **cpu_cores) {
     printf("----------------------------------------------\n");
 
     for (int i = 0; i < temp_count; i++) {
-        printf("P%d %lldB\n", temp_pids[i], temp_allocs[i]);
+        printf("P%d %lldB RSS %lldB WS %lldB\n", temp_pids[i], temp_allocs[i], temp_rss[i], temp_ws[i]);
     }
 
     printf("----------------------------------------------\n");
@@ -393,17 +821,63 @@ void process_smi(int num_cores, Process **cpu_cores) {
     // Free dynamically allocated memory
     free(temp_pids);
     free(temp_allocs);
+    free(temp_rss);
+    free(temp_ws);
 }
 
 
-void vmstat(Memory *mem, CPUStats *stats) {
-    printf("%10lld %4s %s\n", memory.total_memory, "B", "total memory");
-    update_used_free_memory();
-    printf("%10lld %4s %s\n", memory.used_memory, "B", "used memory");
-    printf("%10lld %4s %s\n", memory.free_memory, "B", "free memory");
-    printf("%10d %4s %s\n", stats->total_ticks, "B", "total ticks");
-    printf("%10d %4s %s\n", stats->active_ticks, "", "active ticks");
-    printf("%10d %4s %s\n", stats->idle_ticks, "", "idle ticks");
-    printf("%10d %4s %s\n", stats->num_paged_in, "", "num paged in");
-    printf("%10d %4s %s\n", stats->num_paged_out, "", "num paged out");
+void vmstat() {
+    // memory and tick counters as of the last scheduler tick, the block list is not walked here
+    SystemSnapshot snap;
+    read_snapshot(&snap);
+    printf("%10lld %4s %s\n", snap.total_memory, "B", "total memory");
+    printf("%10lld %4s %s\n", snap.used_memory, "B", "used memory");
+    printf("%10lld %4s %s\n", snap.free_memory, "B", "free memory");
+    printf("%10d %4s %s\n", snap.stats.total_ticks, "B", "total ticks");
+    printf("%10d %4s %s\n", snap.stats.active_ticks, "", "active ticks");
+    printf("%10d %4s %s\n", snap.stats.idle_ticks, "", "idle ticks");
+    printf("%10d %4s %s\n", snap.stats.num_paged_in, "", "num paged in");
+    printf("%10d %4s %s\n", snap.stats.num_paged_out, "", "num paged out");
+    printf("%10d %4s %s\n", snap.stats.num_evictions, "", "evictions");
+    printf("%10d %4s %s\n", snap.stats.num_page_faults, "", "page faults");
+    printf("%10d %4s %s\n", snap.stats.num_prefetched_pages, "", "pages prefetched");
+    printf("%10d %4s %s\n", snap.stats.num_prefetch_hits, "", "prefetch hits");
+    printf("%10d %4s %s\n", snap.stats.num_frame_quota_grows, "", "frame quota grows");
+    printf("%10d %4s %s\n", snap.stats.num_frame_quota_shrinks, "", "frame quota shrinks");
+    printf("%10d %4s %s\n", snap.stats.num_thrash_swaps, "", "thrash swaps");
+    printf("%10s %4s %s\n", placement_policy_name(), "", "placement policy");
+    uint64_t placement_tries = snap.stats.placements + snap.stats.placement_failures;
+    printf("%10llu %4s %s\n", (unsigned long long)snap.stats.placements, "", "placements");
+    printf("%10llu %4s %s\n", (unsigned long long)snap.stats.placement_failures, "", "failed placements");
+    printf("%10.0f %4s %s\n", placement_tries > 0 ? (double)snap.stats.placement_ns / placement_tries : 0.0, "ns",
+           "average placement time");
+    printf("%10llu %4s %s\n", (unsigned long long)snap.stats.placement_max_ns, "ns", "max placement time");
+    printf("%10lld %4s %s\n", snap.largest_free_block, "B", "largest free block");
+    printf("%10.1f %4s %s\n", snap.free_memory > 0 ? 100.0 * (1.0 - (double)snap.largest_free_block / snap.free_memory) : 0.0,
+           "%", "external fragmentation");
+    printf("%10d %4s %s\n", snap.stats.num_compaction_moves, "", "compaction moves");
+    printf("%10lld %4s %s\n", snap.stats.compaction_bytes, "B", "bytes compacted");
+    printf("%10d %4s %s\n", snap.stats.num_memory_waits, "", "memory waits");
+    printf("%10d %4s %s\n", snap.stats.num_memory_wait_timeouts, "", "memory wait timeouts");
+    printf("%10d %4s %s\n", snap.stats.num_memory_wait_overflows, "", "memory wait overflows");
+
+    // kept by the swap cache itself, it runs on the swap I/O thread
+    SwapCacheStats cache;
+    swap_cache_stats(&cache);
+    uint64_t swap_ins = cache.hits + cache.misses;
+    printf("%10llu %4s %s\n", cache.hits, "", "swap cache hits");
+    printf("%10llu %4s %s\n", cache.misses, "", "swap cache misses");
+    printf("%10.1f %4s %s\n", swap_ins > 0 ? 100.0 * cache.hits / swap_ins : 0.0, "%", "swap cache hit rate");
+    printf("%10.2f %4s %s\n", cache.stored_bytes > 0 ? (double)cache.raw_bytes / cache.stored_bytes : 0.0, "x",
+           "swap cache compression");
+    printf("%10llu %4s %s\n", cache.write_backs, "", "swap cache write-backs");
+    printf("%10llu %4s %s\n", cache.used, "B", "swap cache used");
+    printf("%10u %4s %s\n", cache.entries, "", "swap cache entries");
+    printf("%10ld %4s %s\n", log_stream_dropped(), "", "log records dropped");
+
+    int ticks = snap.stats.total_ticks;
+    printf("%10.1f %4s %s\n", ticks > 0 ? snap.stats.tick_work_total_ns / 1000.0 / ticks : 0.0, "us", "avg tick work");
+    printf("%10llu %4s %s\n", tick_work_percentile_us(&snap.stats, 50.0), "us", "p50 tick work (bucket)");
+    printf("%10llu %4s %s\n", tick_work_percentile_us(&snap.stats, 99.0), "us", "p99 tick work (bucket)");
+    printf("%10.1f %4s %s\n", snap.stats.tick_work_max_ns / 1000.0, "us", "max tick work");
 }
@@ -0,0 +1,379 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include <winioctl.h>
+#include "mmap_store.h"
+#include "backing_store.h"
+#include "process_image.h"
+
+#define MMAP_STORE_BATCH 32             // processes per write
+#define MAX_IO_CHUNK (1u << 30)         // ReadFile and WriteFile take a DWORD length
+
+// where each stored image lives, by swap directory id
+typedef struct {
+    uint64_t offset;                    // the process image without its program
+    uint32_t image_length;
+    uint64_t program_offset;            // page aligned
+    uint32_t program_length;
+    bool live;
+    bool ok;                            // false if the write failed, reading it reports the process lost
+    bool mapped;                        // a process runs the program out of the file, its pages go when it is freed
+    bool whole;                         // written back from the swap cache, the image still has its program
+} StoreEntry;
+
+static HANDLE store_file = INVALID_HANDLE_VALUE;
+static char store_path[260];
+static size_t page_size = 4096;
+static size_t map_granularity = 65536;  // views have to start on this, so a program's view starts at or before it
+static bool sparse = false;             // zeroed ranges only give space back on a sparse file
+
+// bumped whenever the file is closed, a mapping of an older file is only unmapped on release
+static volatile LONG generation = 1;
+// mappings of the current file still in use, the file is only truncated when there are none
+static volatile LONG live_mappings = 0;
+
+static StoreEntry *entries = NULL;
+static uint32_t entries_capacity = 0;
+static uint32_t num_live = 0;
+static uint64_t end_offset = 0;         // where the next image goes, always page aligned
+
+static uint64_t page_round(uint64_t n) {
+    return (n + page_size - 1) & ~(uint64_t)(page_size - 1);
+}
+
+static StoreEntry *entry_of(uint32_t id) {
+    if (id >= entries_capacity || !entries[id].live) return NULL;
+    return &entries[id];
+}
+
+static StoreEntry *add_entry(uint32_t id) {
+    if (id >= entries_capacity) {
+        uint32_t new_cap = entries_capacity ? entries_capacity : 64;
+        while (new_cap <= id) new_cap *= 2;
+        StoreEntry *grown = realloc(entries, sizeof(StoreEntry) * new_cap);
+        if (!grown) return NULL;
+        memset(grown + entries_capacity, 0, sizeof(StoreEntry) * (new_cap - entries_capacity));
+        entries = grown;
+        entries_capacity = new_cap;
+    }
+
+    StoreEntry *e = &entries[id];
+    memset(e, 0, sizeof(*e));
+    e->live = true;
+    num_live++;
+    return e;
+}
+
+static OVERLAPPED at_offset(uint64_t offset) {
+    OVERLAPPED o;
+    memset(&o, 0, sizeof(o));
+    o.Offset = (DWORD)offset;
+    o.OffsetHigh = (DWORD)(offset >> 32);
+    return o;
+}
+
+static bool write_at(const char *buf, uint64_t length, uint64_t offset) {
+    while (length > 0) {
+        DWORD chunk = length > MAX_IO_CHUNK ? MAX_IO_CHUNK : (DWORD)length;
+        OVERLAPPED o = at_offset(offset);
+        DWORD done = 0;
+        if (!WriteFile(store_file, buf, chunk, &done, &o) || done != chunk) return false;
+        buf += chunk;
+        offset += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+static bool read_at(char *buf, uint64_t length, uint64_t offset) {
+    while (length > 0) {
+        DWORD chunk = length > MAX_IO_CHUNK ? MAX_IO_CHUNK : (DWORD)length;
+        OVERLAPPED o = at_offset(offset);
+        DWORD done = 0;
+        if (!ReadFile(store_file, buf, chunk, &done, &o) || done != chunk) return false;
+        buf += chunk;
+        offset += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+static void release_space(uint64_t offset, uint64_t length) {
+    if (length == 0 || !sparse) return;
+    FILE_ZERO_DATA_INFORMATION zero;
+    zero.FileOffset.QuadPart = (LONGLONG)offset;
+    zero.BeyondFinalZero.QuadPart = (LONGLONG)(offset + length);
+    DWORD returned = 0;
+    // a range another program's view still covers can't be zeroed yet, it goes with the next truncate
+    if (!DeviceIoControl(store_file, FSCTL_SET_ZERO_DATA, &zero, sizeof(zero), NULL, 0, &returned, NULL) &&
+        GetLastError() != ERROR_USER_MAPPED_FILE)
+        printf("[ERROR] Failed to release backing store space (error %lu)\n", (unsigned long)GetLastError());
+}
+
+static bool truncate_store() {
+    LARGE_INTEGER zero;
+    zero.QuadPart = 0;
+    return SetFilePointerEx(store_file, zero, NULL, FILE_BEGIN) && SetEndOfFile(store_file);
+}
+
+void mmap_store_close() {
+    if (store_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(store_file);
+        // views of the old file keep it alive, so it is moved aside and a later open can create a new one
+        if (live_mappings > 0) {
+            char old_path[280];
+            snprintf(old_path, sizeof(old_path), "%s.%ld.old", store_path, (long)generation);
+            if (MoveFileExA(store_path, old_path, MOVEFILE_REPLACE_EXISTING))
+                DeleteFileA(old_path);
+        } else {
+            DeleteFileA(store_path);
+        }
+    }
+    store_file = INVALID_HANDLE_VALUE;
+    InterlockedIncrement(&generation);
+    InterlockedExchange(&live_mappings, 0);
+
+    free(entries);
+    entries = NULL;
+    entries_capacity = 0;
+    num_live = 0;
+    end_offset = 0;
+}
+
+bool mmap_store_open(const char *path) {
+    mmap_store_close();
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    if (info.dwPageSize > 0) page_size = info.dwPageSize;
+    if (info.dwAllocationGranularity > 0) map_granularity = info.dwAllocationGranularity;
+
+    // start empty, pids and scheduling state from a previous run mean nothing now
+    snprintf(store_path, sizeof(store_path), "%s", path);
+    store_file = CreateFileA(store_path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                             CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (store_file == INVALID_HANDLE_VALUE) {
+        printf("[ERROR] Failed to initialize backing store (error %lu)\n", (unsigned long)GetLastError());
+        return false;
+    }
+
+    // without it the store still works, removed entries just keep their disk space until the file empties
+    DWORD returned = 0;
+    sparse = DeviceIoControl(store_file, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &returned, NULL) != 0;
+    return true;
+}
+
+// lays one entry out at end_offset: the image, padding to the program page, the program, padding to the next entry
+static void place_entry(Process *p, StoreEntry *e, char *batch, uint64_t batch_offset) {
+    uint64_t program_length = sizeof(Instruction) * (uint64_t)process_program_size(p);
+    size_t image_length = process_image_pack(p, PROCESS_IMAGE_NO_PROGRAM, batch + (end_offset - batch_offset));
+
+    e->offset = end_offset;
+    e->image_length = (uint32_t)image_length;
+    e->program_offset = end_offset + page_round(image_length);
+    e->program_length = (uint32_t)program_length;
+    e->ok = true;
+
+    if (program_length > 0)
+        memcpy(batch + (e->program_offset - batch_offset), p->instructions, program_length);
+    end_offset = e->program_offset + page_round(program_length);
+}
+
+// the batch goes out in one write, on failure its entries read back as lost
+static void write_batch(const char *batch, uint64_t batch_offset, const uint32_t *queued_ids, int queued) {
+    if (!write_at(batch, end_offset - batch_offset, batch_offset)) {
+        printf("[ERROR] Write to the backing store failed (error %lu)\n", (unsigned long)GetLastError());
+        for (int q = 0; q < queued; q++)
+            entries[queued_ids[q]].ok = false;
+    }
+}
+
+void mmap_store_write(Process **procs, const uint32_t *ids, int count) {
+    for (int start = 0; start < count; start += MMAP_STORE_BATCH) {
+        int n = count - start < MMAP_STORE_BATCH ? count - start : MMAP_STORE_BATCH;
+        uint32_t queued_ids[MMAP_STORE_BATCH];
+        int queued = 0;
+        uint64_t batch_offset = end_offset;
+
+        // WriteFile has no gather form for buffered files, so the batch is laid out in one zeroed buffer
+        uint64_t batch_bound = 0;
+        for (int i = start; i < start + n; i++) {
+            if (!procs[i]) continue;
+            batch_bound += page_round(process_image_bound(procs[i], PROCESS_IMAGE_NO_PROGRAM)) +
+                           page_round(sizeof(Instruction) * (uint64_t)process_program_size(procs[i]));
+        }
+        char *batch = calloc(1, batch_bound ? (size_t)batch_bound : 1);
+        if (!batch) {
+            printf("[ERROR] Out of memory packing %d processes for the backing store\n", n);
+            continue;
+        }
+
+        // the entries of a batch are back to back, so the whole batch is one write
+        for (int i = start; i < start + n; i++) {
+            Process *p = procs[i];
+            if (!p) continue;
+
+            StoreEntry *e = add_entry(ids[i]);
+            if (!e) {
+                printf("[ERROR] Out of memory for the backing store index, P%d is lost\n", p->pid);
+                continue;
+            }
+            place_entry(p, e, batch, batch_offset);
+            queued_ids[queued++] = ids[i];
+        }
+
+        if (queued > 0) write_batch(batch, batch_offset, queued_ids, queued);
+        free(batch);
+    }
+}
+
+void mmap_store_write_images(const char *images, const uint32_t *lengths, const uint32_t *ids, int count) {
+    for (int start = 0; start < count; start += MMAP_STORE_BATCH) {
+        int n = count - start < MMAP_STORE_BATCH ? count - start : MMAP_STORE_BATCH;
+        uint32_t queued_ids[MMAP_STORE_BATCH];
+        int queued = 0;
+        uint64_t batch_offset = end_offset;
+
+        uint64_t batch_bound = 0;
+        for (int i = start; i < start + n; i++)
+            batch_bound += page_round(lengths[i]);
+        char *batch = calloc(1, batch_bound ? (size_t)batch_bound : 1);
+        if (!batch) {
+            printf("[ERROR] Out of memory writing %d swap cache entries to the backing store\n", n);
+            for (int i = start; i < start + n; i++)
+                images += lengths[i];
+            continue;
+        }
+
+        // each image starts on a page like any other entry, with no program after it
+        for (int i = start; i < start + n; images += lengths[i], i++) {
+            StoreEntry *e = add_entry(ids[i]);
+            if (!e) {
+                printf("[ERROR] Out of memory for the backing store index, swap entry %u is lost\n", (unsigned)ids[i]);
+                continue;
+            }
+            memcpy(batch + (end_offset - batch_offset), images, lengths[i]);
+            e->offset = end_offset;
+            e->image_length = lengths[i];
+            e->program_offset = end_offset + page_round(lengths[i]);
+            e->ok = true;
+            e->whole = true;
+            end_offset = e->program_offset;
+            queued_ids[queued++] = ids[i];
+        }
+
+        if (queued > 0) write_batch(batch, batch_offset, queued_ids, queued);
+        free(batch);
+    }
+}
+
+// reads the program into memory, for entries whose program is already mapped or can't be
+static Process *read_copy(StoreEntry *e, const char *image) {
+    int program_size = (int)(e->program_length / sizeof(Instruction));
+    Instruction *program = program_size > 0 ? malloc(e->program_length) : NULL;
+    if (program_size > 0 && !program) return NULL;
+
+    Process *p = NULL;
+    if (program_size == 0 || read_at((char *)program, e->program_length, e->program_offset))
+        p = process_image_unpack_with_program(image, e->image_length, program, program_size);
+    else
+        printf("[ERROR] Read from the backing store failed (error %lu)\n", (unsigned long)GetLastError());
+
+    free(program);
+    return p;
+}
+
+// a read-only view of the program, NULL if it can't be mapped
+static Instruction *map_program(StoreEntry *e) {
+    HANDLE mapping = CreateFileMappingA(store_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) return NULL;
+
+    // the view starts on the granularity boundary at or before the program, other entries' pages come along unused
+    uint64_t view_offset = e->program_offset - e->program_offset % map_granularity;
+    SIZE_T view_length = (SIZE_T)(e->program_offset - view_offset + e->program_length);
+    char *view = MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)(view_offset >> 32), (DWORD)view_offset, view_length);
+    // the view holds the section open on its own
+    CloseHandle(mapping);
+    if (!view) return NULL;
+    return (Instruction *)(view + (e->program_offset - view_offset));
+}
+
+Process *mmap_store_read(uint32_t id) {
+    StoreEntry *e = entry_of(id);
+    if (!e || !e->ok) return NULL;
+
+    char *image = malloc(e->image_length);
+    if (!image) return NULL;
+    if (!read_at(image, e->image_length, e->offset)) {
+        printf("[ERROR] Read from the backing store failed (error %lu)\n", (unsigned long)GetLastError());
+        free(image);
+        return NULL;
+    }
+
+    Process *p = NULL;
+    if (e->whole) {
+        p = process_image_unpack(image, e->image_length);
+        if (!p) printf("[ERROR] Corrupt backing store entry at offset %llu\n", (unsigned long long)e->offset);
+        free(image);
+        return p;
+    }
+
+    // two processes running out of the same pages would free them twice, the second one gets a copy
+    if (e->program_length == 0 || e->mapped) {
+        p = read_copy(e, image);
+        free(image);
+        return p;
+    }
+
+    // not populated, the pages are still in the cache from the write and fault in as the program reaches them
+    Instruction *program = map_program(e);
+    if (!program) {
+        p = read_copy(e, image);
+        free(image);
+        return p;
+    }
+
+    p = process_image_attach(image, e->image_length, program, (int)(e->program_length / sizeof(Instruction)),
+                             (int)generation, e->program_offset);
+    free(image);
+    if (!p) {
+        printf("[ERROR] Corrupt backing store entry at offset %llu\n", (unsigned long long)e->offset);
+        UnmapViewOfFile((char *)program - e->program_offset % map_granularity);
+        return NULL;
+    }
+
+    e->mapped = true;
+    InterlockedIncrement(&live_mappings);
+    return p;
+}
+
+void mmap_store_remove(uint32_t id) {
+    StoreEntry *e = entry_of(id);
+    if (!e) return;
+    e->live = false;
+    num_live--;
+
+    // nothing stored and nothing mapped, start the file over
+    if (num_live == 0 && live_mappings == 0) {
+        if (!truncate_store())
+            printf("[ERROR] Failed to truncate backing store (error %lu)\n", (unsigned long)GetLastError());
+        end_offset = 0;
+        return;
+    }
+
+    // every entry is page aligned, so its pages are released where they are and the file never needs compacting
+    release_space(e->offset, e->program_offset - e->offset);
+    if (!e->mapped)
+        release_space(e->program_offset, page_round(e->program_length));
+}
+
+void mmap_store_release(Instruction *program, int program_size, int store_generation, uint64_t offset) {
+    UnmapViewOfFile((char *)program - offset % map_granularity);
+
+    // under backing_store_lock, so mmap_store_remove can't see the count drop and truncate before the pages go
+    if (store_generation == (int)generation) {
+        release_space(offset, page_round(sizeof(Instruction) * (uint64_t)program_size));
+        InterlockedDecrement(&live_mappings);
+    }
+}
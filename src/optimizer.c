@@ -0,0 +1,99 @@
+#include <string.h>
+#include "optimizer.h"
+
+#define MAX_COST 255
+
+OptimizerMode get_optimizer_mode(const char *name) {
+    if (strcmp(name, "accurate") == 0) return OPTIMIZER_ACCURATE;
+    if (strcmp(name, "throughput") == 0) return OPTIMIZER_THROUGHPUT;
+    return OPTIMIZER_OFF;
+}
+
+static int cost_of(const Instruction *inst) {
+    return inst->cost ? inst->cost : 1;
+}
+
+// cost of an instruction that replaces prev and cur
+static int fused_cost(const Instruction *prev, const Instruction *cur, OptimizerMode mode) {
+    if (mode == OPTIMIZER_THROUGHPUT) return 1;
+    return cost_of(prev) + cost_of(cur);
+}
+
+// try to merge cur into prev, returns 1 if cur was absorbed
+static int fuse(Instruction *prev, const Instruction *cur, OptimizerMode mode) {
+    int cost = fused_cost(prev, cur, mode);
+    if (cost > MAX_COST) return 0;
+
+    // DECLARE(x) followed by another write to x
+    if (prev->type == DECLARE && strcmp(prev->arg1, cur->arg1) == 0) {
+        if (cur->type == DECLARE) {
+            *prev = *cur;
+            prev->cost = cost;
+            return 1;
+        }
+        if (cur->type == ADD || cur->type == SUBTRACT) {
+            if (strcmp(cur->arg2, prev->arg1) != 0 && strcmp(cur->arg3, prev->arg1) != 0) {
+                // x is overwritten without being read, drop the DECLARE
+                *prev = *cur;
+            } else {
+                // keep the declared value and take the operands of the ADD/SUBTRACT
+                prev->type = cur->type == ADD ? DECLARE_ADD : DECLARE_SUBTRACT;
+                strcpy(prev->arg2, cur->arg2);
+                strcpy(prev->arg3, cur->arg3);
+            }
+            prev->cost = cost;
+            return 1;
+        }
+    }
+
+    // consecutive PRINTs of the same variable
+    if ((prev->type == PRINT || prev->type == PRINT_REPEAT) && cur->type == PRINT &&
+        strcmp(prev->arg1, cur->arg1) == 0) {
+        int count = prev->type == PRINT_REPEAT ? prev->repeat_count : 1;
+        if (count >= 255) return 0;
+        prev->type = PRINT_REPEAT;
+        prev->repeat_count = count + 1;
+        prev->cost = cost;
+        return 1;
+    }
+
+    return 0;
+}
+
+// FOR bodies are either a parsed sub_instructions array or a range of the process program
+static Instruction *body_of(Instruction *program, const Instruction *inst) {
+    if (inst->sub_instructions) return inst->sub_instructions;
+    if (program && inst->sub_instruction_count > 0) return program + inst->body_index;
+    return NULL;
+}
+
+static int optimize_range(Instruction *program, Instruction *insts, int count, OptimizerMode mode) {
+    int out = 0;
+    for (int i = 0; i < count; i++) {
+        Instruction cur = insts[i];
+
+        // loop bodies are optimized on their own, fusion never crosses the loop boundary
+        Instruction *body = cur.type == FOR ? body_of(program, &cur) : NULL;
+        if (body) {
+            cur.sub_instruction_count = optimize_range(program, body, cur.sub_instruction_count, mode);
+        }
+
+        if (out > 0 && cur.type != FOR && fuse(&insts[out - 1], &cur, mode))
+            continue;
+
+        insts[out++] = cur;
+    }
+
+    return out;
+}
+
+// peephole pass over an instruction stream, compacts in place and returns the new count
+int optimize_instructions(Instruction *insts, int count, OptimizerMode mode) {
+    if (mode == OPTIMIZER_OFF || !insts) return count;
+    return optimize_range(insts, insts, count, mode);
+}
+
+void optimize_process(Process *p, Config config) {
+    if (!p || !p->instructions) return;
+    p->num_inst = optimize_instructions(p->instructions, p->num_inst, get_optimizer_mode(config.optimizer));
+}
@@ -1,6 +1,12 @@
 #include "process.h"
 #include "scheduler.h"
 #include "config.h"
+#include "optimizer.h"
+#include "log_stream.h"
+#include "clock.h"
+#include "locks.h"
+#include "backing_store.h"
+#include "random.h"
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
@@ -10,6 +16,14 @@
 // Thread-safe PID counter
 volatile long next_pid = 1;
 
+int allocate_pid(Process *p) {
+    int slot = sched_slot_alloc();
+    if (slot < 0) return -1;
+    p->slot = slot;
+    p->pid = InterlockedIncrement(&next_pid);
+    return p->pid;
+}
+
 // retain in uint16 bounds (0 to 65535)
 #define CLAMP_UINT16(x) ((x) > 65535 ? 65535 : ((x) < 0 ? 0 : (x)))
 
@@ -50,15 +64,17 @@ Variable *get_variable(Process *p, const char *name) {
             return NULL;
         }
         int new_cap = p->variables_capacity * 2;
-        Variable *new_vars = malloc(new_cap * sizeof(Variable));  // Use malloc instead of realloc
+        // grow inside the process arena while it has room, the heap otherwise
+        Variable *new_vars = arena_alloc(&p->arena, new_cap * sizeof(Variable));
+        if (!new_vars) new_vars = malloc(new_cap * sizeof(Variable));
         if (!new_vars) {
             printf("[ERROR] Failed to allocate new variables array for process %d!\n", p->pid);
             return NULL;
         }
-        // Copy old data and free old array
+        // Copy old data and free old array, unless it lives in the process arena
         memcpy(new_vars, p->variables, p->variables_capacity * sizeof(Variable));
         memset(new_vars + p->variables_capacity, 0, (new_cap - p->variables_capacity) * sizeof(Variable));
-        free(p->variables);
+        if (!arena_owns(&p->arena, p->variables)) free(p->variables);
         p->variables = new_vars;
         p->variables_capacity = new_cap;
         // Debug message removed for cleaner output
@@ -75,45 +91,96 @@ uint16_t resolve_value(Process *p, const char *arg, uint16_t fallback) {
     return v ? v->value : fallback;
 }
 
-void execute_instruction(Process *p, Config config) {
+// append a PRINT record to the log stream and the process log ring, overwriting the oldest when full
+static void log_print(Process *p, Instruction *inst, Config config) {
+    Variable *v = get_variable(p, inst->arg1);
+
+    Log log;
+    log.pid = p->pid;
+    log.var_slot = v ? (int)(v - p->variables) : -1;
+    log.value = v ? v->value : 0;
+    log.core = PROC_CORE(p);
+    log.tick = CPU_TICKS;
+    log.last_exec_time = clock_wall_time();
+    log_stream_push(PROC_CORE(p), &log);
+
+    if (!p->logs) {
+        if (config.log_ring_size <= 0) return;
+        p->logs = malloc(sizeof(Log) * config.log_ring_size);
+        if (!p->logs) return;
+        p->log_capacity = config.log_ring_size;
+        p->log_head = 0;
+        p->num_logs = 0;
+    }
+
+    if (p->num_logs < p->log_capacity) {
+        p->logs[(p->log_head + p->num_logs) % p->log_capacity] = log;
+        p->num_logs++;
+    } else {
+        p->logs[p->log_head] = log;
+        p->log_head = (p->log_head + 1) % p->log_capacity;
+    }
+}
+
+// index 0 is the oldest log still in the ring
+const Log *get_log(Process *p, int index) {
+    if (!p->logs || index < 0 || index >= p->num_logs) return NULL;
+    return &p->logs[(p->log_head + index) % p->log_capacity];
+}
+
+// build the PRINT message for a log record
+void format_log(Process *p, const Log *log, char *buf, size_t size) {
+    if (log->var_slot >= 0 && p->variables && log->var_slot < p->num_var) {
+        snprintf(buf, size, "Hello world from %s! Value of %s = %u", p->name, p->variables[log->var_slot].name, log->value);
+    } else if (log->var_slot >= 0) {
+        snprintf(buf, size, "Hello world from %s! Value = %u", p->name, log->value);
+    } else {
+        snprintf(buf, size, "Hello world from %s!", p->name);
+    }
+}
+
+// executes one instruction, returns the number of ticks it costs
+int execute_instruction(Process *p, Config config) {
     // Add validation checks
     if (!p) {
         printf("[ERROR] Null process pointer in execute_instruction\n");
-        return;
+        return 1;
     }
 
     // Validate process structure
-    if (p->program_counter < 0 || !p->instructions || !p->variables) {
+    if (PROC_PC(p) < 0 || !p->instructions || !p->variables) {
         printf("[ERROR] Invalid process state: PC=%d, instructions=%p, variables=%p\n",
-               p->program_counter, (void*)p->instructions, (void*)p->variables);
-        return;
+               PROC_PC(p), (void*)p->instructions, (void*)p->variables);
+        return 1;
     }
 
     //guard for out of bounds with better logging
-    if (p->program_counter >= p->num_inst) {
+    if (PROC_PC(p) >= p->num_inst) {
         printf("[DEBUG] Process %s reached end: PC=%d, num_inst=%d\n",
-               p->name, p->program_counter, p->num_inst);
-        return;
+               p->name, PROC_PC(p), p->num_inst);
+        return 1;
     }
 
-    Instruction *inst = &p->instructions[p->program_counter];
+    Instruction *inst = &p->instructions[PROC_PC(p)];
     // if inside a for loop
     if (p->for_depth > 0) {
         ForContext *ctx = &p->for_stack[p->for_depth - 1];
         if (ctx->current_index < ctx->sub_instruction_count) {
-            inst = &ctx->sub_instructions[ctx->current_index];
+            inst = &p->instructions[ctx->body_index + ctx->current_index];
         } else if (ctx->remaining > 0) {
             ctx->remaining--;
             ctx->current_index = 0;
-            inst = &ctx->sub_instructions[ctx->current_index];
+            inst = &p->instructions[ctx->body_index + ctx->current_index];
         } else {
             // when the loop is done, pop from stack
             p->for_depth--;
-            p->program_counter++;
-            return;
+            PROC_PC(p)++;
+            return 1;
         }
     }
 
+    int cost = inst->cost ? inst->cost : 1;
+
     switch (inst->type) {
         // declare
        case DECLARE: {
@@ -145,62 +212,63 @@ void execute_instruction(Process *p, Config config) {
         }
         // print
         case PRINT: {
-            // Clear logs if buffer is full
-            if (p->num_logs >= 100) {
-                memset(p->logs, 0, sizeof(Log) * 100);
-                p->num_logs = 0;
-            }
+            log_print(p, inst, config);
+            break;
+        }
 
+        // fused DECLARE + ADD/SUBTRACT on the same variable
+        case DECLARE_ADD:
+        case DECLARE_SUBTRACT: {
             Variable *v = get_variable(p, inst->arg1);
-            if (v) {
-                char logMessage[256];
-                snprintf(logMessage, sizeof(logMessage), "Hello world from %s! Value of %s = %u\n", p->name, v->name, v->value);
-                strncpy(p->logs[p->num_logs].message, logMessage, sizeof(p->logs[p->num_logs].message) - 1);
-                p->logs[p->num_logs].message[sizeof(p->logs[p->num_logs].message) - 1] = '\0';
-            } else {
-                char logMessage[256];
-                snprintf(logMessage, sizeof(logMessage), "Hello world from %s!\n", p->name);
-                strncpy(p->logs[p->num_logs].message, logMessage, sizeof(p->logs[p->num_logs].message) - 1);
-                p->logs[p->num_logs].message[sizeof(p->logs[p->num_logs].message) - 1] = '\0';
+            if (v) v->value = CLAMP_UINT16(inst->value);
+            uint16_t v2 = resolve_value(p, inst->arg2, 0);
+            uint16_t v3 = resolve_value(p, inst->arg3, 0);
+            Variable *dest = get_variable(p, inst->arg1);
+            if (dest) {
+                dest->value = inst->type == DECLARE_ADD ? CLAMP_UINT16(v2 + v3) : CLAMP_UINT16(v2 - v3);
             }
+            break;
+        }
 
-            p->logs[p->num_logs].last_exec_time = time(NULL);
-            p->logs[p->num_logs].core = p->core;
-            p->num_logs++;
-
+        // consecutive PRINTs of the same variable
+        case PRINT_REPEAT: {
+            for (int i = 0; i < inst->repeat_count; i++)
+                log_print(p, inst, config);
             break;
         }
-        
+
         // for
         case FOR: {
             if (p->for_depth >= MAX_LOOP_DEPTH) {
                 printf("[ERROR] Maximum loop depth exceeded in process %d\n", p->pid);
-                p->program_counter++;
+                PROC_PC(p)++;
                 break;
             }
             ForContext *ctx = &p->for_stack[p->for_depth++];
             ctx->repeat_count = inst->repeat_count;
             ctx->remaining = inst->repeat_count - 1;
             ctx->current_index = 0;
-            ctx->sub_instructions = inst->sub_instructions;
-            ctx->sub_instruction_count = inst->sub_instruction_count;
+            ctx->body_index = inst->body_index;
+            // programs read back from the backing store are not scanned, a body pointing outside of it runs as an empty loop
+            ctx->sub_instruction_count = for_body_valid(p, inst->body_index, inst->sub_instruction_count)
+                                       ? inst->sub_instruction_count : 0;
             
             // Execute first instruction of the loop immediately
             if (ctx->sub_instruction_count > 0) {
-                inst = &ctx->sub_instructions[ctx->current_index];
-                execute_instruction(p, config);
+                inst = &p->instructions[ctx->body_index + ctx->current_index];
+                cost = execute_instruction(p, config);
             } else {
                 // Empty loop body, just increment program counter
                 p->for_depth--;
-                p->program_counter++;
+                PROC_PC(p)++;
             }
             break;
         }
         // sleep
         case SLEEP: {
             // sleep for x ticks
-            p->state = SLEEPING;
-            p->sleep_until_tick = CPU_TICKS + inst->value;
+            PROC_STATE(p) = SLEEPING;
+            PROC_SLEEP_UNTIL(p) = CPU_TICKS + inst->value;
             break;
         }
 
@@ -211,6 +279,7 @@ void execute_instruction(Process *p, Config config) {
                 // Get the memory address from arg2 (could be variable or literal)
                 uint16_t addr = resolve_value(p, inst->arg2, 0);
                 // Read value from memory at addr (assuming 0 if not initialized)
+                reference_page(p, addr);
                 dest->value = read_from_memory(p, addr);
             }
             break;
@@ -221,6 +290,7 @@ void execute_instruction(Process *p, Config config) {
             // Get the memory address from arg1 (could be variable or literal)
             uint16_t addr = resolve_value(p, inst->arg1, 0);
             // Write value directly to memory at addr
+            reference_page(p, addr);
             write_to_memory(p, addr, inst->value);
             break;
         }
@@ -248,72 +318,308 @@ void execute_instruction(Process *p, Config config) {
     }
 
     // Record the time of this instruction execution
-    if (p->state != SLEEPING)
-        p->last_exec_time = time(NULL);
+    if (PROC_STATE(p) != SLEEPING) {
+        p->last_exec_time = clock_wall_time();
+        p->last_exec_tick = CPU_TICKS;
+    }
 
     // if in for loop, move index in for loop
     if (p->for_depth > 0) {
         p->for_stack[p->for_depth - 1].current_index++;
     } else {
-        p->program_counter++;
+        PROC_PC(p)++;
     }
 
-    return;
+    return cost;
 }
 
 Process **process_table = NULL;
 uint32_t num_processes = 0;
 uint32_t process_table_size = 0;
 
+bool for_body_valid(const Process *p, int body_index, int count) {
+    if (count <= 0) return count == 0;
+    return body_index >= p->num_inst && body_index <= p->program_size - count;
+}
+
+// carve the arrays of a process out of one arena, FOR bodies go right after the main program
+bool init_process_arena(Process *p, int num_inst, int num_body, int variables_capacity, int num_pages, int log_capacity) {
+    if (log_capacity < 0) log_capacity = 0;
+    size_t size = arena_size_for(sizeof(Instruction) * (num_inst + num_body))
+                + arena_size_for(sizeof(Variable) * variables_capacity)
+                + arena_size_for(sizeof(PageTableEntry) * num_pages)
+                + arena_size_for(sizeof(Log) * log_capacity);
+    if (!arena_init(&p->arena, size)) return false;
+
+    p->instructions = arena_alloc(&p->arena, sizeof(Instruction) * (num_inst + num_body));
+    p->num_inst = num_inst;
+    p->program_size = num_inst + num_body;
+    p->variables = arena_alloc(&p->arena, sizeof(Variable) * variables_capacity);
+    p->variables_capacity = variables_capacity;
+    p->num_var = 0;
+    p->page_table = num_pages > 0 ? arena_alloc(&p->arena, sizeof(PageTableEntry) * num_pages) : NULL;
+    p->num_pages = num_pages;
+    p->logs = log_capacity > 0 ? arena_alloc(&p->arena, sizeof(Log) * log_capacity) : NULL;
+    p->log_capacity = log_capacity;
+    p->log_head = 0;
+    p->num_logs = 0;
+    return true;
+}
+
+// same as init_process_arena, then copies a parsed program (and its FOR bodies) into it
+bool init_process_from_instructions(Process *p, const Instruction *insts, int count, int variables_capacity, int num_pages, int log_capacity) {
+    int num_body = 0;
+    for (int i = 0; i < count; i++) {
+        if (insts[i].type == FOR && insts[i].sub_instructions) num_body += insts[i].sub_instruction_count;
+    }
+
+    if (!init_process_arena(p, count, num_body, variables_capacity, num_pages, log_capacity)) return false;
+
+    Instruction *body = p->instructions + count;
+    for (int i = 0; i < count; i++) {
+        p->instructions[i] = insts[i];
+        if (insts[i].type == FOR && insts[i].sub_instructions) {
+            memcpy(body, insts[i].sub_instructions, sizeof(Instruction) * insts[i].sub_instruction_count);
+            p->instructions[i].sub_instructions = NULL;
+            p->instructions[i].body_index = (int)(body - p->instructions);
+            // only one level of bodies is copied, a FOR nested inside one runs as an empty loop
+            for (int j = 0; j < insts[i].sub_instruction_count; j++) {
+                if (body[j].type == FOR) {
+                    body[j].sub_instructions = NULL;
+                    body[j].sub_instruction_count = 0;
+                }
+            }
+            body += insts[i].sub_instruction_count;
+        } else if (insts[i].type == FOR) {
+            p->instructions[i].sub_instruction_count = 0;
+        }
+    }
+    return true;
+}
+
 // Cleanup all resources associated with a process
 void cleanup_process(Process *p) {
     if (!p) return;
 
     // Free variables array
     if (p->variables) {
-        free(p->variables);
+        if (!arena_owns(&p->arena, p->variables)) free(p->variables);
         p->variables = NULL;
     }
 
     // Free logs array
     if (p->logs) {
-        free(p->logs);
+        if (!arena_owns(&p->arena, p->logs)) free(p->logs);
         p->logs = NULL;
+        p->num_logs = 0;
+        p->log_capacity = 0;
     }
 
     // Free page table
     if (p->page_table) {
-        free(p->page_table);
+        if (!arena_owns(&p->arena, p->page_table)) free(p->page_table);
         p->page_table = NULL;
     }
 
-    // Free instructions and nested FOR instructions
-    if (p->instructions) {
-        // Clean up any FOR loop sub-instructions
-        for (int i = 0; i < p->num_inst; i++) {
-            if (p->instructions[i].type == FOR && p->instructions[i].sub_instructions) {
-                free(p->instructions[i].sub_instructions);
-            }
-        }
-        free(p->instructions);
+    // FOR bodies live in the same block as the main program
+    if (p->program_map) {
+        release_mapped_program(p);
+    } else if (p->instructions) {
+        if (!arena_owns(&p->arena, p->instructions)) free(p->instructions);
         p->instructions = NULL;
     }
 
+    arena_free(&p->arena);
+}
+
+// release a process that is no longer referenced anywhere
+void free_process(Process *p) {
+    if (!p) return;
+    remove_process_from_table(p);
+    cleanup_process(p);
+    sched_slot_release(p->slot);
+    free(p);
+}
+
+// holds only live processes, finished and swapped out ones are removed
+static TimedLock process_table_lock;
+static int process_table_ready = 0;
+
+// arrays replaced by a bigger one, kept so a reader still holding one never sees freed memory
+// doubling keeps their total size below the live array's
+#define MAX_RETIRED_TABLES 32
+static Process **retired_tables[MAX_RETIRED_TABLES];
+static int num_retired_tables = 0;
+
+// open addressing with linear probing, kept at most half full
+typedef struct {
+    uint32_t hash;
+    Process *p;         // NULL marks a free slot
+} IndexEntry;
+
+typedef struct {
+    IndexEntry *entries;
+    uint32_t capacity;  // power of 2
+    uint32_t count;
+} ProcessIndex;
+
+static ProcessIndex pid_index;
+static ProcessIndex name_index;
+
+static uint32_t hash_pid(int pid) {
+    return (uint32_t)pid * 2654435769u;
+}
+
+// fnv-1a
+static uint32_t hash_name(const char *name) {
+    uint32_t h = 2166136261u;
+    while (*name) {
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static bool index_insert(ProcessIndex *idx, uint32_t hash, Process *p) {
+    if ((idx->count + 1) * 2 > idx->capacity) {
+        uint32_t new_cap = idx->capacity == 0 ? 64 : idx->capacity * 2;
+        IndexEntry *entries = calloc(new_cap, sizeof(IndexEntry));
+        if (!entries) return false;
+
+        for (uint32_t i = 0; i < idx->capacity; i++) {
+            IndexEntry e = idx->entries[i];
+            if (!e.p) continue;
+            uint32_t slot = e.hash & (new_cap - 1);
+            while (entries[slot].p) slot = (slot + 1) & (new_cap - 1);
+            entries[slot] = e;
+        }
+        free(idx->entries);
+        idx->entries = entries;
+        idx->capacity = new_cap;
+    }
+
+    uint32_t mask = idx->capacity - 1;
+    uint32_t slot = hash & mask;
+    while (idx->entries[slot].p) slot = (slot + 1) & mask;
+    idx->entries[slot].hash = hash;
+    idx->entries[slot].p = p;
+    idx->count++;
+    return true;
+}
+
+// backward shift deletion, so lookups never need tombstones
+static void index_remove(ProcessIndex *idx, uint32_t hash, Process *p) {
+    if (idx->capacity == 0) return;
+
+    uint32_t mask = idx->capacity - 1;
+    uint32_t slot = hash & mask;
+    while (idx->entries[slot].p && idx->entries[slot].p != p) slot = (slot + 1) & mask;
+    if (!idx->entries[slot].p) return;
+
+    uint32_t hole = slot;
+    for (uint32_t next = (hole + 1) & mask; idx->entries[next].p; next = (next + 1) & mask) {
+        // an entry can fill the hole only if its home slot is not between the hole and itself
+        uint32_t home = idx->entries[next].hash & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            idx->entries[hole] = idx->entries[next];
+            hole = next;
+        }
+    }
+    idx->entries[hole].p = NULL;
+    idx->count--;
+}
+
+void init_process_table() {
+    if (process_table_ready) return;
+    timed_lock_init(&process_table_lock, "process table");
+    process_table_ready = 1;
+}
+
+void lock_process_table() {
+    timed_lock_enter(&process_table_lock);
+}
+
+void unlock_process_table() {
+    timed_lock_leave(&process_table_lock);
 }
 
 void add_process(Process *p) {
+    timed_lock_enter(&process_table_lock);
     if (num_processes >= process_table_size) {
+        // copy into a new array and publish it, the old one stays valid for anyone still reading it
         uint32_t new_size = process_table_size == 0 ? 8 : process_table_size * 2;
-        Process **new_table = realloc(process_table, new_size * sizeof(Process *));
-        if (!new_table) {
+        Process **new_table = calloc(new_size, sizeof(Process *));
+        if (!new_table || num_retired_tables == MAX_RETIRED_TABLES) {
             printf("[ERROR] Failed to grow process table\n");
+            free(new_table);
+            timed_lock_leave(&process_table_lock);
             return;
         }
+        if (process_table) {
+            memcpy(new_table, process_table, num_processes * sizeof(Process *));
+            retired_tables[num_retired_tables++] = process_table;
+        }
+        MemoryBarrier();
         process_table = new_table;
         process_table_size = new_size;
     }
 
+    if (!index_insert(&pid_index, hash_pid(p->pid), p)) {
+        printf("[ERROR] Failed to grow process index\n");
+        timed_lock_leave(&process_table_lock);
+        return;
+    }
+    if (!index_insert(&name_index, hash_name(p->name), p)) {
+        index_remove(&pid_index, hash_pid(p->pid), p);
+        printf("[ERROR] Failed to grow process index\n");
+        timed_lock_leave(&process_table_lock);
+        return;
+    }
+
+    p->table_slot = num_processes;
     process_table[num_processes++] = p;
+    timed_lock_leave(&process_table_lock);
+}
+
+// the last entry moves into the hole so the table stays dense
+void remove_process_from_table(Process *p) {
+    if (!process_table_ready) return;
+
+    timed_lock_enter(&process_table_lock);
+    uint32_t slot = (uint32_t)p->table_slot;
+    // processes that were never added, or were read back from the backing store, fail this check
+    if (slot < num_processes && process_table[slot] == p) {
+        Process *last = process_table[--num_processes];
+        process_table[slot] = last;
+        last->table_slot = slot;
+        process_table[num_processes] = NULL;
+
+        index_remove(&pid_index, hash_pid(p->pid), p);
+        index_remove(&name_index, hash_name(p->name), p);
+    }
+    timed_lock_leave(&process_table_lock);
+}
+
+Process *find_process_by_pid(int pid) {
+    if (pid_index.capacity == 0) return NULL;
+
+    uint32_t mask = pid_index.capacity - 1;
+    for (uint32_t slot = hash_pid(pid) & mask; pid_index.entries[slot].p; slot = (slot + 1) & mask) {
+        if (pid_index.entries[slot].p->pid == pid) return pid_index.entries[slot].p;
+    }
+    return NULL;
+}
+
+Process *find_process_by_name(const char *name) {
+    if (name_index.capacity == 0) return NULL;
+
+    uint32_t hash = hash_name(name);
+    uint32_t mask = name_index.capacity - 1;
+    for (uint32_t slot = hash & mask; name_index.entries[slot].p; slot = (slot + 1) & mask) {
+        IndexEntry *e = &name_index.entries[slot];
+        if (e->hash == hash && strcmp(e->p->name, name) == 0) return e->p;
+    }
+    return NULL;
 }
 
 // trim whitepsace
@@ -534,11 +840,72 @@ int parse_instruction_list(const char *instrs, Instruction *out, int max_count)
     return count;
 }
 
-Process *generate_dummy_process(Config config) {
+// writes "v<idx>" without going through snprintf
+static void write_var_name(char *dst, int idx) {
+    char digits[12];
+    int n = 0;
+    do {
+        digits[n++] = '0' + idx % 10;
+        idx /= 10;
+    } while (idx > 0);
+    *dst++ = 'v';
+    while (n > 0) *dst++ = digits[--n];
+    *dst = '\0';
+}
+
+// fill in a random non-FOR instruction that writes v<i> and reads variables below i
+static void generate_simple_instruction(Instruction *inst, int type, int i, uint64_t *rng) {
+    inst->type = type;
+    switch (type) {
+        case DECLARE:
+            write_var_name(inst->arg1, i);
+            inst->value = random_below(rng, 100);
+            break;
+        case ADD:
+        case SUBTRACT:
+            write_var_name(inst->arg1, i);
+            write_var_name(inst->arg2, random_below(rng, i));
+            if (i > 0 && random_below(rng, 2)) {
+                write_var_name(inst->arg3, random_below(rng, i));
+            } else {
+                inst->value = random_below(rng, 100);
+            }
+            break;
+        case PRINT:
+            write_var_name(inst->arg1, random_below(rng, i));
+            break;
+        case SLEEP:
+            inst->value = 1 + random_below(rng, 10);
+            break;
+    }
+}
+
+// instruction types come from the shape stream so the arena can be sized before anything is written
+static int next_instruction_type(uint64_t *shape, int *body_count) {
+    int t = random_below(shape, 6); // 0=DECLARE, 1=ADD, 2=SUBTRACT, 3=PRINT, 4=SLEEP, 5=FOR
+    static const int types[6] = {DECLARE, ADD, SUBTRACT, PRINT, SLEEP, FOR};
+    *body_count = t == 5 ? 1 + random_below(shape, 3) : 0;
+    return types[t];
+}
+
+// random program emitted straight into the instruction representation, all arrays in one arena
+Process *generate_random_process(Config config, uint64_t *rng) {
     int min_ins = config.min_ins > 1 ? config.min_ins : 1;
     int max_ins = config.max_ins > min_ins ? config.max_ins : min_ins;
-    int num_inst = min_ins + rand() % (max_ins - min_ins + 1);
-    int memory_allocation = config.min_mem_per_proc + rand() % (config.max_mem_per_proc - config.min_mem_per_proc + 1);
+    int num_inst = min_ins + random_below(rng, max_ins - min_ins + 1);
+    int memory_allocation = config.min_mem_per_proc + random_below(rng, config.max_mem_per_proc - config.min_mem_per_proc + 1);
+    int num_pages = config.mem_per_frame > 0 ? memory_allocation / config.mem_per_frame : 0;
+    int variables_capacity = num_inst > 8 ? num_inst : 8;
+
+    // first pass over a copy of the shape stream counts the FOR bodies
+    uint64_t shape_seed = next_random(rng);
+    uint64_t shape = shape_seed;
+    int total_body = 0;
+    for (int i = 0; i < num_inst; i++) {
+        int body_count;
+        next_instruction_type(&shape, &body_count);
+        total_body += body_count;
+    }
 
     Process *p = (Process *)calloc(1, sizeof(Process));
     if (!p) {
@@ -546,108 +913,55 @@ Process *generate_dummy_process(Config config) {
         return NULL;
     }
 
-    // Use thread-safe PID assignment
-    int assigned_pid = ++next_pid;  // Simple increment for now
-    
-    // *** FIX: Proper string initialization ***
-    snprintf(p->name, MAX_PROCESS_NAME - 1, "P%d", assigned_pid);
-    p->name[MAX_PROCESS_NAME - 1] = '\0';  // Ensure null termination
-    
-    p->pid = assigned_pid;
-    p->state = READY;
-    p->program_counter = 0;
-    p->num_var = 0;
-    p->num_inst = num_inst;
-    p->num_logs = 0;
-    p->variables_capacity = 8;
-    p->in_memory = 0;
-    p->for_depth = 0;  // *** FIX: Initialize for_depth ***
-    p->ticks_ran_in_quantum = 0;  // *** FIX: Initialize quantum ticks ***
-    p->last_exec_time = 0;  // *** FIX: Initialize to 0, will be set when scheduled ***
-    p->num_pages = memory_allocation / config.mem_per_frame;
-    p->page_table = (PageTableEntry *)calloc(p->num_pages, sizeof(PageTableEntry));
-
-    p->logs = malloc(sizeof(Log) * 100);  // Support up to 100 logs
-    if (!p->logs) {
-        free(p);
-        return NULL;
-    }
-
-    // *** FIX: Safer memory allocation with error checking ***
-    p->variables = (Variable *)calloc(p->variables_capacity, sizeof(Variable));
-    if (!p->variables) {
-        printf("[ERROR] Failed to allocate variables array!\n");
+    if (!init_process_arena(p, num_inst, total_body, variables_capacity, num_pages, config.log_ring_size)) {
+        printf("[ERROR] Failed to allocate process arena!\n");
         free(p);
         return NULL;
     }
 
-    p->instructions = (Instruction *)calloc(num_inst, sizeof(Instruction));
-    if (!p->instructions) {
-        printf("[ERROR] Failed to allocate instructions array!\n");
-        free(p->variables);
-        free(p);
+    if (allocate_pid(p) < 0) {
+        free_process(p);
         return NULL;
     }
-
+    snprintf(p->name, MAX_PROCESS_NAME, "P%d", p->pid);
+    PROC_STATE(p) = READY;
+    p->arrival_tick = CPU_TICKS;
     p->memory_allocation = memory_allocation;
 
-    // Seed random only once
-    static int seeded = 0;
-    if (!seeded) { 
-        srand((unsigned int)time(NULL)); 
-        seeded = 1; 
-    }
-
-    // Generate random instructions with bounds checking
+    // FOR bodies are laid out right after the main program
+    Instruction *body = p->instructions + num_inst;
+    shape = shape_seed;
     for (int i = 0; i < num_inst; i++) {
-        int t = rand() % 6; // 0=DECLARE, 1=ADD, 2=SUBTRACT, 3=PRINT, 4=SLEEP, 5=FOR
-        char buf[64];
-        
-        // *** FIX: Ensure we don't access invalid indices ***
-        int v2_idx = (i > 0) ? rand() % i : 0;
-        int v3_is_var = rand() % 2;
-        int v3_idx = (i > 0) ? rand() % i : 0;
-        int v3_val = rand() % 100;
-        
-        char v3_buf[16];
-        if (v3_is_var && i > 0) {
-            snprintf(v3_buf, sizeof(v3_buf), "v%d", v3_idx);
-        } else {
-            snprintf(v3_buf, sizeof(v3_buf), "%d", v3_val);
-        }
-
-        // *** FIX: Initialize instruction struct to zero ***
-        memset(&p->instructions[i], 0, sizeof(Instruction));
+        int body_count;
+        int type = next_instruction_type(&shape, &body_count);
+        Instruction *inst = &p->instructions[i];
 
-        switch (t) {
-            case 0: // DECLARE
-                snprintf(buf, sizeof(buf), "v%d,%d", i, rand() % 100);
-                p->instructions[i] = parse_declare(buf);
-                break;
-            case 1: // ADD
-                snprintf(buf, sizeof(buf), "v%d,v%d,%s", i, v2_idx, v3_buf);
-                p->instructions[i] = parse_add_sub(buf, 1);
-                break;
-            case 2: // SUBTRACT
-                snprintf(buf, sizeof(buf), "v%d,v%d,%s", i, v2_idx, v3_buf);
-                p->instructions[i] = parse_add_sub(buf, 0);
-                break;
-            case 3: // PRINT
-                snprintf(buf, sizeof(buf), "+v%d", (i > 0) ? rand() % i : 0);
-                p->instructions[i] = parse_print(buf);
-                break;
-            case 4: // SLEEP
-                snprintf(buf, sizeof(buf), "%d", 1 + rand() % 10);
-                p->instructions[i] = parse_sleep(buf);
-                break;
-            case 5: // FOR
-                snprintf(buf, sizeof(buf), "[v%d,v%d];%d", i, v2_idx, 1 + rand() % 5);
-                p->instructions[i] = parse_for(buf);
+        if (type == FOR) {
+            inst->type = FOR;
+            inst->repeat_count = 1 + random_below(rng, 5);
+            inst->sub_instructions = NULL;
+            inst->body_index = (int)(body - p->instructions);
+            inst->sub_instruction_count = body_count;
+            for (int j = 0; j < body_count; j++)
+                generate_simple_instruction(&body[j], random_below(rng, 4), i, rng); // DECLARE, ADD, SUBTRACT or PRINT
+            body += body_count;
+        } else {
+            generate_simple_instruction(inst, type, i, rng);
         }
     }
 
+    optimize_process(p, config);
+
     return p;
 }
+
+Process *generate_dummy_process(Config config) {
+    // only the scheduler thread uses this state
+    static uint64_t rng = 0;
+    if (!rng) rng = seed_random_state(1);
+    return generate_random_process(config, &rng);
+}
+
 // for debugging
 void print_process_info(Process *p) {
     printf("Process PID: %d\n", p->pid);
@@ -680,6 +994,15 @@ void print_process_info(Process *p) {
             case WRITE:
                 printf("  %2d: WRITE(%s, %d)\n", i, inst->arg1, inst->value);
                 break;
+            case DECLARE_ADD:
+                printf("  %2d: DECLARE_ADD(%s, %d, %s, %s)\n", i, inst->arg1, inst->value, inst->arg2, inst->arg3);
+                break;
+            case DECLARE_SUBTRACT:
+                printf("  %2d: DECLARE_SUBTRACT(%s, %d, %s, %s)\n", i, inst->arg1, inst->value, inst->arg2, inst->arg3);
+                break;
+            case PRINT_REPEAT:
+                printf("  %2d: PRINT(%s) x%d\n", i, inst->arg1, inst->repeat_count);
+                break;
             default:
                 printf("  %2d: UNKNOWN\n", i);
         }
@@ -0,0 +1,470 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "process_image.h"
+#include "sched_table.h"
+
+#define MAX_IMAGE_COUNT 1000000
+#define MAX_IMAGE_LOG_CAPACITY 65536
+#define MIN_INSTRUCTION_BYTES 7         // type, three empty args, value, repeat and cost
+
+typedef struct {
+    unsigned char *pos;
+} Writer;
+
+typedef struct {
+    const unsigned char *pos;
+    const unsigned char *end;
+    bool ok;
+} Reader;
+
+static void put_byte(Writer *w, unsigned char b) {
+    *w->pos++ = b;
+}
+
+static void put_uint(Writer *w, uint64_t v) {
+    while (v >= 0x80) {
+        put_byte(w, (unsigned char)(v | 0x80));
+        v >>= 7;
+    }
+    put_byte(w, (unsigned char)v);
+}
+
+static void put_int(Writer *w, int64_t v) {
+    put_uint(w, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+// the arguments are a few characters at most, a plain loop beats the library calls
+static void put_string(Writer *w, const char *s, size_t size) {
+    size_t n = 0;
+    while (n < size - 1 && s[n]) n++;
+    put_uint(w, n);
+    for (size_t i = 0; i < n; i++) w->pos[i] = (unsigned char)s[i];
+    w->pos += n;
+}
+
+static void put_u32(char *at, uint32_t v) {
+    for (int i = 0; i < 4; i++) at[i] = (char)(v >> (8 * i));
+}
+
+static uint32_t get_u32(const char *at) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) v |= (uint32_t)(unsigned char)at[i] << (8 * i);
+    return v;
+}
+
+// FNV-1a over 8-byte words, a byte at a time it was most of the cost of packing a large program
+// the words are loaded in host order, every Windows target is little endian like the rest of the format
+static uint32_t checksum(const char *buf, size_t len) {
+    uint64_t h = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, buf + i, sizeof(word));
+        h ^= word;
+        h *= 1099511628211ull;
+    }
+    for (; i < len; i++) {
+        h ^= (unsigned char)buf[i];
+        h *= 1099511628211ull;
+    }
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+static size_t remaining(const Reader *r) {
+    return (size_t)(r->end - r->pos);
+}
+
+static unsigned char get_byte(Reader *r) {
+    if (!r->ok || r->pos >= r->end) {
+        r->ok = false;
+        return 0;
+    }
+    return *r->pos++;
+}
+
+static uint64_t get_uint(Reader *r) {
+    // most values are a single byte
+    if (r->ok && r->pos < r->end && *r->pos < 0x80) return *r->pos++;
+
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        unsigned char b = get_byte(r);
+        if (!r->ok) return 0;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return v;
+    }
+    r->ok = false;
+    return 0;
+}
+
+static int64_t get_int(Reader *r) {
+    uint64_t u = get_uint(r);
+    return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+}
+
+// a value that has to fit in [lo, hi], anything else fails the whole read
+static int64_t get_ranged(Reader *r, int64_t lo, int64_t hi) {
+    int64_t v = get_int(r);
+    if (v < lo || v > hi) r->ok = false;
+    return r->ok ? v : lo;
+}
+
+static uint64_t get_uranged(Reader *r, uint64_t hi) {
+    uint64_t v = get_uint(r);
+    if (v > hi) r->ok = false;
+    return r->ok ? v : 0;
+}
+
+static void get_string(Reader *r, char *out, size_t size) {
+    uint64_t n = get_uint(r);
+    if (!r->ok || n >= size || n > remaining(r)) {
+        r->ok = false;
+        out[0] = '\0';
+        return;
+    }
+    memcpy(out, r->pos, n);
+    out[n] = '\0';
+    r->pos += n;
+}
+
+int process_program_size(const Process *p) {
+    if (p->num_inst <= 0 || !p->instructions) return 0;
+    return p->program_size > p->num_inst ? p->program_size : p->num_inst;
+}
+
+static void put_instruction(Writer *w, const Instruction *inst) {
+    put_byte(w, (unsigned char)inst->type);
+    put_string(w, inst->arg1, sizeof(inst->arg1));
+    put_string(w, inst->arg2, sizeof(inst->arg2));
+    put_string(w, inst->arg3, sizeof(inst->arg3));
+    put_uint(w, inst->value);
+    put_byte(w, inst->repeat_count);
+    put_byte(w, inst->cost);
+    if (inst->type == FOR) {
+        put_uint(w, inst->sub_instruction_count > 0 ? inst->sub_instruction_count : 0);
+        put_uint(w, inst->sub_instruction_count > 0 ? inst->body_index : 0);
+    }
+}
+
+static void encode(const Process *p, int flags, Writer *w) {
+    int program_size = process_program_size(p);
+    int num_inst = program_size > 0 ? p->num_inst : 0;
+    int num_var = p->variables && p->num_var > 0 ? p->num_var : 0;
+    int num_pages = p->page_table && p->num_pages > 0 ? p->num_pages : 0;
+    int num_logs = p->logs && p->num_logs > 0 ? p->num_logs : 0;
+    int for_depth = p->for_depth > 0 ? p->for_depth : 0;
+
+    // counts first, so a reader knows the sizes before any array
+    put_uint(w, p->pid);
+    put_string(w, p->name, sizeof(p->name));
+    put_uint(w, num_inst);
+    put_uint(w, program_size);
+    put_uint(w, num_var);
+    put_uint(w, p->variables_capacity > 0 ? p->variables_capacity : 0);
+    put_uint(w, for_depth);
+    put_uint(w, num_pages);
+    put_uint(w, num_logs > 0 ? p->log_capacity : 0);
+    put_uint(w, num_logs);
+
+    // scalar state, the program counter and sleep tick live in the scheduling table
+    put_int(w, PROC_PC(p));
+    put_uint(w, PROC_SLEEP_UNTIL(p));
+    put_uint(w, p->arrival_tick);
+    put_uint(w, p->last_swap_in_tick);
+    put_uint(w, p->times_evicted > 0 ? p->times_evicted : 0);
+    put_uint(w, p->last_exec_tick);
+    put_int(w, (int64_t)p->last_exec_time);
+    put_uint(w, p->memory_allocation);
+    put_uint(w, p->mem_base);
+    put_uint(w, p->mem_limit);
+    put_int(w, p->start);
+    put_int(w, p->end);
+    put_byte(w, p->is_in_screen ? 1 : 0);
+
+    if (!(flags & PROCESS_IMAGE_NO_PROGRAM)) {
+        for (int i = 0; i < program_size; i++)
+            put_instruction(w, &p->instructions[i]);
+    }
+
+    for (int i = 0; i < num_var; i++) {
+        put_string(w, p->variables[i].name, sizeof(p->variables[i].name));
+        put_uint(w, p->variables[i].value);
+    }
+
+    for (int i = 0; i < for_depth; i++) {
+        const ForContext *ctx = &p->for_stack[i];
+        put_int(w, ctx->repeat_count);
+        put_int(w, ctx->remaining);
+        put_int(w, ctx->current_index);
+        put_int(w, ctx->body_index);
+        put_int(w, ctx->sub_instruction_count);
+    }
+
+    for (int i = 0; i < num_pages; i++) {
+        put_int(w, p->page_table[i].frame_number);
+        put_byte(w, p->page_table[i].valid ? 1 : 0);
+    }
+
+    // oldest first, the ring comes back with its head at 0
+    for (int i = 0; i < num_logs; i++) {
+        const Log *log = &p->logs[(p->log_head + i) % p->log_capacity];
+        put_int(w, log->var_slot);
+        put_uint(w, log->value);
+        put_int(w, log->core);
+        put_uint(w, log->tick);
+        put_int(w, (int64_t)log->last_exec_time);
+    }
+}
+
+
+// what each field can take at most, LEB128 needs 10 bytes for 64 bits and 5 for 32
+#define MAX_VARINT_BYTES 10
+#define MAX_SCALAR_BYTES (22 * MAX_VARINT_BYTES + 1)
+#define MAX_INSTRUCTION_BYTES (1 + 3 * (5 + sizeof(((Instruction *)0)->arg1)) + 3 + 2 + 2 * 5)
+#define MAX_VARIABLE_BYTES (5 + sizeof(((Variable *)0)->name) + 3)
+#define MAX_FOR_BYTES (5 * 5)
+#define MAX_PAGE_BYTES (5 + 1)
+#define MAX_LOG_BYTES (5 + 3 + 5 + 2 * MAX_VARINT_BYTES)
+
+size_t process_image_bound(const Process *p, int flags) {
+    size_t bound = PROCESS_IMAGE_HEADER_SIZE + MAX_SCALAR_BYTES + 5 + sizeof(p->name);
+    if (!(flags & PROCESS_IMAGE_NO_PROGRAM))
+        bound += (size_t)process_program_size(p) * MAX_INSTRUCTION_BYTES;
+    if (p->variables && p->num_var > 0) bound += (size_t)p->num_var * MAX_VARIABLE_BYTES;
+    if (p->for_depth > 0) bound += (size_t)p->for_depth * MAX_FOR_BYTES;
+    if (p->page_table && p->num_pages > 0) bound += (size_t)p->num_pages * MAX_PAGE_BYTES;
+    if (p->logs && p->num_logs > 0) bound += (size_t)p->num_logs * MAX_LOG_BYTES;
+    return bound;
+}
+
+size_t process_image_pack(const Process *p, int flags, char *buf) {
+    char *body = buf + PROCESS_IMAGE_HEADER_SIZE;
+    Writer w = {(unsigned char *)body};
+    encode(p, flags, &w);
+    size_t len = (size_t)((char *)w.pos - body);
+
+    put_u32(buf, PROCESS_IMAGE_MAGIC);
+    buf[4] = PROCESS_IMAGE_VERSION & 0xff;
+    buf[5] = PROCESS_IMAGE_VERSION >> 8;
+    buf[6] = (char)(flags & 0xff);
+    buf[7] = (char)((flags >> 8) & 0xff);
+    put_u32(buf + 8, (uint32_t)len);
+    put_u32(buf + 12, checksum(body, len));
+    return PROCESS_IMAGE_HEADER_SIZE + len;
+}
+
+// only for reporting, packs into a throwaway buffer
+size_t process_image_size(const Process *p, int flags) {
+    char *buf = malloc(process_image_bound(p, flags));
+    if (!buf) return 0;
+    size_t size = process_image_pack(p, flags, buf);
+    free(buf);
+    return size;
+}
+
+size_t process_image_length(const char *header) {
+    if (get_u32(header) != PROCESS_IMAGE_MAGIC) return 0;
+    return PROCESS_IMAGE_HEADER_SIZE + get_u32(header + 8);
+}
+
+void process_image_seal(char *buf, size_t len) {
+    size_t total = process_image_length(buf);
+    if (total == 0 || total > len) return;
+    put_u32(buf + 12, checksum(buf + PROCESS_IMAGE_HEADER_SIZE, total - PROCESS_IMAGE_HEADER_SIZE));
+}
+
+// checks the header and sets up a reader over the body, returns the flags or -1
+static int open_image(const char *buf, size_t len, Reader *r) {
+    if (len < PROCESS_IMAGE_HEADER_SIZE) return -1;
+    size_t total = process_image_length(buf);
+    if (total == 0 || total > len) return -1;
+
+    int version = (unsigned char)buf[4] | (unsigned char)buf[5] << 8;
+    int flags = (unsigned char)buf[6] | (unsigned char)buf[7] << 8;
+    if (version != PROCESS_IMAGE_VERSION || (flags & ~PROCESS_IMAGE_NO_PROGRAM)) return -1;
+
+    const char *body = buf + PROCESS_IMAGE_HEADER_SIZE;
+    size_t body_len = total - PROCESS_IMAGE_HEADER_SIZE;
+    if (get_u32(buf + 12) != checksum(body, body_len)) return -1;
+
+    r->pos = (const unsigned char *)body;
+    r->end = r->pos + body_len;
+    r->ok = true;
+    return flags;
+}
+
+// inst is fresh arena memory, already zeroed, only the fields in the image are written
+static bool get_instruction(Reader *r, Instruction *inst) {
+    inst->type = (InstructionType)get_byte(r);
+    if (inst->type > PRINT_REPEAT) return false;
+    get_string(r, inst->arg1, sizeof(inst->arg1));
+    get_string(r, inst->arg2, sizeof(inst->arg2));
+    get_string(r, inst->arg3, sizeof(inst->arg3));
+    inst->value = (uint16_t)get_uranged(r, UINT16_MAX);
+    inst->repeat_count = get_byte(r);
+    inst->cost = get_byte(r);
+    if (inst->type == FOR) {
+        inst->sub_instruction_count = (int)get_uranged(r, MAX_IMAGE_COUNT);
+        inst->body_index = (int)get_uranged(r, MAX_IMAGE_COUNT);
+    }
+    return r->ok;
+}
+
+// external is set for a PROCESS_IMAGE_NO_PROGRAM image, its program is run in place if map is set and copied if not
+static Process *decode(const char *buf, size_t len, bool external, Instruction *program, int program_size_given, bool map) {
+    Reader r;
+    int flags = open_image(buf, len, &r);
+    if (flags < 0) return NULL;
+    if (external != ((flags & PROCESS_IMAGE_NO_PROGRAM) != 0)) return NULL;
+
+    Process hdr;
+    memset(&hdr, 0, sizeof(hdr));
+
+    // the scheduling table only has slots for pids handed out by this run
+    hdr.pid = (int)get_uranged(&r, next_pid);
+    get_string(&r, hdr.name, sizeof(hdr.name));
+    int num_inst = (int)get_uranged(&r, MAX_IMAGE_COUNT);
+    int program_size = (int)get_uranged(&r, MAX_IMAGE_COUNT);
+    int num_var = (int)get_uranged(&r, MAX_IMAGE_COUNT);
+    int capacity = (int)get_uranged(&r, MAX_IMAGE_COUNT);
+    int for_depth = (int)get_uranged(&r, MAX_LOOP_DEPTH);
+    int num_pages = (int)get_uranged(&r, MAX_IMAGE_COUNT);
+    int log_capacity = (int)get_uranged(&r, MAX_IMAGE_LOG_CAPACITY);
+    int num_logs = (int)get_uranged(&r, log_capacity);
+    if (!r.ok || hdr.pid == 0 || program_size < num_inst || (program_size > 0 && num_inst == 0)) return NULL;
+
+    // every array below has to be backed by bytes that are actually there, so a bad count can't allocate much
+    if (external ? program_size != program_size_given
+                 : (uint64_t)program_size * MIN_INSTRUCTION_BYTES > remaining(&r))
+        return NULL;
+    if ((uint64_t)num_var * 2 + (uint64_t)num_pages * 2 + (uint64_t)num_logs * 5 > remaining(&r))
+        return NULL;
+
+    int32_t pc = (int32_t)get_ranged(&r, 0, num_inst);
+    uint64_t sleep_until = get_uint(&r);
+    hdr.arrival_tick = get_uint(&r);
+    hdr.last_swap_in_tick = get_uint(&r);
+    hdr.times_evicted = (int)get_uranged(&r, INT32_MAX);
+    hdr.last_exec_tick = get_uint(&r);
+    hdr.last_exec_time = (time_t)get_int(&r);
+    hdr.memory_allocation = get_uint(&r);
+    hdr.mem_base = get_uint(&r);
+    hdr.mem_limit = get_uint(&r);
+    hdr.start = (int)get_ranged(&r, INT32_MIN, INT32_MAX);
+    hdr.end = (int)get_ranged(&r, INT32_MIN, INT32_MAX);
+    hdr.is_in_screen = get_byte(&r) != 0;
+    if (!r.ok) return NULL;
+
+    // room for the variables the process had, growing past that goes to the heap as before
+    int limit = 2 * num_var > program_size ? 2 * num_var : program_size;
+    if (capacity > limit) capacity = limit;
+    if (capacity < num_var) capacity = num_var;
+    if (capacity < 8) capacity = 8;
+
+    Process *p = malloc(sizeof(Process));
+    if (!p) return NULL;
+    *p = hdr;
+    // the slot it had was given back when it was swapped out
+    p->slot = sched_slot_alloc();
+    if (p->slot < 0) {
+        free(p);
+        return NULL;
+    }
+    int arena_inst = map ? 0 : num_inst;
+    int arena_body = map ? 0 : program_size - num_inst;
+    if (!init_process_arena(p, arena_inst, arena_body, capacity, num_pages, num_logs > 0 ? log_capacity : 0)) {
+        sched_slot_release(p->slot);
+        free(p);
+        return NULL;
+    }
+    p->num_inst = num_inst;
+    p->program_size = program_size;
+    if (map) p->instructions = program;
+
+    // a mapped program is not scanned, that would touch every page, its FOR bodies are checked as they start
+    if (!map) {
+        for (int i = 0; r.ok && i < program_size; i++) {
+            Instruction *inst = &p->instructions[i];
+            if (external) {
+                *inst = program[i];
+                inst->sub_instructions = NULL;
+            } else if (!get_instruction(&r, inst)) {
+                r.ok = false;
+            }
+            if (inst->type == FOR && !for_body_valid(p, inst->body_index, inst->sub_instruction_count))
+                r.ok = false;
+        }
+    }
+
+    for (int i = 0; r.ok && i < num_var; i++) {
+        get_string(&r, p->variables[i].name, sizeof(p->variables[i].name));
+        p->variables[i].value = (uint16_t)get_uranged(&r, UINT16_MAX);
+    }
+    p->num_var = num_var;
+
+    for (int i = 0; r.ok && i < for_depth; i++) {
+        ForContext *ctx = &p->for_stack[i];
+        ctx->repeat_count = (int)get_ranged(&r, 0, UINT8_MAX);
+        ctx->remaining = (int)get_ranged(&r, -1, UINT8_MAX);     // a FOR with a repeat count of 0 starts at -1
+        ctx->current_index = (int)get_ranged(&r, 0, MAX_IMAGE_COUNT);
+        ctx->body_index = (int)get_ranged(&r, 0, MAX_IMAGE_COUNT);
+        ctx->sub_instruction_count = (int)get_ranged(&r, 0, MAX_IMAGE_COUNT);
+        // current_index may run past the body, the executor only reads the body while it is inside it
+        if (r.ok && !for_body_valid(p, ctx->body_index, ctx->sub_instruction_count))
+            r.ok = false;
+    }
+    p->for_depth = for_depth;
+
+    for (int i = 0; r.ok && i < num_pages; i++) {
+        p->page_table[i].frame_number = (int)get_ranged(&r, INT32_MIN, INT32_MAX);
+        p->page_table[i].valid = get_byte(&r) != 0;
+    }
+
+    for (int i = 0; r.ok && i < num_logs; i++) {
+        Log *log = &p->logs[i];
+        log->pid = p->pid;
+        log->var_slot = (int)get_ranged(&r, -1, num_var - 1);
+        log->value = (uint16_t)get_uranged(&r, UINT16_MAX);
+        log->core = (int)get_ranged(&r, INT16_MIN, INT16_MAX);
+        log->tick = get_uint(&r);
+        log->last_exec_time = (time_t)get_int(&r);
+    }
+    p->num_logs = num_logs;
+
+    // trailing bytes mean the counts and the contents disagree
+    if (!r.ok || r.pos != r.end) {
+        if (map) p->instructions = NULL;
+        free_process(p);
+        return NULL;
+    }
+
+    // its bytes in memory_space are not part of the image, they are dropped on swap out and the block it gets on
+    // swap in is zeroed, so its reads start from zero like a new process
+    p->in_memory = 0;
+    p->program_map = 0;
+    p->program_offset = 0;
+    PROC_PC(p) = pc;
+    PROC_SLEEP_UNTIL(p) = sleep_until;
+    PROC_QUANTUM(p) = 0;
+    return p;
+}
+
+Process *process_image_unpack(const char *buf, size_t len) {
+    return decode(buf, len, false, NULL, 0, false);
+}
+
+Process *process_image_unpack_with_program(const char *buf, size_t len, const Instruction *program, int program_size) {
+    if (!program && program_size > 0) return NULL;
+    return decode(buf, len, true, (Instruction *)program, program_size, false);
+}
+
+Process *process_image_attach(const char *buf, size_t len, Instruction *program, int program_size,
+                              int program_map, uint64_t program_offset) {
+    if (!program || !program_map) return NULL;
+    Process *p = decode(buf, len, true, program, program_size, true);
+    if (!p) return NULL;
+    p->program_map = program_map;
+    p->program_offset = program_offset;
+    return p;
+}
@@ -0,0 +1,25 @@
+#include <time.h>
+#include "random.h"
+
+uint64_t seed_random_state(uint64_t salt) {
+    uint64_t state = ((uint64_t)time(NULL) << 20) ^ (salt * 0x9E3779B97F4A7C15ULL);
+    return state ? state : 0x9E3779B97F4A7C15ULL;
+}
+
+uint64_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+int random_below(uint64_t *state, int n) {
+    return n > 0 ? (int)((next_random(state) >> 32) % (uint64_t)n) : 0;
+}
+
+uint32_t random_priority(uint64_t *state) {
+    // the high half is the better mixed one
+    return (uint32_t)(next_random(state) >> 32);
+}
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <windows.h>
+#include "sched_table.h"
+
+SchedChunk *sched_chunks[SCHED_MAX_CHUNKS];
+static CRITICAL_SECTION sched_table_cs;
+static int sched_table_ready = 0;
+
+// a free slot's program_counter holds the next free slot, 0 ends the list
+static int free_slots = 0;
+static int next_unused_slot = 1;
+
+static bool reserve_chunk(int chunk) {
+    if (sched_chunks[chunk]) return true;
+    SchedChunk *c = _aligned_malloc(sizeof(SchedChunk), 64);
+    if (!c) {
+        printf("[ERROR] Failed to allocate scheduling table\n");
+        return false;
+    }
+    memset(c, 0, sizeof(SchedChunk));
+    sched_chunks[chunk] = c;
+    return true;
+}
+
+void init_sched_table() {
+    if (sched_table_ready) return;
+    InitializeCriticalSection(&sched_table_cs);
+    // slot 0 always exists for processes that have none
+    reserve_chunk(0);
+    sched_table_ready = 1;
+}
+
+int sched_slot_alloc() {
+    // processes are created and freed on several threads
+    EnterCriticalSection(&sched_table_cs);
+    int slot = free_slots;
+    if (slot) {
+        free_slots = SCHED_FIELD(slot, program_counter);
+    } else if ((next_unused_slot >> SCHED_CHUNK_BITS) >= SCHED_MAX_CHUNKS) {
+        printf("[ERROR] The scheduling table is full\n");
+        slot = -1;
+    } else if (reserve_chunk(next_unused_slot >> SCHED_CHUNK_BITS)) {
+        slot = next_unused_slot++;
+    } else {
+        slot = -1;
+    }
+    LeaveCriticalSection(&sched_table_cs);
+    if (slot < 0) return -1;
+
+    int idx = slot & (SCHED_CHUNK_SIZE - 1);
+    SchedChunk *c = sched_chunks[slot >> SCHED_CHUNK_BITS];
+    c->sleep_until_tick[idx] = 0;
+    c->program_counter[idx] = 0;
+    c->ticks_ran_in_quantum[idx] = 0;
+    c->core[idx] = 0;
+    c->state[idx] = 0;
+    return slot;
+}
+
+void sched_slot_release(int slot) {
+    if (slot <= 0) return;
+    EnterCriticalSection(&sched_table_cs);
+    SCHED_FIELD(slot, program_counter) = free_slots;
+    free_slots = slot;
+    LeaveCriticalSection(&sched_table_cs);
+}
@@ -8,6 +8,20 @@
 #include "memory.h"
 #include "stats.h"
 #include "backing_store.h"
+#include "clock.h"
+#include "finished_archive.h"
+#include "snapshot.h"
+#include "locks.h"
+#include "swap_io.h"
+#include "random.h"
+
+#define SWAP_REAP_BATCH 32
+#define EVICT_GAIN_FACTOR 2             // a victim needs this many times the instructions left of what replaces it
+#define SWAP_IN_MAX_WAIT 1000           // ticks swapped out after which a process may evict regardless
+#define THRASH_WINDOW 200               // ticks after a swap-in during which evicting the process again is thrashing
+#define THRASH_PENALTY 4.0              // extra cost of such an eviction, in swap round trips
+#define MAX_VICTIMS 4                   // most processes swapped out to make room for one
+#define PLACE_RETRY_TICKS 20            // ticks a swapped-in process waits for room before it goes back out
 
 uint64_t CPU_TICKS = 0;
 uint64_t switch_tick = 0;
@@ -16,45 +30,64 @@ volatile int processes_generating = 0;
 HANDLE scheduler_thread;
 ReadyQueue ready_queue;
 Process **cpu_cores = NULL;
+// set while a core thread is executing an instruction outside cores_lock
+static volatile int *core_busy = NULL;
 int num_cores = 0;
 int quantum;
 Config config ;
 
 static uint64_t last_process_tick = 0;
-CRITICAL_SECTION cpu_cores_cs;
-CRITICAL_SECTION backing_store_cs;
+// see locks.h for what each lock covers and the order they are taken in
+static TimedLock cores_lock;
+static TimedLock ready_queue_lock;
+// at most one swap-in is queued at a time, the next one goes out after its completion is reaped
+static bool swap_in_pending = false;
+// the longest swapped-out process has waited SWAP_IN_MAX_WAIT ticks and nothing can make room for it, no new
+// process is admitted until finished ones free enough memory
+static bool swap_in_starved = false;
+// a swap-in that found no room, the victims picked for it may have been busy, it is tried again every tick
+static SwapRequest unplaced;
+static uint64_t unplaced_since = 0;
+// processes that reached a core without room in memory, oldest first, they stay READY in the process table and
+// wait for free_process_memory to give blocks back instead of going straight to the backing store
+typedef struct {
+    Process *p;
+    uint64_t since;
+} MemoryWaiter;
+static MemoryWaiter *memory_waiters = NULL;
+static int num_memory_waiters = 0;
+static int memory_waiters_capacity = 0;
+static uint64_t waiters_seen_releases = 0;  // memory.releases when the waiters were last tried
+// bytes compaction may still move, a block bigger than compaction-budget moves once enough ticks have added up
+static uint64_t compaction_credit = 0;
 HANDLE *core_threads = NULL;
 static int quantum_cycle = 0; //new add
 // 0 is fcfs, 1 is rr
 int schedule_type = 0;
 
-// finished process array
-static Process **finished_processes = NULL;
-static int finished_count = 0;
-static int finished_capacity = 0;
-bool try_allocate_memory(Process* process, MemoryBlock* memory_blocks_head);
+// processes generated ahead of time by the pregen thread
+static Process **pregen_pool = NULL;
+static int pregen_capacity = 0;
+static int pregen_head = 0;
+static int pregen_count = 0;
+static CRITICAL_SECTION pregen_cs;
+static HANDLE pregen_thread = NULL;
+
+bool try_allocate_memory(Process* process);
 double utilization = 0.0;
 int used = 0;
 
+void init_scheduler_locks() {
+    timed_lock_init(&cores_lock, "cores");
+    timed_lock_init(&ready_queue_lock, "ready queue");
+}
+
+// called with cores_lock held
 void update_cpu_util(int add) {
     used += add;
     utilization = (num_cores > 0) ? (100.0 * used / num_cores) : 0.0;
 }
 
-void add_finished_process(Process *p) {
-    /* printf("[DEBUG] Finishing process: %s (PID: %d)\n", p->name, p->pid);
- */
-    if (finished_count == finished_capacity) {
-        int new_cap = finished_capacity == 0 ? 16 : finished_capacity * 2;
-        Process **new_arr = malloc(sizeof(Process *) * new_cap);
-        for (int i = 0; i < finished_count; i++) new_arr[i] = finished_processes[i];
-        free(finished_processes);
-        finished_processes = new_arr;
-        finished_capacity = new_cap;
-    }
-    finished_processes[finished_count++] = p;
-}
-
 // initialize the ready queue
 void init_ready_queue() {
     ready_queue.capacity = 16;
@@ -62,10 +95,6 @@ void init_ready_queue() {
     ready_queue.head = 0;
     ready_queue.tail = 0;
     ready_queue.items = malloc(sizeof(Process *) * ready_queue.capacity);
-    // finished process array
-    finished_capacity = 16;
-    finished_count = 0;
-    finished_processes = malloc(sizeof(Process *) * finished_capacity);
 }
 
 void print_ready_queue() {
@@ -83,6 +112,7 @@ void print_ready_queue() {
 
 // eunqueue new process
 void enqueue_ready(Process *p) {
+    timed_lock_enter(&ready_queue_lock);
     // resize the ready queue if too many items
     if (ready_queue.size == ready_queue.capacity) {
         uint32_t new_cap = ready_queue.capacity * 2;
@@ -104,340 +134,575 @@ void enqueue_ready(Process *p) {
     ready_queue.items[ready_queue.tail] = p;
     ready_queue.tail = (ready_queue.tail + 1) % ready_queue.capacity;
     ready_queue.size++;
+    timed_lock_leave(&ready_queue_lock);
 }
 
 // dequeue, returns the head
 Process *dequeue_ready() {
-    if (ready_queue.size == 0) return NULL;
-
-    Process *p = ready_queue.items[ready_queue.head];
-    ready_queue.head = (ready_queue.head + 1) % ready_queue.capacity;
-    ready_queue.size--;
+    Process *p = NULL;
+    timed_lock_enter(&ready_queue_lock);
+    if (ready_queue.size > 0) {
+        p = ready_queue.items[ready_queue.head];
+        ready_queue.head = (ready_queue.head + 1) % ready_queue.capacity;
+        ready_queue.size--;
+    }
+    timed_lock_leave(&ready_queue_lock);
     return p;
 }
 
-// fcfs scheduling
-void schedule_fcfs() {
+uint32_t ready_queue_length() {
+    timed_lock_enter(&ready_queue_lock);
+    uint32_t size = ready_queue.size;
+    timed_lock_leave(&ready_queue_lock);
+    return size;
+}
 
-    EnterCriticalSection(&cpu_cores_cs);
+// a process read back from the backing store got memory, make it runnable and visible again
+static void admit_swapped_in(Process *p) {
+    p->in_memory = 1;
+    p->last_swap_in_tick = CPU_TICKS;
+    PROC_STATE(p) = READY;
+    add_process(p);
+    enqueue_ready(p);
+    update_free_memory();
+}
 
-    // Wake up sleeping processes
-    for (int i = 0; i < num_cores; i++) {
-        Process *p = cpu_cores[i];
-        if (p && p->state == SLEEPING && CPU_TICKS >= p->sleep_until_tick) {
-            p->state = RUNNING;
+static bool best_fit_waiting() {
+    return strcmp(config.memory_wait_order, "best-fit") == 0;
+}
+
+// the I/O thread writes it out and it is freed once that is reaped
+static void swap_out_unallocated(Process *p) {
+    PROC_STATE(p) = SWAPPING;
+    swap_io_submit(SWAP_OUT, p, false);
+}
+
+// a memory-wait-timeout or memory-wait-limit of 0 turns waiting off, processes go straight to the backing store
+static bool memory_waiting_enabled() {
+    return config.memory_wait_timeout > 0 && config.memory_wait_limit > 0;
+}
+
+// p got no memory, it waits for room unless waiting is off or memory-wait-limit processes already are
+static void wait_for_memory(Process *p) {
+    if (!memory_waiting_enabled()) {
+        swap_out_unallocated(p);
+        return;
+    }
+    if (num_memory_waiters >= config.memory_wait_limit) {
+        timed_lock_enter(&cores_lock);
+        stats.num_memory_wait_overflows++;
+        timed_lock_leave(&cores_lock);
+        swap_out_unallocated(p);
+        return;
+    }
+
+    if (num_memory_waiters == memory_waiters_capacity) {
+        int new_cap = memory_waiters_capacity ? memory_waiters_capacity * 2 : 16;
+        MemoryWaiter *grown = realloc(memory_waiters, sizeof(MemoryWaiter) * new_cap);
+        if (!grown) {
+            swap_out_unallocated(p);
+            return;
         }
+        memory_waiters = grown;
+        memory_waiters_capacity = new_cap;
     }
 
-    // 1. Assign ready processes to free cores
-    for (int i = 0; i < num_cores; i++) {
-        if (cpu_cores[i] == NULL) {
-            Process *next = dequeue_ready();
-            if (!next) continue;
-
-            // Validate process data before scheduling
-            if (next->in_memory == 1 || try_allocate_memory(next, memory_head)) {
-                // Extra validation to prevent crashes
-                if (next->instructions != NULL && next->variables != NULL) {
-                    update_cpu_util(1);
-                    cpu_cores[i] = next;
-                    next->core = i;  // Set core index
-                    next->state = RUNNING;
-                    next->last_exec_time = time(NULL); // Set execution time
-                    
-                    if (next->in_memory == 0) {
-                        next->in_memory = 1;
-                        update_free_memory();
-                    }
-                } else {
-                    printf("[ERROR] Process %s has invalid instruction/variable arrays\n", next->name);
-                    // Don't schedule this process
-                    if (next->instructions) free(next->instructions);
-                    if (next->variables) free(next->variables);
-                    free(next);
+    memory_waiters[num_memory_waiters].p = p;
+    memory_waiters[num_memory_waiters].since = CPU_TICKS;
+    num_memory_waiters++;
+    timed_lock_enter(&cores_lock);
+    stats.num_memory_waits++;
+    timed_lock_leave(&cores_lock);
+}
+
+// the waiter at index i was allocated, it goes back to the ready queue
+static void admit_waiter(int i) {
+    Process *p = memory_waiters[i].p;
+    memmove(&memory_waiters[i], &memory_waiters[i + 1], sizeof(MemoryWaiter) * (num_memory_waiters - i - 1));
+    num_memory_waiters--;
+
+    p->in_memory = 1;
+    update_free_memory();
+    enqueue_ready(p);
+}
+
+// once free_process_memory has given blocks back, waiting processes are allocated oldest first up to the first
+// that still doesn't fit, or with memory-wait-order best-fit the biggest that fits the biggest free block each
+// time, then the ones that waited memory-wait-timeout ticks go to the backing store
+static void admit_memory_waiters() {
+    if (num_memory_waiters == 0) return;
+
+    if (memory.releases != waiters_seen_releases) {
+        waiters_seen_releases = memory.releases;
+        if (best_fit_waiting()) {
+            while (num_memory_waiters > 0) {
+                uint64_t hole = largest_free_block();
+                int best = -1;
+                for (int i = 0; i < num_memory_waiters; i++) {
+                    uint64_t size = memory_waiters[i].p->memory_allocation;
+                    if (size <= hole && (best < 0 || size > memory_waiters[best].p->memory_allocation))
+                        best = i;
                 }
-            } else {
-                // Can't allocate memory - send to backing store
-                write_process_to_backing_store(next);
-                // if (next->instructions) free(next->instructions);
-                // if (next->variables) free(next->variables);
-                free(next);
+                if (best < 0 || !try_allocate_memory(memory_waiters[best].p)) break;
+                admit_waiter(best);
             }
+        } else {
+            while (num_memory_waiters > 0 && try_allocate_memory(memory_waiters[0].p))
+                admit_waiter(0);
         }
     }
 
-    // 3. Try to swap in processes from backing store (periodically)
-    if (CPU_TICKS > 0 && CPU_TICKS % 50 == 0) {
-        Process *swapped_in = read_first_process_from_backing_store();
-        if (swapped_in) {
-            // Validate the process from backing store
-            if (swapped_in->num_inst <= 0 || swapped_in->num_inst > 1000000) {
-                printf("[ERROR] Invalid process read from backing store: num_inst=%d\n", 
-                       swapped_in->num_inst);
-                free(swapped_in);
-            } else if (try_allocate_memory(swapped_in, memory_head)) {
-                // Successfully allocated memory
-                remove_first_process_from_backing_store();
-                swapped_in->in_memory = 1;
-                enqueue_ready(swapped_in);
-                update_free_memory();
-            } else {
-                // Memory full - find a victim to swap out
-                Process *victim = NULL;
-                int victim_core = -1;
-                
-                for (int j = 0; j < num_cores; j++) {
-                    if (cpu_cores[j] && cpu_cores[j]->state == RUNNING) {
-                        victim = cpu_cores[j];
-                        victim_core = j;
-                        break;
-                    }
-                }
-                
-                if (victim) {
-                    // Only write to backing store if we have valid data
-                    if (victim->instructions && victim->variables) {
-                        write_process_to_backing_store(victim);
-                    }
-                    
-                    free_process_memory(victim, &memory_head);
-                    cpu_cores[victim_core] = NULL;
-                    update_cpu_util(-1);
-                    
-                    if (victim->instructions) free(victim->instructions);
-                    if (victim->variables) free(victim->variables);
-                    free(victim);
-                    
-                    // Try again with the new free memory
-                    if (try_allocate_memory(swapped_in, memory_head)) {
-                        remove_first_process_from_backing_store();
-                        swapped_in->in_memory = 1;
-                        enqueue_ready(swapped_in);
-                        update_free_memory();
-                    } else {
-                        if (swapped_in->instructions) free(swapped_in->instructions);
-                        if (swapped_in->variables) free(swapped_in->variables);
-                        free(swapped_in);
-                    }
-                } else {
-                    // No victim found, free the swapped-in process
-                    if (swapped_in->instructions) free(swapped_in->instructions);
-                    if (swapped_in->variables) free(swapped_in->variables);
-                    free(swapped_in);
+    int kept = 0;
+    int timed_out = 0;
+    for (int i = 0; i < num_memory_waiters; i++) {
+        if (CPU_TICKS - memory_waiters[i].since >= (uint64_t)config.memory_wait_timeout) {
+            swap_out_unallocated(memory_waiters[i].p);
+            timed_out++;
+        } else {
+            memory_waiters[kept++] = memory_waiters[i];
+        }
+    }
+    num_memory_waiters = kept;
+    if (timed_out > 0) {
+        timed_lock_enter(&cores_lock);
+        stats.num_memory_wait_timeouts += timed_out;
+        timed_lock_leave(&cores_lock);
+    }
+}
+
+// moves resident processes together so free space ends up in one block, up to compaction-budget bytes per tick
+// a process executing an instruction stays put, holding cores_lock keeps the others off the cores meanwhile
+static void compact_step() {
+    if (config.compaction_budget <= 0) return;
+    uint64_t cap = (uint64_t)config.compaction_budget > memory.max_mem_per_proc ?
+                   (uint64_t)config.compaction_budget : memory.max_mem_per_proc;
+    compaction_credit += config.compaction_budget;
+    if (compaction_credit > cap) compaction_credit = cap;
+
+    // nothing to gain with the free space already in one block
+    if (memory.largest_free == memory.free_memory) return;
+
+    int pinned[MAX_SNAPSHOT_CORES];
+    int num_pinned = 0;
+    timed_lock_enter(&cores_lock);
+    for (int i = 0; i < num_cores && num_pinned < MAX_SNAPSHOT_CORES; i++) {
+        if (cpu_cores[i] && core_busy[i])
+            pinned[num_pinned++] = cpu_cores[i]->pid;
+    }
+    int moves;
+    uint64_t moved = compact_memory(compaction_credit, pinned, num_pinned, &moves);
+    stats.num_compaction_moves += moves;
+    stats.compaction_bytes += moved;
+    timed_lock_leave(&cores_lock);
+    compaction_credit -= moved;
+}
+
+// true when no core has a runnable process, called with cores_lock held
+static bool cores_idle() {
+    for (int i = 0; i < num_cores; i++) {
+        if (cpu_cores[i] && PROC_STATE(cpu_cores[i]) == RUNNING)
+            return false;
+    }
+    return true;
+}
+
+// fill free cores from the ready queue
+// only this thread fills cores, so a slot seen free stays free while memory is allocated outside the lock
+static void assign_free_cores(bool reset_quantum) {
+    for (int i = 0; i < num_cores; i++) {
+        timed_lock_enter(&cores_lock);
+        bool free_core = cpu_cores[i] == NULL;
+        timed_lock_leave(&cores_lock);
+        if (!free_core) continue;
+
+        Process *next = dequeue_ready();
+        if (!next) continue;
+
+        // waiting processes are admitted oldest first, a new one can't take room ahead of them
+        if (next->in_memory == 0 && num_memory_waiters > 0 && !best_fit_waiting()) {
+            wait_for_memory(next);
+            continue;
+        }
+
+        // Validate process data before scheduling
+        if (next->in_memory == 1 || try_allocate_memory(next)) {
+            // Extra validation to prevent crashes
+            if (next->instructions != NULL && next->variables != NULL) {
+                if (next->in_memory == 0) {
+                    next->in_memory = 1;
+                    update_free_memory();
                 }
+
+                timed_lock_enter(&cores_lock);
+                update_cpu_util(1);
+                cpu_cores[i] = next;
+                PROC_CORE(next) = i;  // Set core index
+                // a process evicted while sleeping sleeps out the rest of it
+                PROC_STATE(next) = CPU_TICKS < PROC_SLEEP_UNTIL(next) ? SLEEPING : RUNNING;
+                next->last_exec_time = clock_wall_time(); // Set execution time
+                next->last_exec_tick = CPU_TICKS;
+                if (reset_quantum)
+                    PROC_QUANTUM(next) = 0;
+                timed_lock_leave(&cores_lock);
+            } else {
+                printf("[ERROR] Process %s has invalid instruction/variable arrays\n", next->name);
+                // Don't schedule this process
+                free_process(next);
             }
+        } else {
+            // Can't allocate memory
+            wait_for_memory(next);
         }
     }
+}
 
-    // 4. If all cores are idle and ready queue is empty, try to swap in from backing store
-    bool all_idle = true;
-    for (int i = 0; i < num_cores; i++) {
-        if (cpu_cores[i] && cpu_cores[i]->state == RUNNING) {
-            all_idle = false;
-            break;
+// what swapping p out to make room for a process with remaining instructions left costs, in swap round trips:
+// the trip itself, one more if p is running rather than sleeping, the incoming process's share of p's remaining
+// work (evicting one about to finish gains nothing), and more for every time p was evicted before and if it only
+// just came back in, -1 if p may not be evicted unless the incoming process is starving
+// called with cores_lock held
+static double eviction_cost(Process *p, int remaining, bool starving) {
+    int left = p->num_inst - (int)PROC_PC(p);
+    bool recent = p->last_swap_in_tick > 0 && CPU_TICKS - p->last_swap_in_tick < THRASH_WINDOW;
+    if (!starving && (left <= EVICT_GAIN_FACTOR * remaining || recent)) return -1;
+
+    double cost = 1.0;
+    if (PROC_STATE(p) == RUNNING) cost += 1.0;
+    cost += left > 0 ? (double)remaining / left : remaining;
+    cost += 0.25 * p->times_evicted;
+    if (recent) cost += THRASH_PENALTY;
+    return cost;
+}
+
+// the cores whose processes to swap out so one needing size bytes with remaining instructions left fits, the
+// cheapest set of at most MAX_VICTIMS that frees a big enough block, written to victim_cores
+// returns how many, -1 if there is no such set or no eviction pays off
+// called with cores_lock held
+static int pick_victims(uint64_t size, int remaining, uint64_t swapped_out_at, int *victim_cores) {
+    bool starving = CPU_TICKS - swapped_out_at >= SWAP_IN_MAX_WAIT;
+    // num-cpu is capped at MAX_SNAPSHOT_CORES, so the candidates fit on the stack
+    int pids[MAX_SNAPSHOT_CORES];
+    double costs[MAX_SNAPSHOT_CORES];
+    int cores[MAX_SNAPSHOT_CORES];
+    int chosen[MAX_SNAPSHOT_CORES];
+
+    int n = 0;
+    for (int j = 0; j < num_cores && n < MAX_SNAPSHOT_CORES; j++) {
+        Process *p = cpu_cores[j];
+        // never evict a process in the middle of an instruction
+        if (!p || core_busy[j] || (PROC_STATE(p) != RUNNING && PROC_STATE(p) != SLEEPING)) continue;
+        double cost = eviction_cost(p, remaining, starving);
+        if (cost < 0) continue;
+        pids[n] = p->pid;
+        costs[n] = cost;
+        cores[n++] = j;
+    }
+
+    int count = n > 0 ? find_room(size, pids, costs, n, MAX_VICTIMS, chosen) : -1;
+    // the room is there already, it was taken between the pick and the swap-in
+    if (count == 0) count = -1;
+    for (int i = 0; i < count; i++)
+        victim_cores[i] = cores[chosen[i]];
+    return count;
+}
+
+// a process the I/O thread took out of the backing store, evicting running or sleeping processes if memory is full,
+// evict is set and the eviction pays off, false if it is still waiting for room
+static bool place_swapped_in(Process *swapped_in, bool evict, uint64_t swapped_out_at) {
+    // Validate the process from backing store
+    if (swapped_in->num_inst <= 0 || swapped_in->num_inst > 1000000) {
+        printf("[ERROR] Invalid process read from backing store: num_inst=%d\n", 
+               swapped_in->num_inst);
+        free_process(swapped_in);
+        return true;
+    }
+
+    if (try_allocate_memory(swapped_in)) {
+        // Successfully allocated memory
+        admit_swapped_in(swapped_in);
+        return true;
+    }
+
+    // Memory full - take the victims off their cores, the writes and frees happen after the cores are released
+    Process *victims[MAX_VICTIMS];
+    int num_victims = 0;
+    if (evict) {
+        int remaining = swapped_in->num_inst - (int)PROC_PC(swapped_in);
+        int victim_cores[MAX_VICTIMS];
+        timed_lock_enter(&cores_lock);
+        int n = pick_victims(swapped_in->memory_allocation, remaining, swapped_out_at, victim_cores);
+        for (int i = 0; i < n; i++) {
+            Process *victim = cpu_cores[victim_cores[i]];
+            cpu_cores[victim_cores[i]] = NULL;
+            PROC_STATE(victim) = SWAPPING;
+            update_cpu_util(-1);
+            stats.num_evictions++;
+            if (victim->last_swap_in_tick > 0 && CPU_TICKS - victim->last_swap_in_tick < THRASH_WINDOW)
+                stats.num_thrash_swaps++;
+            victim->times_evicted++;
+            victims[num_victims++] = victim;
         }
+        timed_lock_leave(&cores_lock);
     }
-    
-    if (all_idle && ready_queue.size == 0) {
-        Process *swapped_in = read_first_process_from_backing_store();
-        if (swapped_in) {
-            // Validate the process
-            if (swapped_in->num_inst <= 0 || swapped_in->num_inst > 1000000) {
-                printf("[ERROR] Invalid process read from backing store: num_inst=%d\n", 
-                       swapped_in->num_inst);
-                free(swapped_in);
-            } else if (try_allocate_memory(swapped_in, memory_head)) {
-                // Success - remove from backing store and add to ready queue
-                remove_first_process_from_backing_store();
-                swapped_in->in_memory = 1;
-                enqueue_ready(swapped_in);
-                update_free_memory();
+
+    for (int i = 0; i < num_victims; i++) {
+        free_process_memory(victims[i], &memory_head);
+        // Only write to backing store if we have valid data
+        if (victims[i]->instructions && victims[i]->variables)
+            swap_io_submit(SWAP_OUT, victims[i], false);
+        else
+            free_process(victims[i]);
+    }
+
+    // Try again with the new free memory
+    if (num_victims > 0 && try_allocate_memory(swapped_in)) {
+        admit_swapped_in(swapped_in);
+        return true;
+    }
+    return false;
+}
+
+// places the waiting swap-in if it fits now, it has already left the store, so once it has waited
+// PLACE_RETRY_TICKS it is queued to be written back
+static void retry_unplaced() {
+    if (!unplaced.p) return;
+    if (!place_swapped_in(unplaced.p, unplaced.evict, unplaced.swapped_out_at)) {
+        if (CPU_TICKS - unplaced_since < PLACE_RETRY_TICKS) return;
+
+        // read back for nothing
+        timed_lock_enter(&cores_lock);
+        stats.num_thrash_swaps++;
+        timed_lock_leave(&cores_lock);
+        PROC_STATE(unplaced.p) = SWAPPING;
+        swap_io_submit(SWAP_OUT, unplaced.p, false);
+    }
+    unplaced.p = NULL;
+    swap_in_pending = false;
+}
+
+// picks from the swap directory so only a process that can be placed is read back: the longest swapped out if it
+// fits in the biggest free block, otherwise the biggest that does, otherwise the longest swapped out if evict is set
+// and a running process is worth evicting for it
+static void request_swap_in(bool evict) {
+    if (swap_in_pending) return;
+
+    SwapEntry candidate;
+    bool fits;
+    uint32_t id = pick_swap_in(largest_free_block(), SWAP_IN_MAX_WAIT, &candidate, &fits);
+    swap_in_starved = false;
+    if (id == NO_SWAP_ENTRY) return;
+    if (!fits) {
+        int n = -1;
+        if (evict) {
+            int victim_cores[MAX_VICTIMS];
+            timed_lock_enter(&cores_lock);
+            n = pick_victims(candidate.size, candidate.remaining, candidate.swap_out_tick, victim_cores);
+            timed_lock_leave(&cores_lock);
+        }
+        swap_in_starved = n < 0 && CPU_TICKS - candidate.swap_out_tick >= SWAP_IN_MAX_WAIT;
+        if (n < 0) return;
+    }
+
+    swap_in_pending = true;
+    swap_io_submit_in(id, evict, candidate.swap_out_tick);
+}
+
+// finish whatever the I/O thread completed since the last tick
+static void reap_swap_completions() {
+    retry_unplaced();
+
+    SwapRequest done[SWAP_REAP_BATCH];
+    int n;
+    while ((n = swap_io_reap(done, SWAP_REAP_BATCH)) > 0) {
+        for (int i = 0; i < n; i++) {
+            if (done[i].op == SWAP_OUT) {
+                // the image is in the store now, this copy is no longer needed
+                free_process(done[i].p);
+            } else if (done[i].p) {
+                unplaced = done[i];
+                unplaced_since = CPU_TICKS;
+                retry_unplaced();
             } else {
-                // Failed to allocate memory
-                if (swapped_in->instructions) free(swapped_in->instructions);
-                if (swapped_in->variables) free(swapped_in->variables);
-                free(swapped_in);
+                swap_in_pending = false;
             }
         }
     }
+}
 
-    LeaveCriticalSection(&cpu_cores_cs);
+// fcfs scheduling
+void schedule_fcfs() {
+    reap_swap_completions();
+
+    // Wake up sleeping processes
+    timed_lock_enter(&cores_lock);
+    for (int i = 0; i < num_cores; i++) {
+        Process *p = cpu_cores[i];
+        if (p && PROC_STATE(p) == SLEEPING && CPU_TICKS >= PROC_SLEEP_UNTIL(p)) {
+            PROC_STATE(p) = RUNNING;
+        }
+    }
+    sample_working_sets(cpu_cores, num_cores);
+    timed_lock_leave(&cores_lock);
+
+    // 1. Assign ready processes to free cores, after compacting and admitting processes waiting for memory
+    compact_step();
+    admit_memory_waiters();
+    assign_free_cores(false);
+
+    // 2. Try to swap in processes from backing store (periodically)
+    if (CPU_TICKS > 0 && CPU_TICKS % 50 == 0)
+        request_swap_in(true);
+
+    // 3. If all cores are idle and ready queue is empty, try to swap in from backing store
+    timed_lock_enter(&cores_lock);
+    bool all_idle = cores_idle();
+    timed_lock_leave(&cores_lock);
+    if (all_idle && ready_queue_length() == 0)
+        request_swap_in(false);
 }
 
 void schedule_rr() {
-    EnterCriticalSection(&cpu_cores_cs);
+    reap_swap_completions();
+
+    timed_lock_enter(&cores_lock);
 
     // Wake up sleeping processes
     for (int i = 0; i < num_cores; i++) {
         Process *p = cpu_cores[i];
-        if (p && p->state == SLEEPING && CPU_TICKS >= p->sleep_until_tick) {
-            p->state = RUNNING;
-            p->ticks_ran_in_quantum = 0;
+        if (p && PROC_STATE(p) == SLEEPING && CPU_TICKS >= PROC_SLEEP_UNTIL(p)) {
+            PROC_STATE(p) = RUNNING;
+            PROC_QUANTUM(p) = 0;
         }
     }
+    sample_working_sets(cpu_cores, num_cores);
 
     // 1. Preempt processes that have used up their quantum
     for (int i = 0; i < num_cores; i++) {
         Process *p = cpu_cores[i];
-        if (p && p->state == RUNNING && p->ticks_ran_in_quantum >= quantum) {
+        if (p && PROC_STATE(p) == RUNNING && PROC_QUANTUM(p) >= (uint32_t)quantum && !core_busy[i]) {
             update_cpu_util(-1);
             cpu_cores[i] = NULL;
-            p->state = READY;
+            PROC_STATE(p) = READY;
             enqueue_ready(p);
         }
     }
+    timed_lock_leave(&cores_lock);
 
-    // 2. Assign ready processes to free cores
-    for (int i = 0; i < num_cores; i++) {
-        if (cpu_cores[i] == NULL) {
-            Process *next = dequeue_ready();
-            if (!next) continue;
-
-            // Validate process data before scheduling
-            if (next->in_memory == 1 || try_allocate_memory(next, memory_head)) {
-                // Extra validation to prevent crashes
-                if (next->instructions != NULL && next->variables != NULL) {
-                    update_cpu_util(1);
-                    cpu_cores[i] = next;
-                    next->core = i;  // Set core index
-                    next->state = RUNNING;
-                    next->last_exec_time = time(NULL); // Set execution time
-                    
-                    if (next->in_memory == 0) {
-                        next->in_memory = 1;
-                        update_free_memory();
-                    }
-                    next->ticks_ran_in_quantum = 0;
-                } else {
-                    printf("[ERROR] Process %s has invalid instruction/variable arrays\n", next->name);
-                    // Don't schedule this process
-                    if (next->instructions) free(next->instructions);
-                    if (next->variables) free(next->variables);
-                    free(next);
-                }
-            } else {
-                // Can't allocate memory - send to backing store
-                write_process_to_backing_store(next);
-                // if (next->instructions) free(next->instructions);
-                // if (next->variables) free(next->variables);
-                free(next);
-            }
-        }
-    }
+    // 2. Assign ready processes to free cores, after compacting and admitting processes waiting for memory
+    compact_step();
+    admit_memory_waiters();
+    assign_free_cores(true);
 
     // 3. Try to swap in processes from backing store (periodically)
-    if (CPU_TICKS > 0 && CPU_TICKS % 50 == 0) {
-        Process *swapped_in = read_first_process_from_backing_store();
-        if (swapped_in) {
-            // Validate the process from backing store
-            if (swapped_in->num_inst <= 0 || swapped_in->num_inst > 1000000) {
-                printf("[ERROR] Invalid process read from backing store: num_inst=%d\n", 
-                       swapped_in->num_inst);
-                free(swapped_in);
-            } else if (try_allocate_memory(swapped_in, memory_head)) {
-                // Successfully allocated memory
-                remove_first_process_from_backing_store();
-                swapped_in->in_memory = 1;
-                enqueue_ready(swapped_in);
-                update_free_memory();
-            } else {
-                // Memory full - find a victim to swap out
-                Process *victim = NULL;
-                int victim_core = -1;
-                
-                for (int j = 0; j < num_cores; j++) {
-                    if (cpu_cores[j] && cpu_cores[j]->state == RUNNING) {
-                        victim = cpu_cores[j];
-                        victim_core = j;
-                        break;
-                    }
-                }
-                
-                if (victim) {
-                    // Only write to backing store if we have valid data
-                    if (victim->instructions && victim->variables) {
-                        write_process_to_backing_store(victim);
-                    }
-                    
-                    free_process_memory(victim, &memory_head);
-                    cpu_cores[victim_core] = NULL;
-                    update_cpu_util(-1);
-                    
-                    if (victim->instructions) free(victim->instructions);
-                    if (victim->variables) free(victim->variables);
-                    free(victim);
-                    
-                    // Try again with the new free memory
-                    if (try_allocate_memory(swapped_in, memory_head)) {
-                        remove_first_process_from_backing_store();
-                        swapped_in->in_memory = 1;
-                        enqueue_ready(swapped_in);
-                        update_free_memory();
-                    } else {
-                        if (swapped_in->instructions) free(swapped_in->instructions);
-                        if (swapped_in->variables) free(swapped_in->variables);
-                        free(swapped_in);
-                    }
-                } else {
-                    // No victim found, free the swapped-in process
-                    if (swapped_in->instructions) free(swapped_in->instructions);
-                    if (swapped_in->variables) free(swapped_in->variables);
-                    free(swapped_in);
-                }
-            }
-        }
-    }
+    if (CPU_TICKS > 0 && CPU_TICKS % 50 == 0)
+        request_swap_in(true);
 
     // 4. If all cores are idle and ready queue is empty, try to swap in from backing store
-    bool all_idle = true;
-    for (int i = 0; i < num_cores; i++) {
-        if (cpu_cores[i] && cpu_cores[i]->state == RUNNING) {
-            all_idle = false;
-            break;
+    timed_lock_enter(&cores_lock);
+    bool all_idle = cores_idle();
+    timed_lock_leave(&cores_lock);
+    if (all_idle && ready_queue_length() == 0)
+        request_swap_in(false);
+}
+
+
+// keeps the pregen pool topped up so the scheduler thread doesn't pay for generation
+DWORD WINAPI pregen_loop(LPVOID lpParam) {
+    (void)lpParam;
+    uint64_t rng = seed_random_state(2);
+
+    while (scheduler_running && processes_generating) {
+        EnterCriticalSection(&pregen_cs);
+        int count = pregen_count;
+        LeaveCriticalSection(&pregen_cs);
+
+        if (count >= pregen_capacity) {
+            Sleep(1);
+            continue;
         }
-    }
-    
-    if (all_idle && ready_queue.size == 0) {
-        Process *swapped_in = read_first_process_from_backing_store();
-        if (swapped_in) {
-            // Validate the process
-            if (swapped_in->num_inst <= 0 || swapped_in->num_inst > 1000000) {
-                printf("[ERROR] Invalid process read from backing store: num_inst=%d\n", 
-                       swapped_in->num_inst);
-                free(swapped_in);
-            } else if (try_allocate_memory(swapped_in, memory_head)) {
-                // Success - remove from backing store and add to ready queue
-                remove_first_process_from_backing_store();
-                swapped_in->in_memory = 1;
-                enqueue_ready(swapped_in);
-                update_free_memory();
-            } else {
-                // Failed to allocate memory
-                if (swapped_in->instructions) free(swapped_in->instructions);
-                if (swapped_in->variables) free(swapped_in->variables);
-                free(swapped_in);
-            }
+
+        Process *p = generate_random_process(config, &rng);
+        if (!p) {
+            Sleep(1);
+            continue;
         }
+
+        EnterCriticalSection(&pregen_cs);
+        pregen_pool[(pregen_head + pregen_count) % pregen_capacity] = p;
+        pregen_count++;
+        LeaveCriticalSection(&pregen_cs);
     }
+    return 0;
+}
+
+static void start_pregen_thread() {
+    if (config.pregen_pool_size <= 0 || pregen_thread) return;
 
-    LeaveCriticalSection(&cpu_cores_cs);
+    pregen_pool = malloc(sizeof(Process *) * config.pregen_pool_size);
+    if (!pregen_pool) return;
+    pregen_capacity = config.pregen_pool_size;
+    pregen_head = 0;
+    pregen_count = 0;
+    InitializeCriticalSection(&pregen_cs);
+    pregen_thread = CreateThread(NULL, 0, pregen_loop, NULL, 0, NULL);
 }
 
+static void stop_pregen_thread() {
+    if (!pregen_thread) return;
+
+    WaitForSingleObject(pregen_thread, INFINITE);
+    CloseHandle(pregen_thread);
+    pregen_thread = NULL;
+
+    // processes that were never admitted
+    for (int i = 0; i < pregen_count; i++)
+        free_process(pregen_pool[(pregen_head + i) % pregen_capacity]);
+    free(pregen_pool);
+    pregen_pool = NULL;
+    pregen_capacity = 0;
+    pregen_count = 0;
+    DeleteCriticalSection(&pregen_cs);
+}
+
+Process *take_pregenerated_process() {
+    if (!pregen_thread) return NULL;
+
+    Process *p = NULL;
+    EnterCriticalSection(&pregen_cs);
+    if (pregen_count > 0) {
+        p = pregen_pool[pregen_head];
+        pregen_head = (pregen_head + 1) % pregen_capacity;
+        pregen_count--;
+    }
+    LeaveCriticalSection(&pregen_cs);
+    return p;
+}
 
 // main scheduler loop
 DWORD WINAPI scheduler_loop(LPVOID lpParam) {
+    (void)lpParam;
     while (scheduler_running) {
         CPU_TICKS++;
         Sleep(1);
+        clock_tick();
+
+        LARGE_INTEGER work_start, work_end, freq;
+        QueryPerformanceCounter(&work_start);
 
         // Generate a new process
          if (processes_generating) {
             if (config.batch_process_freq > 0 && (CPU_TICKS - last_process_tick) >= (uint64_t)config.batch_process_freq) {
                 // Only generate if enough memory is available for at least min-mem-per-proc
-                if (memory.free_memory >= config.min_mem_per_proc) {
-                    Process *dummy = generate_dummy_process(config);
-                    add_process(dummy);
-                    enqueue_ready(dummy);
+                // and no swapped-out process is waiting for it, nor memory-wait-limit new ones
+                if (memory.free_memory >= (uint64_t)config.min_mem_per_proc && !swap_in_starved &&
+                    (!memory_waiting_enabled() || num_memory_waiters < config.memory_wait_limit)) {
+                    Process *dummy = take_pregenerated_process();
+                    if (!dummy)
+                        dummy = generate_dummy_process(config);
+                    if (dummy) {
+                        add_process(dummy);
+                        enqueue_ready(dummy);
+                    }
                 }
                 last_process_tick = CPU_TICKS;
             }
@@ -448,17 +713,12 @@ DWORD WINAPI scheduler_loop(LPVOID lpParam) {
         else
             schedule_fcfs();
         
-        bool all_idle = true;
-        EnterCriticalSection(&cpu_cores_cs);
-        for (int i = 0; i < num_cores; i++) {
-            if (cpu_cores[i] && cpu_cores[i]->state == RUNNING) {
-                all_idle = false;
-                break;
-            }
-        }
-        LeaveCriticalSection(&cpu_cores_cs);
+        QueryPerformanceCounter(&work_end);
+        QueryPerformanceFrequency(&freq);
 
-        if (all_idle) {
+        timed_lock_enter(&cores_lock);
+        record_tick_work((uint64_t)((work_end.QuadPart - work_start.QuadPart) * 1e9 / freq.QuadPart));
+        if (cores_idle()) {
             stats.idle_ticks++;
         } else {
             stats.active_ticks++;
@@ -466,6 +726,10 @@ DWORD WINAPI scheduler_loop(LPVOID lpParam) {
 
         stats.total_ticks++;
 
+        // monitoring commands read this instead of cpu_cores
+        publish_snapshot(cpu_cores, num_cores, CPU_TICKS);
+        timed_lock_leave(&cores_lock);
+
         // print_ready_queue();
 
         if (quantum > 0 && CPU_TICKS % quantum == 0) {
@@ -484,57 +748,62 @@ DWORD WINAPI core_loop(LPVOID lpParam) {
     int core_id = (int)(intptr_t)lpParam;
 
     while (scheduler_running) {
-        EnterCriticalSection(&cpu_cores_cs);
+        timed_lock_enter(&cores_lock);
         Process *p = cpu_cores[core_id];
-        int should_execute = (p && p->state == RUNNING);
-        LeaveCriticalSection(&cpu_cores_cs);
+        int should_execute = (p && PROC_STATE(p) == RUNNING);
+        core_busy[core_id] = should_execute;
+        timed_lock_leave(&cores_lock);
 
         if (should_execute) {
     // Add comprehensive validation to prevent crashes
-    if (p && p->program_counter < p->num_inst && 
+    if (p && PROC_PC(p) < p->num_inst && 
         p->instructions != NULL && p->variables != NULL) {
         
         // Extra validation of instruction data
-        Instruction *inst = &p->instructions[p->program_counter];
+        Instruction *inst = &p->instructions[PROC_PC(p)];
         if (inst) {
             // Add delay before executing instruction
             busy_wait_ticks(config.delay_per_exec);
             
-            execute_instruction(p, config);
-            p->ticks_ran_in_quantum++;
+            int cost = execute_instruction(p, config);
+            // fused instructions still pay the delay of the instructions they replaced
+            if (cost > 1)
+                busy_wait_ticks(config.delay_per_exec * (cost - 1));
+            PROC_QUANTUM(p) += cost;
         }
     } else {
         // Log the invalid process to help debugging
-        EnterCriticalSection(&cpu_cores_cs);
+        timed_lock_enter(&cores_lock);
         printf("[ERROR] Invalid process data detected on core %d. Removing.\n", core_id);
         if (p) {
             printf("[ERROR] Process %s (PID: %d) has invalid data: PC=%d, num_inst=%d\n",
-                   p->name, p->pid, p->program_counter, p->num_inst);
+                   p->name, p->pid, PROC_PC(p), p->num_inst);
             cpu_cores[core_id] = NULL;
             update_cpu_util(-1);
         }
-        LeaveCriticalSection(&cpu_cores_cs);
+        timed_lock_leave(&cores_lock);
     }
 }
 
-        // Handle process completion - CRITICAL SECTION FOR ENTIRE BLOCK
-        EnterCriticalSection(&cpu_cores_cs);
+        // Handle process completion, only taking it off the core happens under the lock
+        timed_lock_enter(&cores_lock);
+        core_busy[core_id] = 0;
         p = cpu_cores[core_id];
-        if (p && p->program_counter >= p->num_inst && p->for_depth == 0) {
-            p->state = FINISHED;
-            cleanup_process(p);
-            add_finished_process(p);
-            
-            // *** FIX: Free memory BEFORE setting to NULL ***
-            free_process_memory(p, &memory_head);
-            update_free_memory();
+        bool finished = p && PROC_PC(p) >= p->num_inst && p->for_depth == 0;
+        if (finished) {
+            PROC_STATE(p) = FINISHED;
             update_cpu_util(-1);  // Add this to maintain proper CPU stats
-            
-            // *** FIX: Set to NULL AFTER freeing memory ***
             cpu_cores[core_id] = NULL;
+        }
+        timed_lock_leave(&cores_lock);
+
+        if (finished) {
+            archive_finished_process(p);
+            free_process_memory(p, &memory_head);
+            // only the archive record is kept, screens look the process up again by pid
+            free_process(p);
             p = NULL;
         }
-        LeaveCriticalSection(&cpu_cores_cs);
 
         // Small delay to prevent tight spinning and reduce CPU usage
         Sleep(1);
@@ -554,8 +823,10 @@ void start_scheduler(Config system_config) {
     if (strcmp(config.scheduler, "rr") == 0)
         schedule_type = 1;
 
+    start_swap_io();
     scheduler_thread = CreateThread(NULL, 0, scheduler_loop, NULL, 0, NULL);
     start_core_threads();
+    start_pregen_thread();
 }
 
 void start_scheduler_without_processes(Config system_config) {
@@ -568,12 +839,64 @@ void start_scheduler_without_processes(Config system_config) {
     if (strcmp(config.scheduler, "rr") == 0)
         schedule_type = 1;
 
+    start_swap_io();
     scheduler_thread = CreateThread(NULL, 0, scheduler_loop, NULL, 0, NULL);
     start_core_threads();
 }
 
+// time scheduling passes over count ready processes on the calling thread, no core threads involved
+// running processes are charged one tick per pass the way core_loop would, returns nanoseconds per pass
+double time_scheduler_ticks(Config system_config, Process **procs, int count, int ticks) {
+    config = system_config;
+    quantum = config.quantum_cycles;
+    schedule_type = strcmp(config.scheduler, "rr") == 0;
+
+    init_scheduler_locks();
+    init_ready_queue();
+    init_cpu_cores(config.num_cpu);
+    for (int i = 0; i < count; i++) {
+        procs[i]->in_memory = 1;     // keeps the pass off the memory allocator and backing store
+        enqueue_ready(procs[i]);
+    }
+
+    uint64_t saved_ticks = CPU_TICKS;
+    LARGE_INTEGER freq, start, end;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+
+    for (int t = 0; t < ticks; t++) {
+        CPU_TICKS++;
+        if (schedule_type)
+            schedule_rr();
+        else
+            schedule_fcfs();
+
+        for (int i = 0; i < num_cores; i++) {
+            Process *p = cpu_cores[i];
+            if (p && PROC_STATE(p) == RUNNING)
+                PROC_QUANTUM(p)++;
+        }
+    }
+
+    QueryPerformanceCounter(&end);
+    CPU_TICKS = saved_ticks;
+
+    // hand the processes back to the caller
+    free(ready_queue.items);
+    ready_queue.items = NULL;
+    ready_queue.size = 0;
+    free(cpu_cores);
+    cpu_cores = NULL;
+    free((void *)core_busy);
+    core_busy = NULL;
+    num_cores = 0;
+
+    return ticks > 0 ? (double)(end.QuadPart - start.QuadPart) * 1e9 / freq.QuadPart / ticks : 0.0;
+}
+
 void stop_scheduler() {
     processes_generating = 0;
+    stop_pregen_thread();
 }
 
 void busy_wait_ticks(uint32_t delay_ticks) {
@@ -589,6 +912,7 @@ void busy_wait_ticks(uint32_t delay_ticks) {
 void init_cpu_cores(int n) {
     num_cores = n;
     cpu_cores = malloc(sizeof(Process *) * n);
+    core_busy = calloc(n, sizeof(int));
     used = 0;
     utilization = 0.0;
     for (int i = 0; i < n; i++) {
@@ -597,8 +921,7 @@ void init_cpu_cores(int n) {
 }
 
 void start_core_threads() {
-    InitializeCriticalSection(&cpu_cores_cs);
-    InitializeCriticalSection(&backing_store_cs);
+    init_scheduler_locks();
     core_threads = malloc(sizeof(HANDLE) * num_cores);
 
     for (int i = 0; i < num_cores; i++)
@@ -613,7 +936,6 @@ void stop_core_threads() {
     }
     
     free(core_threads);
-    DeleteCriticalSection(&cpu_cores_cs);
 }
 
 int get_num_cores() {
@@ -624,44 +946,17 @@ Process **get_cpu_cores() {
     return cpu_cores;
 }
 
-Process **get_finished_processes() {
-    return finished_processes;
-}
-
-int get_finished_count() {
-    return finished_count;
-}
-
-bool try_allocate_memory(Process* process, MemoryBlock* memory_blocks_head) {
-    MemoryBlock* curr = memory_blocks_head;
-
-    while (curr != NULL) {
-        if (!curr->occupied && (curr->end - curr->base + 1) >= process->memory_allocation) {
-            // Allocate memory to the process
-            process->mem_base = curr->base;
-            process->mem_limit = curr->base + process->memory_allocation - 1;
-            curr->occupied = true;
-            curr->pid = process->pid;
-
-            // If there's leftover space, split the block
-            if ((curr->end - curr->base + 1) > process->memory_allocation) {
-                MemoryBlock* new_block = malloc(sizeof(MemoryBlock));
-                new_block->base = curr->base + process->memory_allocation;
-                new_block->end = curr->end;
-                new_block->occupied = false;
-                new_block->pid = -1;
-                new_block->next = curr->next;
 
-                curr->end = new_block->base - 1;
-                curr->next = new_block;
-            }
-
-            stats.num_paged_in++;
-            return true;
-        }
-
-        curr = curr->next;
+// the block comes from the free block index, memory_blocks_head is not walked
+bool try_allocate_memory(Process* process) {
+    timed_lock_enter(&memory_lock);
+    MemoryBlock* block = allocate_block(process->memory_allocation, process->pid);
+    if (block) {
+        // Allocate memory to the process
+        process->mem_base = block->base;
+        process->mem_limit = block->base + process->memory_allocation - 1;
+        stats.num_paged_in++;
     }
-
-    return false;  // No suitable block found
+    timed_lock_leave(&memory_lock);
+    return block != NULL;
 }
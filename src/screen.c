@@ -7,8 +7,11 @@
 #include "scheduler.h"
 #include "config.h"
 #include "process.h"
-
-static int process_count = 0;
+#include "optimizer.h"
+#include "log_stream.h"
+#include "clock.h"
+#include "finished_archive.h"
+#include "snapshot.h"
 
 #define yellow "\x1b[33m"
 #define green "\x1b[32m"
@@ -17,40 +20,92 @@ static int process_count = 0;
 void printColor(const char *color, const char *text);
 
 // print timestamp
-void print_timestamp(time_t raw_time) {
-    struct tm *timeinfo = localtime(&raw_time);
+void print_timestamp(time_t raw_time, uint64_t tick) {
     char buffer[64];
-    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", timeinfo);
+    format_exec_time(buffer, sizeof(buffer), raw_time, tick);
     printf("%s", buffer);
 }
 
-// process-smi
-void screen_process_smi(Process *p) {
+// pc and finished are passed in because a finished process no longer has a scheduling table slot
+static void print_process_smi(Process *p, int pc, bool finished) {
     printf("\nProcess name: %s\n", p->name);
     printf("ID: %d\n", p->pid);
     printf("Logs:\n");
 
-    // Print the execution logs
-    for (int i = 0; i < p->num_logs; i++) {
-        if (p->logs[i].message[0] != '\0') {  // Only print non-empty logs
+    // Print the execution logs, from disk when they are streamed
+    char message[128];
+    if (log_stream_enabled()) {
+        int size = log_stream_tail_size();
+        Log *tail = malloc(sizeof(Log) * (size > 0 ? size : 1));
+        int count = tail ? log_stream_read_tail(p->pid, tail, size) : 0;
+        for (int i = 0; i < count; i++) {
+            format_log(p, &tail[i], message, sizeof(message));
             printf("[");
-            print_timestamp(p->logs[i].last_exec_time);
-            printf("] Core %d: %s\n", 
-                  p->logs[i].core,
-                  p->logs[i].message);
+            print_timestamp(tail[i].last_exec_time, tail[i].tick);
+            printf("] Core %d: %s\n", tail[i].core, message);
+        }
+        free(tail);
+    } else {
+        for (int i = 0; i < p->num_logs; i++) {
+            const Log *log = get_log(p, i);
+            if (!log) break;
+            format_log(p, log, message, sizeof(message));
+            printf("[");
+            print_timestamp(log->last_exec_time, log->tick);
+            printf("] Core %d: %s\n", log->core, message);
         }
     }
 
-    printf("Current instruction line: %d\n", p->program_counter);
+    printf("Current instruction line: %d\n", pc);
     printf("Total instructions: %d\n", p->num_inst);
 
     // If process is finished, show the Finished! message
     
-    if (p->state == FINISHED) {
+    if (finished) {
         printf("\nFinished!\n");
     }
 }
 
+// process-smi
+void screen_process_smi(Process *p) {
+    print_process_smi(p, PROC_PC(p), PROC_STATE(p) == FINISHED);
+}
+
+// pid of the live process with this name, -1 if there is none
+static int find_pid_by_name(const char *name) {
+    lock_process_table();
+    Process *p = find_process_by_name(name);
+    int pid = p ? p->pid : -1;
+    unlock_process_table();
+    return pid;
+}
+
+// process-smi by pid, a process that finished since the screen was opened is shown from its archive record
+static void show_process_smi(int pid) {
+    lock_process_table();
+    Process *p = find_process_by_pid(pid);
+    if (p) {
+        screen_process_smi(p);
+        unlock_process_table();
+        return;
+    }
+    unlock_process_table();
+
+    FinishedRecord r;
+    if (!finished_archive_find(pid, &r)) {
+        printf("Process %d not found.\n", pid);
+        return;
+    }
+
+    // only the name and counts survive, a finished process ran every instruction
+    Process finished;
+    memset(&finished, 0, sizeof(finished));
+    finished_record_name(&r, finished.name, sizeof(finished.name));
+    finished.pid = r.pid;
+    finished.num_inst = r.num_inst;
+    print_process_smi(&finished, r.num_inst, true);
+}
+
 // screen -s
 void screen_start(const char *name, int memory_size, Config config) {
 
@@ -60,13 +115,11 @@ void screen_start(const char *name, int memory_size, Config config) {
     }
 
     // check for duplicate
-    for (int i = 0; i < process_count; i++) {
-         if (strcmp(process_table[i]->name, name) == 0) {
-             char buffer[150];
-             snprintf(buffer, sizeof(buffer), "Screen session '%s' already exists. Use -r to resume.\n", name);
-             printColor(yellow, buffer);                    
-             return;
-         }
+    if (find_pid_by_name(name) >= 0) {
+        char buffer[150];
+        snprintf(buffer, sizeof(buffer), "Screen session '%s' already exists. Use -r to resume.\n", name);
+        printColor(yellow, buffer);                    
+        return;
     }
 
     // create a new process and add to table
@@ -85,50 +138,35 @@ void screen_start(const char *name, int memory_size, Config config) {
     p->name[sizeof(p->name) - 1] = '\0';
     
     // Use thread-safe PID assignment
-    p->pid = ++next_pid;  // Get unique PID
+    if (allocate_pid(p) < 0) {  // Get unique PID
+        printColor(yellow, "Failed to allocate memory for new process.\n");
+        free(p);
+        return;
+    }
     
-    p->program_counter = 0;
+    PROC_PC(p) = 0;
     p->num_inst = config.min_ins + rand() % (config.max_ins - config.min_ins + 1); // Randomized instruction length, or from config
-    p->last_exec_time = time(NULL);
-    p->state = READY;
+    p->last_exec_time = clock_wall_time();
+    p->arrival_tick = CPU_TICKS;
+    PROC_STATE(p) = READY;
     p->is_in_screen = true;
     p->for_depth = 0;
-    p->ticks_ran_in_quantum = 0;
-
-    // Initialize variables array with proper capacity
-    p->variables_capacity = p->num_inst;  // Set initial capacity
-    p->variables = malloc(sizeof(Variable) * p->variables_capacity);
-    if (!p->variables) {
-        printColor(yellow, "Failed to allocate memory for process variables.\n");
-        free(p);
-        return;
-    }
-    memset(p->variables, 0, sizeof(Variable) * p->variables_capacity);
-    p->num_var = 0;  // Start with no variables
-    p->variables_capacity = p->num_inst;  // Set capacity
-    p->num_var = 0;  // Initialize with no variables
+    PROC_QUANTUM(p) = 0;
 
-    // Initialize logs array
-    p->logs = malloc(sizeof(Log) * 100);  // Support up to 100 logs
-    if (!p->logs) {
-        printColor(yellow, "Failed to allocate memory for process logs.\n");
-        free(p);
-        return;
+    // Page table for virtual memory, rounded up to whole frames
+    int num_pages = memory_size / config.mem_per_frame;
+    if (memory_size % config.mem_per_frame != 0) {
+        num_pages++;
     }
-    p->num_logs = 0;
 
-    // Generate some dummy instructions including PRINT
-    p->instructions = malloc(sizeof(Instruction) * p->num_inst);
-    if (!p->instructions) {
-        printColor(yellow, "Failed to allocate memory for instructions.\n");
-        free(p->logs);
+    // Variables, instructions, page table and logs all come from the process arena
+    if (!init_process_arena(p, p->num_inst, 0, p->num_inst, num_pages, config.log_ring_size)) {
+        printColor(yellow, "Failed to allocate memory for new process.\n");
+        sched_slot_release(p->slot);
         free(p);
         return;
     }
 
-    // Zero out all instructions first
-    memset(p->instructions, 0, sizeof(Instruction) * p->num_inst);
-
     // First 5 instructions are always DECLARE to ensure we have variables
     for (int i = 0; i < 5 && i < p->num_inst; i++) {
         char buf[64];
@@ -185,27 +223,13 @@ void screen_start(const char *name, int memory_size, Config config) {
         }
     }
 
+    optimize_process(p, config);
+
     // Initialize process memory
     p->memory_allocation = memory_size;
     p->mem_base = 0;  // Base address for this process
     p->mem_limit = memory_size;  // Limit is the size of allocated memory
     
-    // Initialize page table for virtual memory
-    p->num_pages = memory_size / config.mem_per_frame;
-    if (memory_size % config.mem_per_frame != 0) {
-        p->num_pages++; // Round up if not exact multiple
-    }
-    
-    p->page_table = (PageTableEntry *)calloc(p->num_pages, sizeof(PageTableEntry));
-    if (!p->page_table) {
-        printColor(yellow, "Failed to allocate memory for page table.\n");
-        free(p->instructions);
-        free(p->logs);
-        free(p->variables);
-        free(p);
-        return;
-    }
-    
     // Initialize all page table entries as invalid
     for (int i = 0; i < p->num_pages; i++) {
         p->page_table[i].frame_number = -1;
@@ -217,20 +241,24 @@ void screen_start(const char *name, int memory_size, Config config) {
         init_cpu_cores(config.num_cpu);
         start_scheduler_without_processes(config);
     }
+    // the process is freed when it finishes, so the loop only holds on to its pid
+    int pid = p->pid;
+    char pname[MAX_PROCESS_NAME];
+    strncpy(pname, p->name, sizeof(pname));
+
     // // Add to process table and start scheduling
     add_process(p);
-    process_count++;  // Increment local screen process count
     // EnterCriticalSection(&ready_queue_cs);
     enqueue_ready(p);  // Add to scheduler's ready queue
     // LeaveCriticalSection(&ready_queue_cs);
 
-    printf("Attached to new screen: %s (PID: %d)\n", p->name, p->pid);
+    printf("Attached to new screen: %s (PID: %d)\n", pname, pid);
     printf("Type 'exit' to return to main menu.\n");
     printf("Type 'process-smi' to view process information and logs.\n\n");
 
     char input[64];
     while (1) {
-        printf("[%s] Enter command: ", p->name);
+        printf("[%s] Enter command: ", pname);
         fgets(input, sizeof(input), stdin);
         input[strcspn(input, "\n")] = '\0';
 
@@ -238,7 +266,7 @@ void screen_start(const char *name, int memory_size, Config config) {
             printf("Returning to main menu.\n");
             return;
         } else if (strcmp(input, "process-smi") == 0) {
-            screen_process_smi(p);
+            show_process_smi(pid);
         } else if (strcmp(input, "clear") == 0) {
             // Allow clearing the screen
             #ifdef _WIN32
@@ -253,47 +281,34 @@ void screen_start(const char *name, int memory_size, Config config) {
 }
 
 void screen_resume(const char *name) {
-    //in case tapos na yung process
-    int finished_count = get_finished_count();
-    Process **finished_processes = get_finished_processes();
-    for (int i = 0; i < finished_count; i++) {
-        if (finished_processes[i] && strcmp(finished_processes[i]->name, name) == 0) {
-            printf("Process %s not found.\n", name);
-            return;
-        }
+    // finished processes are no longer in the table, so they are not found
+    int pid = find_pid_by_name(name);
+    if (pid < 0) {
+        printf("Process %s not found.\n", name);
+        return;
     }
 
-    
-    for (uint32_t i = 0; i < num_processes; i++) {
-        if (process_table[i] && strcmp(process_table[i]->name, name) == 0) {
-            Process *p = process_table[i];
-
-            printf("Resumed screen: %s (PID: %d)\n", p->name, p->pid);
-            printf("Type 'exit' to return to main menu.\n");
-
-            char input[64];
-            while (1) {
-                printf("[%s] Enter command: ", p->name);
-                fgets(input, sizeof(input), stdin);
-                input[strcspn(input, "\n")] = '\0';
-
-                if (strcmp(input, "exit") == 0) {
-                    printf("Returning to main menu.\n");
-                    return;
-                } else if (strcmp(input, "process-smi") == 0) {
-                    screen_process_smi(p);
-                } else {
-                    printColor(yellow, "Invalid screen command format.\n");
-                }
-            }
+    printf("Resumed screen: %s (PID: %d)\n", name, pid);
+    printf("Type 'exit' to return to main menu.\n");
+
+    char input[64];
+    while (1) {
+        printf("[%s] Enter command: ", name);
+        fgets(input, sizeof(input), stdin);
+        input[strcspn(input, "\n")] = '\0';
+
+        if (strcmp(input, "exit") == 0) {
+            printf("Returning to main menu.\n");
+            return;
+        } else if (strcmp(input, "process-smi") == 0) {
+            show_process_smi(pid);
+        } else {
+            printColor(yellow, "Invalid screen command format.\n");
         }
     }
-
-    
-    printf("Process %s not found.\n", name);
 }
 
-void screen_create_with_code(const char *command_args) {
+void screen_create_with_code(const char *command_args, Config config) {
     char process_name[50];
     int memory_size;
     char instructions[1024];
@@ -349,13 +364,11 @@ void screen_create_with_code(const char *command_args) {
     }
 
     // check for duplicate pname
-    for (int i = 0; i < process_count; i++) {
-        if (strcmp(process_table[i]->name, process_name) == 0) {
-            char buffer[150];
-            snprintf(buffer, sizeof(buffer), "Screen session '%s' already exists. Use -r to resume.\n", process_name);
-            printColor(yellow, buffer);
-            return;
-        }
+    if (find_pid_by_name(process_name) >= 0) {
+        char buffer[150];
+        snprintf(buffer, sizeof(buffer), "Screen session '%s' already exists. Use -r to resume.\n", process_name);
+        printColor(yellow, buffer);
+        return;
     }
     Process *p = malloc(sizeof(Process));
     if (!p) {
@@ -365,28 +378,39 @@ void screen_create_with_code(const char *command_args) {
     
     memset(p, 0, sizeof(Process));
     strncpy(p->name, process_name, sizeof(p->name) - 1);
-    p->pid = process_count + 1;
-    p->program_counter = 0;
-    p->last_exec_time = time(NULL);
-    
-    // Allocate and parse instructions
-    p->instructions = malloc(sizeof(Instruction) * count);
-    if (!p->instructions) {
-        printColor(yellow, "Failed to allocate instructions.\n");
+    if (allocate_pid(p) < 0) {
+        printColor(yellow, "Failed to allocate memory for new process.\n");
         free(p);
         return;
     }
+    PROC_PC(p) = 0;
+    p->last_exec_time = clock_wall_time();
+    p->arrival_tick = CPU_TICKS;
     
-    int parsed = parse_instruction_list(processed_instructions, p->instructions, count);
+    // Parse into a scratch array, then copy the program and its FOR bodies into the process arena
+    Instruction parsed_instructions[50];
+    int parsed = parse_instruction_list(processed_instructions, parsed_instructions, count);
     if (parsed <= 0) {
         printColor(yellow, "Instruction parsing failed.\n");
-        free(p->instructions);
+        sched_slot_release(p->slot);
         free(p);
         return;
     }
-    
-    p->num_inst = parsed;
+
+    int num_pages = config.mem_per_frame > 0 ? memory_size / config.mem_per_frame : 0;
+    bool ok = init_process_from_instructions(p, parsed_instructions, parsed, 32, num_pages, config.log_ring_size);
+    for (int i = 0; i < parsed; i++) {
+        if (parsed_instructions[i].type == FOR) free(parsed_instructions[i].sub_instructions);
+    }
+    if (!ok) {
+        printColor(yellow, "Failed to allocate instructions.\n");
+        sched_slot_release(p->slot);
+        free(p);
+        return;
+    }
+
     p->memory_allocation = memory_size;
+    optimize_process(p, config);
     
     add_process(p);
     printf("Created process '%s' with %d instructions and %dB memory.\n", process_name, parsed, memory_size);
@@ -394,19 +418,32 @@ void screen_create_with_code(const char *command_args) {
 }
 
 
-void screen_list(int num_cores, Process **cpu_cores, int finished_count, Process **finished_processes) {
-    int used = 0;
+static void print_finished_row(const FinishedRecord *r, void *ctx) {
+    (void)ctx;
+    char name[MAX_PROCESS_NAME];
+    char timebuf[32];
+    finished_record_name(r, name, sizeof(name));
+    format_exec_time(timebuf, sizeof(timebuf), r->finish_time, r->finish_tick);
+    printf("%-16s %-24s %-10s     %u/%u\n", name, timebuf, "Finished", r->num_inst, r->num_inst);
+}
 
-    // count used
-    for (int i = 0; i < num_cores; i++) {
-        if (cpu_cores[i] != NULL) {
-            used++;
-        }
-    }
+static void write_finished_row(const FinishedRecord *r, void *ctx) {
+    FILE *fp = ctx;
+    char name[MAX_PROCESS_NAME];
+    char timebuf[32];
+    finished_record_name(r, name, sizeof(name));
+    format_exec_time(timebuf, sizeof(timebuf), r->finish_time, r->finish_tick);
+    fprintf(fp, "P%-16s %-24s %-10s %u/%u\n", name, timebuf, "Finished", r->num_inst, r->num_inst);
+}
+
+void screen_list() {
+    SystemSnapshot snap;
+    read_snapshot(&snap);
 
     // calculate
-    int available = num_cores - used;
-    double utilization = (num_cores > 0) ? (100.0 * used / num_cores) : 0.0;
+    int used = snap.cores_used;
+    int available = snap.num_cores - used;
+    double utilization = (snap.num_cores > 0) ? (100.0 * used / snap.num_cores) : 0.0;
 
     // print generic report
     
@@ -417,32 +454,24 @@ void screen_list(int num_cores, Process **cpu_cores, int finished_count, Process
     // print running processes
     printf("\nRunning Processes\n");
     printf("%-16s %-24s %-12s %-10s\n", "Name", "Last Exec Time", "Core", "PC/Total");
-    for (int i = 0; i < num_cores; i++) {
-        if (cpu_cores[i] != NULL) {
-            Process *p = cpu_cores[i];
+    for (int i = 0; i < snap.num_cores; i++) {
+        CoreSnapshot *c = &snap.cores[i];
+        if (c->pid != 0) {
             char timebuf[32];
-            struct tm *tm_info = localtime(&p->last_exec_time);
-            strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %H:%M:%S", tm_info);
-            printf("%-16s %-24s %-10d %d/%d\n", p->name, timebuf, i, p->program_counter + 1, p->num_inst);
+            format_exec_time(timebuf, sizeof(timebuf), c->last_exec_time, c->last_exec_tick);
+            printf("%-16s %-24s %-10d %d/%d\n", c->name, timebuf, i, c->program_counter + 1, c->num_inst);
         }
     }
 
-    // print finished processes
+    // print finished processes, only the ones still in the in-memory window
     printf("\nFinished Processes\n");
     printf("%-16s %-24s %-12s %-10s\n", "Name", "Last Exec Time", "Core", "PC/Total");
-    for (int i = 0; i < finished_count; i++) {
-        if (finished_processes[i] != NULL) {
-            // printf("[DEBUG] Finished process: %s (PID: %d)\n", finished_processes[i]->name, finished_processes[i]->pid);
+    finished_archive_walk(print_finished_row, NULL, false);
 
-            Process *p = finished_processes[i];
-            char timebuf[32];
-            struct tm *tm_info = localtime(&p->last_exec_time);
-            strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %H:%M:%S", tm_info);
-            if (p->program_counter > p->num_inst) { 
-                p->program_counter = p->num_inst; // Ensure we don't go out of bounds
-            }
-            printf("%-16s %-24s %-10s     %d/%d\n", p->name, timebuf, "Finished", p->program_counter, p->num_inst);
-        }
+    FinishedTotals totals = finished_archive_totals();
+    if (totals.finished > totals.in_memory) {
+        printf("(%llu older finished processes not shown, %llu in total)\n",
+               (unsigned long long)(totals.finished - totals.in_memory), (unsigned long long)totals.finished);
     }
 }
 
@@ -453,7 +482,7 @@ bool is_valid_memory_size(int memory_size){
     return (memory_size & (memory_size - 1)) == 0; 
 }
 
-void report_utilization(int num_cores, Process **cpu_cores, int finished_count, Process **finished_processes) {
+void report_utilization() {
     FILE *fp = fopen("csopesy-log.txt", "w");  // Open in write mode - creates fresh file each time
     if (!fp) {
         printColor(yellow, "Failed to open log file\n");
@@ -468,15 +497,13 @@ void report_utilization(int num_cores, Process **cpu_cores, int finished_count,
     
     fprintf(fp, "\n=== System Utilization Report - %s ===\n", timestamp);
 
-    int used = 0;
-    for (int i = 0; i < num_cores; i++) {
-        if (cpu_cores[i] != NULL) {
-            used++;
-        }
-    }
+    // one coherent view of the cores, the report never holds up execution
+    SystemSnapshot snap;
+    read_snapshot(&snap);
 
-    int available = num_cores - used;
-    double utilization = (num_cores > 0) ? (100.0 * used / num_cores) : 0.0;
+    int used = snap.cores_used;
+    int available = snap.num_cores - used;
+    double utilization = (snap.num_cores > 0) ? (100.0 * used / snap.num_cores) : 0.0;
 
     fprintf(fp, "CPU Utilization: %.2f%%\n", utilization);
     fprintf(fp, "Cores used: %d\n", used);
@@ -486,41 +513,36 @@ void report_utilization(int num_cores, Process **cpu_cores, int finished_count,
     fprintf(fp, "\nRunning Processes\n");
     fprintf(fp, "%-16s %-24s %-12s %-10s\n", "Name", "Last Exec Time", "Core", "PC/Total");
     fprintf(fp, "--------------------------------------------------------\n");
-    for (int i = 0; i < num_cores; i++) {
-        if (cpu_cores[i] != NULL) {
-            Process *p = cpu_cores[i];
+    for (int i = 0; i < snap.num_cores; i++) {
+        CoreSnapshot *c = &snap.cores[i];
+        if (c->pid != 0) {
             char timebuf[32];
-            struct tm *tm_info = localtime(&p->last_exec_time);
-            strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %H:%M:%S", tm_info);
+            format_exec_time(timebuf, sizeof(timebuf), c->last_exec_time, c->last_exec_tick);
 
-            if (p->program_counter >= p->num_inst) { 
-                p->program_counter = p->num_inst - 1; // Ensure we don't go out of bounds
+            int pc = c->program_counter;
+            if (pc >= c->num_inst) { 
+                pc = c->num_inst - 1; // Ensure we don't go out of bounds
             }
 
             fprintf(fp, "P%-16s %-24s %-10d %d/%d\n", 
-                p->name, timebuf, i, p->program_counter + 1, p->num_inst);
+                c->name, timebuf, i, pc + 1, c->num_inst);
         }
     }
 
-    // Finished processes section
+    // Finished processes section, spilled records are read back so the report stays complete
     fprintf(fp, "\nFinished Processes\n");
     fprintf(fp, "%-16s %-24s %-12s %-10s\n", "Name", "Last Exec Time", "Core", "PC/Total");
     fprintf(fp, "--------------------------------------------------------\n");
-    for (int i = 0; i < finished_count; i++) {
-        if (finished_processes[i] != NULL) {
-            Process *p = finished_processes[i];
-            char timebuf[32];
-            struct tm *tm_info = localtime(&p->last_exec_time);
-            strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %H:%M:%S", tm_info);
-
-            if (p->program_counter > p->num_inst) { 
-                p->program_counter = p->num_inst; // Ensure we don't go out of bounds
-            }
-
-            fprintf(fp, "P%-16s %-24s %-10s %d/%d\n", 
-                p->name, timebuf, "Finished", p->program_counter, p->num_inst);
-        }
-    }
+    finished_archive_walk(write_finished_row, fp, true);
+
+    FinishedTotals totals = finished_archive_totals();
+    uint64_t listed = totals.in_memory + totals.spilled;
+    fprintf(fp, "\nFinished: %llu", (unsigned long long)totals.finished);
+    if (totals.finished > listed)
+        fprintf(fp, " (%llu dropped from the list)", (unsigned long long)(totals.finished - listed));
+    fprintf(fp, "\nInstructions executed by finished processes: %llu\n", (unsigned long long)totals.instructions);
+    fprintf(fp, "Average turnaround: %.1f ticks\n",
+            totals.finished ? (double)totals.turnaround / totals.finished : 0.0);
     
     fprintf(fp, "\n"); // Add a blank line between reports
     fclose(fp);
@@ -0,0 +1,82 @@
+#include <string.h>
+#include <stddef.h>
+#include <windows.h>
+#include "snapshot.h"
+#include "memory.h"
+
+// seqlock: odd while the scheduler is writing, readers copy and retry if it moved
+static SystemSnapshot published;
+static volatile LONG snapshot_seq = 0;
+static volatile int snapshot_ready = 0;
+
+void publish_snapshot(Process **cpu_cores, int num_cores, uint64_t tick) {
+    if (num_cores > MAX_SNAPSHOT_CORES) num_cores = MAX_SNAPSHOT_CORES;
+
+    snapshot_seq++;
+    MemoryBarrier();
+
+    published.tick = tick;
+    published.num_cores = num_cores;
+    published.cores_used = 0;
+    published.total_memory = memory.total_memory;
+    published.free_memory = memory.free_memory;
+    published.largest_free_block = memory.largest_free;
+    published.used_memory = memory.total_memory - memory.free_memory;
+    published.stats = stats;
+
+    for (int i = 0; i < num_cores; i++) {
+        CoreSnapshot *c = &published.cores[i];
+        Process *p = cpu_cores[i];
+        if (!p) {
+            c->pid = 0;
+            continue;
+        }
+
+        published.cores_used++;
+        c->pid = p->pid;
+        memcpy(c->name, p->name, sizeof(c->name));
+        c->program_counter = PROC_PC(p);
+        c->num_inst = p->num_inst;
+        c->memory_allocation = p->memory_allocation;
+        c->resident_pages = p->resident_pages;
+        c->working_set = p->working_set;
+        c->last_exec_time = p->last_exec_time;
+        c->last_exec_tick = p->last_exec_tick;
+    }
+
+    MemoryBarrier();
+    snapshot_seq++;
+    snapshot_ready = 1;
+}
+
+void read_snapshot(SystemSnapshot *out) {
+    if (!snapshot_ready) {
+        // nothing is running, the globals are not changing underneath us
+        memset(out, 0, offsetof(SystemSnapshot, cores));
+        out->total_memory = memory.total_memory;
+        out->free_memory = memory.free_memory;
+        out->largest_free_block = memory.largest_free;
+        out->used_memory = memory.total_memory - memory.free_memory;
+        out->stats = stats;
+        return;
+    }
+
+    LONG before, after;
+    do {
+        before = snapshot_seq;
+        if (before & 1) {
+            Sleep(0);
+            continue;
+        }
+        MemoryBarrier();
+
+        // header first, then only the cores that exist
+        memcpy(out, &published, offsetof(SystemSnapshot, cores));
+        int n = out->num_cores;
+        if (n < 0 || n > MAX_SNAPSHOT_CORES) n = 0;
+        memcpy(out->cores, published.cores, sizeof(CoreSnapshot) * n);
+
+        MemoryBarrier();
+        after = snapshot_seq;
+    } while ((before & 1) || before != after);
+}
@@ -1,11 +1,33 @@
+#include <string.h>
 #include "stats.h"
 
 CPUStats stats;
 
 void init_stats() {
-    stats.active_ticks = 0;
-    stats.idle_ticks = 0;
-    stats.num_paged_in = 0;
-    stats.num_paged_out = 0;
-    stats.total_ticks = 0;
-}
\ No newline at end of file
+    memset(&stats, 0, sizeof(stats));
+}
+
+void record_tick_work(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    int bucket = 0;
+    while (bucket < TICK_HIST_BUCKETS - 1 && (1ULL << bucket) <= us)
+        bucket++;
+
+    stats.tick_work_hist[bucket]++;
+    stats.tick_work_total_ns += ns;
+    if (ns > stats.tick_work_max_ns) stats.tick_work_max_ns = ns;
+}
+
+uint64_t tick_work_percentile_us(const CPUStats *s, double pct) {
+    uint64_t total = 0;
+    for (int i = 0; i < TICK_HIST_BUCKETS; i++) total += s->tick_work_hist[i];
+    if (total == 0) return 0;
+
+    uint64_t target = (uint64_t)(total * pct / 100.0);
+    uint64_t seen = 0;
+    for (int i = 0; i < TICK_HIST_BUCKETS; i++) {
+        seen += s->tick_work_hist[i];
+        if (seen > target) return 1ULL << i;
+    }
+    return 1ULL << (TICK_HIST_BUCKETS - 1);
+}
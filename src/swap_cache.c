@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "swap_cache.h"
+#include "process_image.h"
+#include "swap_directory.h"
+
+// a small LZ77 codec in the LZ4 block layout: a token with the literal count in the high nibble and the match
+// length minus LZ_MIN_MATCH in the low one (15 means more length bytes follow, 255 each until a smaller one),
+// the literals, then a 2-byte little endian offset back into the output, the last sequence has no match
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+#define LZ_MAX_OFFSET 65535
+
+typedef struct {
+    int pid;
+    uint32_t raw_length;
+    uint32_t stored_length;
+    bool compressed;            // false if compressing did not make it smaller, the image is kept as it was
+    char *data;                 // NULL if the slot is empty
+    uint32_t prev, next;        // put order
+} CacheEntry;
+
+// indexed by swap directory id
+static CacheEntry *entries = NULL;
+static uint32_t entries_capacity = 0;
+static uint32_t num_entries = 0;
+static uint32_t oldest_entry = NO_SWAP_ENTRY;
+static uint32_t newest_entry = NO_SWAP_ENTRY;
+
+static SwapCacheStats cache_stats;
+
+// where an image is packed before compressing and decompressed before decoding
+static char *image_buf = NULL;
+static size_t image_buf_size = 0;
+static char *packed_buf = NULL;
+static size_t packed_buf_size = 0;
+
+// positions plus one of the last 4 bytes that hashed to each slot, 0 is empty
+static uint32_t lz_table[1 << LZ_HASH_BITS];
+
+static char *grow(char **buf, size_t *size, size_t needed) {
+    if (needed > *size) {
+        char *grown = realloc(*buf, needed);
+        if (!grown) return NULL;
+        *buf = grown;
+        *size = needed;
+    }
+    return *buf;
+}
+
+// the counters are read by vmstat without backing_store_lock
+static void stat_add(uint64_t *field, uint64_t n) {
+    InterlockedExchangeAdd64((volatile LONGLONG *)field, (LONGLONG)n);
+}
+
+static void stat_sub(uint64_t *field, uint64_t n) {
+    InterlockedExchangeAdd64((volatile LONGLONG *)field, -(LONGLONG)n);
+}
+
+static uint64_t stat_read(uint64_t *field) {
+    return (uint64_t)InterlockedCompareExchange64((volatile LONGLONG *)field, 0, 0);
+}
+
+static void set_entries(uint32_t n) {
+    InterlockedExchange((volatile LONG *)&cache_stats.entries, (LONG)n);
+}
+
+static uint32_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t lz_hash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static size_t lz_bound(size_t n) {
+    return n + n / 255 + 16;
+}
+
+static unsigned char *put_length(unsigned char *out, size_t len) {
+    while (len >= 255) {
+        *out++ = 255;
+        len -= 255;
+    }
+    *out++ = (unsigned char)len;
+    return out;
+}
+
+// match_len 0 is the last sequence, literals only
+static unsigned char *put_sequence(unsigned char *out, const unsigned char *lit, size_t lit_len,
+                                   size_t offset, size_t match_len) {
+    unsigned char *token = out++;
+    *token = (unsigned char)((lit_len < 15 ? lit_len : 15) << 4);
+    if (lit_len >= 15) out = put_length(out, lit_len - 15);
+    memcpy(out, lit, lit_len);
+    out += lit_len;
+
+    if (match_len > 0) {
+        size_t m = match_len - LZ_MIN_MATCH;
+        *token |= (unsigned char)(m < 15 ? m : 15);
+        *out++ = (unsigned char)(offset & 0xff);
+        *out++ = (unsigned char)(offset >> 8);
+        if (m >= 15) out = put_length(out, m - 15);
+    }
+    return out;
+}
+
+// dst has to hold lz_bound(n) bytes, returns the compressed length
+static size_t lz_compress(const char *src_chars, size_t n, char *dst) {
+    const unsigned char *src = (const unsigned char *)src_chars;
+    unsigned char *out = (unsigned char *)dst;
+    size_t anchor = 0;
+    size_t i = 0;
+
+    memset(lz_table, 0, sizeof(lz_table));
+    while (i + LZ_MIN_MATCH <= n) {
+        uint32_t v = read32(src + i);
+        uint32_t h = lz_hash(v);
+        size_t cand = lz_table[h];
+        lz_table[h] = (uint32_t)i + 1;
+        if (cand == 0 || i + 1 - cand > LZ_MAX_OFFSET || read32(src + cand - 1) != v) {
+            // the longer nothing has matched the further it steps, incompressible stretches go by quickly
+            i += 1 + ((i - anchor) >> 6);
+            continue;
+        }
+
+        cand--;
+        size_t len = LZ_MIN_MATCH;
+        while (i + len + 8 <= n) {
+            uint64_t a, b;
+            memcpy(&a, src + cand + len, sizeof(a));
+            memcpy(&b, src + i + len, sizeof(b));
+            if (a != b) {
+                unsigned long first;
+                _BitScanForward64(&first, a ^ b);
+                len += first / 8;
+                break;
+            }
+            len += 8;
+        }
+        if (i + len + 8 > n) {
+            while (i + len < n && src[cand + len] == src[i + len]) len++;
+        }
+        out = put_sequence(out, src + anchor, i - anchor, i - cand, len);
+        i += len;
+        anchor = i;
+    }
+    out = put_sequence(out, src + anchor, n - anchor, 0, 0);
+    return (size_t)(out - (unsigned char *)dst);
+}
+
+static bool get_length(const unsigned char **in, const unsigned char *end, size_t limit, size_t *len) {
+    unsigned char b;
+    do {
+        if (*in >= end) return false;
+        b = *(*in)++;
+        *len += b;
+        if (*len > limit) return false;
+    } while (b == 255);
+    return true;
+}
+
+// false unless src decodes to exactly dst_len bytes, never reads or writes out of bounds
+static bool lz_decompress(const char *src, size_t n, char *dst, size_t dst_len) {
+    const unsigned char *in = (const unsigned char *)src;
+    const unsigned char *end = in + n;
+    size_t pos = 0;
+
+    while (in < end) {
+        unsigned token = *in++;
+        size_t lit = token >> 4;
+        if (lit == 15 && !get_length(&in, end, dst_len, &lit)) return false;
+        if (lit > (size_t)(end - in) || lit > dst_len - pos) return false;
+        // most runs are short, a fixed 16 byte copy is cheaper when there is room past them on both sides
+        if (lit <= 16 && end - in >= 16 && dst_len - pos >= 16)
+            memcpy(dst + pos, in, 16);
+        else
+            memcpy(dst + pos, in, lit);
+        in += lit;
+        pos += lit;
+        if (in == end) break;
+
+        if (end - in < 2) return false;
+        size_t offset = in[0] | (size_t)in[1] << 8;
+        in += 2;
+        size_t len = token & 15;
+        if (len == 15 && !get_length(&in, end, dst_len, &len)) return false;
+        len += LZ_MIN_MATCH;
+        if (offset == 0 || offset > pos || len > dst_len - pos) return false;
+
+        if (offset >= 16 && len <= 16 && dst_len - pos >= 16) {
+            memcpy(dst + pos, dst + pos - offset, 16);
+            pos += len;
+        } else if (offset >= len) {
+            memcpy(dst + pos, dst + pos - offset, len);
+            pos += len;
+        } else {
+            // the match overlaps what it copies, a run
+            for (size_t k = 0; k < len; k++, pos++)
+                dst[pos] = dst[pos - offset];
+        }
+    }
+    return pos == dst_len;
+}
+
+static CacheEntry *entry_of(uint32_t id) {
+    if (id >= entries_capacity || !entries[id].data) return NULL;
+    return &entries[id];
+}
+
+static bool grow_entries(uint32_t id) {
+    if (id < entries_capacity) return true;
+    uint32_t new_cap = entries_capacity ? entries_capacity : 64;
+    while (new_cap <= id) new_cap *= 2;
+    CacheEntry *grown = realloc(entries, sizeof(CacheEntry) * new_cap);
+    if (!grown) return false;
+    memset(grown + entries_capacity, 0, sizeof(CacheEntry) * (new_cap - entries_capacity));
+    entries = grown;
+    entries_capacity = new_cap;
+    return true;
+}
+
+static void unlink_entry(uint32_t id) {
+    CacheEntry *e = &entries[id];
+    if (e->prev != NO_SWAP_ENTRY) entries[e->prev].next = e->next;
+    else oldest_entry = e->next;
+    if (e->next != NO_SWAP_ENTRY) entries[e->next].prev = e->prev;
+    else newest_entry = e->prev;
+}
+
+void swap_cache_set_capacity(uint64_t bytes) {
+    InterlockedExchange64((volatile LONGLONG *)&cache_stats.capacity, (LONGLONG)bytes);
+}
+
+bool swap_cache_over_capacity() {
+    return num_entries > 0 && cache_stats.used > cache_stats.capacity;
+}
+
+int swap_cache_count() {
+    return (int)num_entries;
+}
+
+void swap_cache_clear() {
+    while (oldest_entry != NO_SWAP_ENTRY)
+        swap_cache_remove(oldest_entry);
+}
+
+bool swap_cache_put(const Process *p, uint32_t id) {
+    if (cache_stats.capacity == 0 || !grow_entries(id) || entries[id].data) return false;
+
+    char *image = grow(&image_buf, &image_buf_size, process_image_bound(p, 0));
+    if (!image) return false;
+    size_t raw = process_image_pack(p, 0, image);
+    char *packed = grow(&packed_buf, &packed_buf_size, lz_bound(raw));
+    if (!packed) return false;
+
+    size_t stored = lz_compress(image, raw, packed);
+    bool compressed = stored < raw;
+    if (!compressed) stored = raw;
+
+    char *data = malloc(stored);
+    if (!data) return false;
+    memcpy(data, compressed ? packed : image, stored);
+
+    entries[id] = (CacheEntry){p->pid, (uint32_t)raw, (uint32_t)stored, compressed, data, newest_entry, NO_SWAP_ENTRY};
+    if (newest_entry != NO_SWAP_ENTRY) entries[newest_entry].next = id;
+    else oldest_entry = id;
+    newest_entry = id;
+    num_entries++;
+
+    stat_add(&cache_stats.raw_bytes, raw);
+    stat_add(&cache_stats.stored_bytes, stored);
+    stat_add(&cache_stats.used, stored);
+    set_entries(num_entries);
+    return true;
+}
+
+// the whole image of an entry, in image_buf if it had to be decompressed
+static const char *entry_image(const CacheEntry *e) {
+    if (!e->compressed) return e->data;
+    char *image = grow(&image_buf, &image_buf_size, e->raw_length);
+    if (!image || !lz_decompress(e->data, e->stored_length, image, e->raw_length)) return NULL;
+    return image;
+}
+
+Process *swap_cache_read(uint32_t id) {
+    uint32_t length;
+    const char *image = swap_cache_image(id, &length);
+    if (!image) return NULL;
+    Process *p = process_image_unpack(image, length);
+    if (!p) printf("[ERROR] Corrupt swap cache entry for P%d\n", entries[id].pid);
+    return p;
+}
+
+const char *swap_cache_image(uint32_t id, uint32_t *length) {
+    CacheEntry *e = entry_of(id);
+    if (!e) return NULL;
+    const char *image = entry_image(e);
+    if (!image) {
+        printf("[ERROR] Corrupt swap cache entry for P%d\n", e->pid);
+        return NULL;
+    }
+    *length = e->raw_length;
+    return image;
+}
+
+void swap_cache_remove(uint32_t id) {
+    CacheEntry *e = entry_of(id);
+    if (!e) return;
+    unlink_entry(id);
+    stat_sub(&cache_stats.used, e->stored_length);
+    free(e->data);
+    e->data = NULL;
+    num_entries--;
+    set_entries(num_entries);
+}
+
+uint32_t swap_cache_oldest() {
+    return oldest_entry;
+}
+
+bool swap_cache_entry_size(uint32_t id, uint32_t *stored, uint32_t *raw) {
+    CacheEntry *e = entry_of(id);
+    if (!e) return false;
+    *stored = e->stored_length;
+    *raw = e->raw_length;
+    return true;
+}
+
+void swap_cache_count_swap_in(bool hit) {
+    stat_add(hit ? &cache_stats.hits : &cache_stats.misses, 1);
+}
+
+void swap_cache_count_write_back() {
+    stat_add(&cache_stats.write_backs, 1);
+}
+
+void swap_cache_stats(SwapCacheStats *out) {
+    out->hits = stat_read(&cache_stats.hits);
+    out->misses = stat_read(&cache_stats.misses);
+    out->write_backs = stat_read(&cache_stats.write_backs);
+    out->raw_bytes = stat_read(&cache_stats.raw_bytes);
+    out->stored_bytes = stat_read(&cache_stats.stored_bytes);
+    out->used = stat_read(&cache_stats.used);
+    out->capacity = stat_read(&cache_stats.capacity);
+    out->entries = (uint32_t)InterlockedCompareExchange((volatile LONG *)&cache_stats.entries, 0, 0);
+}
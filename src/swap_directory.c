@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "swap_directory.h"
+#include "scheduler.h"
+#include "random.h"
+
+#define DIRECTORY_INITIAL 64
+
+TimedLock swap_directory_lock;
+
+static SwapEntry *entries = NULL;
+static uint32_t entries_capacity = 0;
+static uint32_t next_unused = 0;        // ids from here up have never been handed out
+static uint32_t *free_ids = NULL;       // ids given back, reused first
+static uint32_t num_free = 0;
+static int num_live = 0;
+static uint64_t next_seq = 0;
+static uint64_t priority_state = 0;
+
+// root of a treap ordered by size, then oldest last, so the rightmost entry that fits is the best fit
+static uint32_t root = NO_SWAP_ENTRY;
+
+// swap-out order with the seq each id had when it was queued, ids swapped back in are skipped when they come up
+typedef struct {
+    uint32_t id;
+    uint64_t seq;
+} OrderSlot;
+
+static OrderSlot *order = NULL;
+static uint32_t order_capacity = 0;
+static uint32_t order_head = 0;
+static uint32_t order_size = 0;
+
+void init_swap_directory() {
+    timed_lock_init(&swap_directory_lock, "swap directory");
+    priority_state = seed_random_state(8);
+}
+
+void swap_directory_clear() {
+    free(entries);
+    free(free_ids);
+    free(order);
+    entries = NULL;
+    free_ids = NULL;
+    order = NULL;
+    entries_capacity = 0;
+    next_unused = 0;
+    num_free = 0;
+    num_live = 0;
+    order_capacity = 0;
+    order_head = 0;
+    order_size = 0;
+    root = NO_SWAP_ENTRY;
+}
+
+// the tree order: smaller size first, for the same size the newer one first
+static bool key_less(uint32_t a, uint32_t b) {
+    if (entries[a].size != entries[b].size) return entries[a].size < entries[b].size;
+    return entries[a].seq > entries[b].seq;
+}
+
+// splits t into the entries ordered before id and the rest
+static void split(uint32_t t, uint32_t id, uint32_t *l, uint32_t *r) {
+    if (t == NO_SWAP_ENTRY) {
+        *l = *r = NO_SWAP_ENTRY;
+    } else if (key_less(t, id)) {
+        split(entries[t].right, id, &entries[t].right, r);
+        *l = t;
+    } else {
+        split(entries[t].left, id, l, &entries[t].left);
+        *r = t;
+    }
+}
+
+static uint32_t merge(uint32_t l, uint32_t r) {
+    if (l == NO_SWAP_ENTRY) return r;
+    if (r == NO_SWAP_ENTRY) return l;
+    if (entries[l].priority > entries[r].priority) {
+        entries[l].right = merge(entries[l].right, r);
+        return l;
+    }
+    entries[r].left = merge(l, entries[r].left);
+    return r;
+}
+
+static uint32_t tree_insert(uint32_t t, uint32_t id) {
+    if (t == NO_SWAP_ENTRY) return id;
+    if (entries[id].priority > entries[t].priority) {
+        split(t, id, &entries[id].left, &entries[id].right);
+        return id;
+    }
+    if (key_less(id, t))
+        entries[t].left = tree_insert(entries[t].left, id);
+    else
+        entries[t].right = tree_insert(entries[t].right, id);
+    return t;
+}
+
+static uint32_t tree_remove(uint32_t t, uint32_t id) {
+    if (t == NO_SWAP_ENTRY) return t;
+    if (t == id) return merge(entries[t].left, entries[t].right);
+    if (key_less(id, t))
+        entries[t].left = tree_remove(entries[t].left, id);
+    else
+        entries[t].right = tree_remove(entries[t].right, id);
+    return t;
+}
+
+static bool order_valid(const OrderSlot *s) {
+    return entries[s->id].live && entries[s->id].seq == s->seq;
+}
+
+static OrderSlot *order_at(uint32_t i) {
+    return &order[(order_head + i) % order_capacity];
+}
+
+// drops the slots of ids that were swapped back in, once they outnumber the live ones
+static void order_compact() {
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < order_size; i++) {
+        OrderSlot s = *order_at(i);
+        if (order_valid(&s)) order[(order_head + kept++) % order_capacity] = s;
+    }
+    order_size = kept;
+}
+
+static bool order_push(uint32_t id, uint64_t seq) {
+    if (order_size > 2 * (uint32_t)num_live + DIRECTORY_INITIAL) order_compact();
+    if (order_size == order_capacity) {
+        uint32_t new_cap = order_capacity ? order_capacity * 2 : DIRECTORY_INITIAL;
+        OrderSlot *grown = malloc(sizeof(OrderSlot) * new_cap);
+        if (!grown) return false;
+        for (uint32_t i = 0; i < order_size; i++)
+            grown[i] = *order_at(i);
+        free(order);
+        order = grown;
+        order_capacity = new_cap;
+        order_head = 0;
+    }
+    *order_at(order_size) = (OrderSlot){id, seq};
+    order_size++;
+    return true;
+}
+
+static bool grow_entries() {
+    uint32_t new_cap = entries_capacity ? entries_capacity * 2 : DIRECTORY_INITIAL;
+    SwapEntry *grown = realloc(entries, sizeof(SwapEntry) * new_cap);
+    if (!grown) return false;
+    entries = grown;
+    uint32_t *grown_free = realloc(free_ids, sizeof(uint32_t) * new_cap);
+    if (!grown_free) return false;
+    free_ids = grown_free;
+    entries_capacity = new_cap;
+    return true;
+}
+
+uint32_t swap_directory_add(const Process *p) {
+    uint32_t id;
+    if (num_free > 0) {
+        id = free_ids[--num_free];
+    } else {
+        if (next_unused == entries_capacity && !grow_entries()) return NO_SWAP_ENTRY;
+        id = next_unused++;
+    }
+
+    SwapEntry *e = &entries[id];
+    memset(e, 0, sizeof(*e));
+    e->pid = p->pid;
+    strncpy(e->name, p->name, sizeof(e->name) - 1);
+    e->num_inst = p->num_inst;
+    e->num_var = p->num_var;
+    e->size = p->memory_allocation;
+    e->remaining = p->num_inst - (int)PROC_PC(p);
+    if (e->remaining < 0) e->remaining = 0;
+    e->swap_out_tick = CPU_TICKS;
+    e->seq = next_seq++;
+    e->live = true;
+    e->left = e->right = NO_SWAP_ENTRY;
+    e->priority = random_priority(&priority_state);
+
+    if (!order_push(id, e->seq)) {
+        e->live = false;
+        free_ids[num_free++] = id;
+        return NO_SWAP_ENTRY;
+    }
+    root = tree_insert(root, id);
+    num_live++;
+    return id;
+}
+
+void swap_directory_remove(uint32_t id) {
+    if (id >= next_unused || !entries[id].live) return;
+    root = tree_remove(root, id);
+    entries[id].live = false;
+    free_ids[num_free++] = id;
+    num_live--;
+}
+
+SwapEntry *swap_directory_entry(uint32_t id) {
+    if (id >= next_unused || !entries[id].live) return NULL;
+    return &entries[id];
+}
+
+int swap_directory_count() {
+    return num_live;
+}
+
+uint32_t swap_directory_oldest() {
+    while (order_size > 0) {
+        OrderSlot *s = order_at(0);
+        if (order_valid(s)) return s->id;
+        order_head = (order_head + 1) % order_capacity;
+        order_size--;
+    }
+    return NO_SWAP_ENTRY;
+}
+
+uint32_t swap_directory_best_fit(uint64_t size) {
+    uint32_t best = NO_SWAP_ENTRY;
+    uint32_t t = root;
+    while (t != NO_SWAP_ENTRY) {
+        if (entries[t].size <= size) {
+            best = t;
+            t = entries[t].right;
+        } else {
+            t = entries[t].left;
+        }
+    }
+    return best;
+}
+
+void swap_directory_walk(void (*fn)(const SwapEntry *e, uint32_t id, void *ctx), void *ctx) {
+    for (uint32_t i = 0; i < order_size; i++) {
+        OrderSlot *s = order_at(i);
+        if (order_valid(s)) fn(&entries[s->id], s->id, ctx);
+    }
+}
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+#include "swap_io.h"
+#include "backing_store.h"
+#include "locks.h"
+
+#define SWAP_QUEUE_INITIAL 16
+#define SWAP_IO_BATCH 32
+
+typedef struct {
+    SwapRequest *items;
+    uint32_t capacity;
+    uint32_t size;
+    uint32_t head;
+} SwapQueue;
+
+// both queues share swap_queue_lock, it is never held while doing I/O or taking another lock
+static SwapQueue submissions;
+static SwapQueue completions;
+static TimedLock swap_queue_lock;
+static CONDITION_VARIABLE submitted;
+static HANDLE io_thread = NULL;
+static volatile int io_running = 0;
+
+// called with swap_queue_lock held
+static bool queue_push(SwapQueue *q, SwapRequest r) {
+    if (q->size == q->capacity) {
+        uint32_t new_cap = q->capacity ? q->capacity * 2 : SWAP_QUEUE_INITIAL;
+        SwapRequest *items = malloc(sizeof(SwapRequest) * new_cap);
+        if (!items) return false;
+        for (uint32_t i = 0; i < q->size; i++)
+            items[i] = q->items[(q->head + i) % q->capacity];
+        free(q->items);
+        q->items = items;
+        q->capacity = new_cap;
+        q->head = 0;
+    }
+
+    q->items[(q->head + q->size) % q->capacity] = r;
+    q->size++;
+    return true;
+}
+
+// called with swap_queue_lock held
+static bool queue_pop(SwapQueue *q, SwapRequest *out) {
+    if (q->size == 0) return false;
+    *out = q->items[q->head];
+    q->head = (q->head + 1) % q->capacity;
+    q->size--;
+    return true;
+}
+
+static void perform(SwapRequest *r) {
+    if (r->op == SWAP_OUT) {
+        write_process_to_backing_store(r->p);
+    } else {
+        // the scheduler is the only reader, so the entry it picked is still there
+        r->p = take_process_from_backing_store(r->id);
+    }
+}
+
+static void complete(SwapRequest r) {
+    timed_lock_enter(&swap_queue_lock);
+    bool queued = queue_push(&completions, r);
+    timed_lock_leave(&swap_queue_lock);
+
+    if (!queued) {
+        // nobody will reap it, the process is already written out or never made it back in
+        printf("[ERROR] Swap completion queue is full, dropping P%d\n", r.p ? r.p->pid : 0);
+        if (r.p) free_process(r.p);
+    }
+}
+
+// consecutive swap-outs go to the store as one batch, a swap-in waits for the writes queued before it
+static void perform_batch(SwapRequest *batch, int n) {
+    Process *outs[SWAP_IO_BATCH];
+    int num_outs = 0;
+
+    for (int i = 0; i <= n; i++) {
+        if (i < n && batch[i].op == SWAP_OUT) {
+            outs[num_outs++] = batch[i].p;
+            continue;
+        }
+
+        write_processes_to_backing_store(outs, num_outs);
+        num_outs = 0;
+        if (i < n) perform(&batch[i]);
+    }
+}
+
+DWORD WINAPI swap_io_loop(LPVOID lpParam) {
+    (void)lpParam;
+    SwapRequest batch[SWAP_IO_BATCH];
+
+    while (1) {
+        // everything the scheduler queued since the last wake-up, which is usually one tick's worth
+        int n = 0;
+        timed_lock_enter(&swap_queue_lock);
+        while (submissions.size == 0 && io_running)
+            timed_lock_wait(&swap_queue_lock, &submitted, INFINITE);
+        while (n < SWAP_IO_BATCH && queue_pop(&submissions, &batch[n]))
+            n++;
+        timed_lock_leave(&swap_queue_lock);
+
+        // pending requests are finished before the thread exits
+        if (n == 0) break;
+        perform_batch(batch, n);
+        for (int i = 0; i < n; i++)
+            complete(batch[i]);
+    }
+    return 0;
+}
+
+void init_swap_io() {
+    timed_lock_init(&swap_queue_lock, "swap queues");
+    InitializeConditionVariable(&submitted);
+}
+
+void start_swap_io() {
+    if (io_thread) return;
+
+    io_running = 1;
+    io_thread = CreateThread(NULL, 0, swap_io_loop, NULL, 0, NULL);
+}
+
+void stop_swap_io() {
+    if (!io_thread) return;
+
+    timed_lock_enter(&swap_queue_lock);
+    io_running = 0;
+    WakeConditionVariable(&submitted);
+    timed_lock_leave(&swap_queue_lock);
+
+    WaitForSingleObject(io_thread, INFINITE);
+    CloseHandle(io_thread);
+    io_thread = NULL;
+}
+
+static void submit(SwapRequest r) {
+    if (!io_thread) {
+        perform(&r);
+        complete(r);
+        return;
+    }
+
+    // once stop_swap_io has started nothing new is queued, the thread may already have drained the queue
+    timed_lock_enter(&swap_queue_lock);
+    bool queued = io_running && queue_push(&submissions, r);
+    if (queued) WakeConditionVariable(&submitted);
+    timed_lock_leave(&swap_queue_lock);
+
+    if (!queued) {
+        // stopping or out of memory for the queue, fall back to doing it here
+        perform(&r);
+        complete(r);
+    }
+}
+
+void swap_io_submit(SwapOp op, Process *p, bool evict) {
+    submit((SwapRequest){ op, p, evict, NO_SWAP_ENTRY, 0 });
+}
+
+void swap_io_submit_in(uint32_t id, bool evict, uint64_t swapped_out_at) {
+    submit((SwapRequest){ SWAP_IN, NULL, evict, id, swapped_out_at });
+}
+
+int swap_io_reap(SwapRequest *out, int max) {
+    int n = 0;
+    timed_lock_enter(&swap_queue_lock);
+    while (n < max && queue_pop(&completions, &out[n]))
+        n++;
+    timed_lock_leave(&swap_queue_lock);
+    return n;
+}